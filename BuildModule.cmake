@@ -5,6 +5,7 @@ set (sources ${sources}
     src/wrap-hwlib.cpp
     src/libc-stub.cpp
     src/hardware_uart.cpp
+    src/usart_setup.cpp
 )
 
 add_definitions (-DBMPTK_TARGET_arduino_due
@@ -12,5 +12,11 @@ include_directories (${catch}/single_include)
 # Source Files:
 
 set (sources
+    src/async_uart.cpp
+    src/buffered_output.cpp
+    src/framing.cpp
+    src/message_transmitter.cpp
     src/mock_uart.cpp
+    src/uart_interrupt.cpp
+    src/uart_poller.cpp
 )
@@ -8,6 +8,24 @@ add_definitions (-DBMPTK_TARGET_test
                  -DBMPTK_TARGET=test
                  -DBMPTK_BAUDRATE=19200)
 
+# Host only: serial devices and pseudo-terminals through termios, and the register level driver running against simulated
+# SAM3X registers.
+set (sources ${sources}
+    src/hardware_uart.cpp
+    src/posix_serial_uart.cpp
+    src/simulated_sam3x.cpp
+    src/usart_setup.cpp
+)
+
+if (UNIX AND NOT APPLE)
+link_libraries (util) # openpty
+endif (UNIX AND NOT APPLE)
+
+set (library_sources ${sources}
+    src/wrap-hwlib.cpp
+    src/libc-stub.cpp
+)
+
 set (sources ${sources}
     ${unit_test_main}
     src/wrap-hwlib.cpp
@@ -16,6 +34,8 @@ set (sources ${sources}
 
 set (build_test build_test)
 set (unit_test unit_test)
+set (unit_test_cpp20 unit_test_cpp20)
+set (uart_bench uart_bench)
 set (memcheck memcheck)
 set (complexity_test complexity_test)
 set (clangformat_test clangformat_test)
@@ -46,8 +66,39 @@ set_tests_properties (
 	${unit_test} PROPERTIES
 	DEPENDS ${build_test}
 )
+
+# The same unit tests built as C++20, covering the AsyncUART awaitables (UARTLIB_COROUTINES).
+list (FIND CMAKE_CXX_COMPILE_FEATURES cxx_std_20 cxx_std_20_index)
+if (NOT cxx_std_20_index EQUAL -1)
+add_executable (${unit_test_cpp20} ${unit_test_main} ${sources})
+
+set_target_properties (
+	${unit_test_cpp20} PROPERTIES
+	CXX_STANDARD 20
+)
+
+add_test (
+	NAME ${unit_test_cpp20}
+	COMMAND ./${unit_test_cpp20}
+)
+
+set_tests_properties (
+	${unit_test_cpp20} PROPERTIES
+	DEPENDS ${build_test}
+)
+endif (NOT cxx_std_20_index EQUAL -1)
 endif (unit_test_enabled)
 
+if (uart_bench_enabled)
+# Not a test: run ./uart_bench (or ./uart_bench --json) to collect the numbers.
+add_executable (${uart_bench} ${uart_bench_main} ${library_sources})
+
+set_target_properties (
+	${uart_bench} PROPERTIES
+	COMPILE_FLAGS -O2
+)
+endif (uart_bench_enabled)
+
 if (complexity_test_enabled)
 add_test (
 	NAME ${complexity_test}
@@ -0,0 +1,109 @@
+#include "async_uart.hpp"
+
+namespace UARTLib {
+
+AsyncUART::AsyncUART(UARTConnection &connection)
+    : connection(connection), sending{}, receiving{}, listening(false) {
+    ///< Only connections raising interrupts notify us. Otherwise, or when another listener took them, poll() drives us.
+    listening = InterruptRouter::listen(&connection, this);
+}
+
+AsyncUART::~AsyncUART() {
+    InterruptRouter::unlisten(this);
+}
+
+bool AsyncUART::sendAsync(const uint8_t *data, size_t length, Callback callback, void *context) {
+    if (sending.busy) {
+        return false;
+    }
+
+    sending.data = data;
+    sending.length = length;
+    sending.done = 0;
+    sending.callback = callback;
+    sending.context = context;
+    sending.busy = true;
+
+    poll();
+
+    return true;
+}
+
+bool AsyncUART::receiveAsync(uint8_t *buf, size_t n, Callback callback, void *context) {
+    if (receiving.busy) {
+        return false;
+    }
+
+    receiving.buf = buf;
+    receiving.length = n;
+    receiving.done = 0;
+    receiving.callback = callback;
+    receiving.context = context;
+    receiving.busy = true;
+
+    poll();
+
+    return true;
+}
+
+bool AsyncUART::sendBusy() const {
+    return sending.busy;
+}
+
+bool AsyncUART::receiveBusy() const {
+    return receiving.busy;
+}
+
+bool AsyncUART::isListening() const {
+    return listening;
+}
+
+void AsyncUART::poll() {
+    if (!guard.enter()) {
+        return;
+    }
+
+    ///< Callbacks may start new operations, and interrupts may arrive while we are busy. Both are picked up by another round.
+    do {
+        advanceSend();
+        advanceReceive();
+    } while (guard.leave());
+}
+
+void AsyncUART::interruptServiced() {
+    poll();
+}
+
+void AsyncUART::advanceSend() {
+    if (!sending.busy) {
+        return;
+    }
+
+    if (sending.done < sending.length) {
+        sending.done += connection.trySend(sending.data + sending.done, sending.length - sending.done);
+    }
+
+    ///< Complete once the connection no longer holds any of the bytes, so the caller may reuse them.
+    if (sending.done == sending.length && connection.txPending() == 0) {
+        sending.busy = false;
+        sending.callback(sending.context, sending.length);
+    }
+}
+
+void AsyncUART::advanceReceive() {
+    if (!receiving.busy) {
+        return;
+    }
+
+    ///< In polling mode, this moves received bytes into the receive buffer.
+    connection.available();
+
+    receiving.done += connection.receive(receiving.buf + receiving.done, receiving.length - receiving.done);
+
+    if (receiving.done == receiving.length) {
+        receiving.busy = false;
+        receiving.callback(receiving.context, receiving.length);
+    }
+}
+
+} // namespace UARTLib
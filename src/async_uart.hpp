@@ -0,0 +1,237 @@
+/**
+ * @file
+ * @brief     Asynchronous send and receive with completion callbacks, and awaitables for C++20 coroutines.
+ * @author    Wiebe van Breukelen
+ * @license   See LICENSE
+ */
+
+#ifndef ASYNC_UART_HPP
+#define ASYNC_UART_HPP
+
+#include "uart_connection.hpp"
+#include "uart_interrupt.hpp"
+#include "wrap-hwlib.hpp"
+
+#if defined(__cpp_impl_coroutine) && !defined(BMPTK_TARGET_arduino_due)
+#define UARTLIB_COROUTINES
+#include <coroutine>
+#endif
+
+namespace UARTLib {
+
+/**
+ * @brief Runs a send and a receive operation on a connection in the background, calling back once they complete.
+ *
+ * The operations are driven by the interrupts of the connection (interrupt or DMA transfer modes): after the connection
+ * serviced its interrupt, the operations are advanced, and completion callbacks are called from the interrupt handler. Keep
+ * callbacks short, and do not touch the connection from elsewhere while an operation on it is running. Connections without
+ * interrupts (polling mode, PosixSerialUART) are driven by calling poll() from the main loop instead. Only one AsyncUART or
+ * MessageTransmitter listens to the interrupts of a connection, see isListening().
+ *
+ * A send completes once every byte has been transmitted, so the data can be reused in the callback. A receive completes once
+ * the requested amount of bytes has arrived.
+ *
+ * In host builds using C++20, send() and receive() return awaitables, e.g. size_t n = co_await async.receive(buf, 4).
+ */
+class AsyncUART : private InterruptListener {
+  public:
+    /**
+     * @brief Completion callback.
+     *
+     * @param context Context passed along when the operation was started.
+     * @param transferred Amount of bytes transferred.
+     */
+    typedef void (*Callback)(void *context, size_t transferred);
+
+    /**
+     * @brief Construct a new AsyncUART object, listening to the interrupt of the connection when it has one.
+     *
+     * @param connection Connection to run operations on, initialized before.
+     */
+    explicit AsyncUART(UARTConnection &connection);
+
+    AsyncUART(const AsyncUART &) = delete;
+    AsyncUART &operator=(const AsyncUART &) = delete;
+
+    /**
+     * @brief Destroy the AsyncUART object. Running operations are abandoned, without calling back.
+     *
+     */
+    ~AsyncUART();
+
+    /**
+     * @brief Start sending an array of bytes.
+     *
+     * @param data Array of bytes, must stay valid until completion.
+     * @param length Length of array.
+     * @param callback Called once every byte has been transmitted.
+     * @param context Passed to the callback.
+     * @return true Started, or completed already.
+     * @return false A send is still running.
+     */
+    bool sendAsync(const uint8_t *data, size_t length, Callback callback, void *context = nullptr);
+
+    /**
+     * @brief Start receiving an amount of bytes.
+     *
+     * @param buf Array to receive into, must stay valid until completion.
+     * @param n Amount of bytes to receive.
+     * @param callback Called once n bytes have been received.
+     * @param context Passed to the callback.
+     * @return true Started, or completed already.
+     * @return false A receive is still running.
+     */
+    bool receiveAsync(uint8_t *buf, size_t n, Callback callback, void *context = nullptr);
+
+    /**
+     * @brief Check if a send is running.
+     *
+     * @return true Running.
+     * @return false Idle.
+     */
+    bool sendBusy() const;
+
+    /**
+     * @brief Check if a receive is running.
+     *
+     * @return true Running.
+     * @return false Idle.
+     */
+    bool receiveBusy() const;
+
+    /**
+     * @brief Check if the operations are advanced after every interrupt of the connection.
+     *
+     * @return true Listening to the interrupts of the connection.
+     * @return false The connection is not attached to a controller, or another listener listens to it. Call poll() instead.
+     */
+    bool isListening() const;
+
+    /**
+     * @brief Advance the running operations, calling back the ones that complete.
+     *
+     * Called after every interrupt of the connection. Call it from the main loop for connections without interrupts, or when
+     * not listening to them.
+     */
+    void poll();
+
+#ifdef UARTLIB_COROUTINES
+    /**
+     * @brief Awaitable of a send or receive operation, resuming the awaiting coroutine on completion.
+     *
+     */
+    class Awaitable {
+      public:
+        Awaitable(AsyncUART &async, bool isSend, const uint8_t *data, uint8_t *buf, size_t length)
+            : async(async), isSend(isSend), data(data), buf(buf), length(length), transferred(0), starting(false),
+              done(false) {
+        }
+
+        bool await_ready() const {
+            return false;
+        }
+
+        bool await_suspend(std::coroutine_handle<> awaiting) {
+            handle = awaiting;
+            starting = true;
+
+            bool started = isSend ? async.sendAsync(data, length, &Awaitable::complete, this)
+                                          : async.receiveAsync(buf, length, &Awaitable::complete, this);
+
+            starting = false;
+
+            ///< Resume right away when the operation could not start, or completed while starting.
+            return started && !done;
+        }
+
+        size_t await_resume() const {
+            return transferred;
+        }
+
+      private:
+        AsyncUART &async;
+        bool isSend;
+        const uint8_t *data;
+        uint8_t *buf;
+        size_t length;
+        size_t transferred;
+        bool starting;
+        bool done;
+        std::coroutine_handle<> handle;
+
+        static void complete(void *context, size_t transferred) {
+            Awaitable *self = static_cast<Awaitable *>(context);
+            self->transferred = transferred;
+            self->done = true;
+
+            if (!self->starting) {
+                self->handle.resume();
+            }
+        }
+    };
+
+    /**
+     * @brief Send an array of bytes, as an awaitable.
+     *
+     * @param data Array of bytes, must stay valid until completion.
+     * @param length Length of array.
+     * @return Awaitable Resumes with the amount of bytes sent, 0 when a send was already running.
+     */
+    Awaitable send(const uint8_t *data, size_t length) {
+        return Awaitable(*this, true, data, nullptr, length);
+    }
+
+    /**
+     * @brief Receive an amount of bytes, as an awaitable.
+     *
+     * @param buf Array to receive into, must stay valid until completion.
+     * @param n Amount of bytes to receive.
+     * @return Awaitable Resumes with the amount of bytes received, 0 when a receive was already running.
+     */
+    Awaitable receive(uint8_t *buf, size_t n) {
+        return Awaitable(*this, false, nullptr, buf, n);
+    }
+#endif
+
+  private:
+    /**
+     * @brief A running operation.
+     *
+     */
+    struct Operation {
+        const uint8_t *data; ///< Send: bytes to send.
+        uint8_t *buf;        ///< Receive: array to receive into.
+        size_t length;
+        size_t done;
+        Callback callback;
+        void *context;
+        volatile bool busy;
+    };
+
+    UARTConnection &connection;
+    Operation sending;
+    Operation receiving;
+
+    bool listening;
+
+    ///< Keeps the interrupt handler from advancing the operations while poll() runs in the main loop.
+    ReentryGuard guard;
+
+    void interruptServiced() override;
+
+    /**
+     * @brief Advance the running send, if any.
+     *
+     */
+    void advanceSend();
+
+    /**
+     * @brief Advance the running receive, if any.
+     *
+     */
+    void advanceReceive();
+};
+
+} // namespace UARTLib
+
+#endif
@@ -0,0 +1,191 @@
+/**
+ * @file
+ * @brief     UART front end without virtual dispatch, using a compile time selected backend.
+ * @author    Wiebe van Breukelen
+ * @license   See LICENSE
+ */
+
+#ifndef BASIC_UART_HPP
+#define BASIC_UART_HPP
+
+#include "queue.hpp"
+#include "wrap-hwlib.hpp"
+
+namespace UARTLib {
+
+/**
+ * @brief UART front end, using static polymorphism instead of the virtual UARTConnection interface.
+ *
+ * Every call into the backend is resolved at compile time, so the per byte path inlines to plain register accesses. Use this
+ * when the type of connection is known at compile time and throughput matters. HardwareUART and MockUART remain available
+ * when a connection has to be passed around as a UARTConnection.
+ *
+ * A backend provides begin(baudrate), txReady(), writeByte(b), rxReady() and readByte(), see HardwareBackend and MockBackend.
+ * For the shortest per byte path, the initialization status is not checked again after begin().
+ *
+ * @tparam Backend Backend accessing the (mock) USART controller.
+ */
+template <class Backend>
+class BasicUART {
+  public:
+    /**
+     * @brief Construct a new BasicUART object.
+     *
+     * @param baudrate Transmit and receive baudrate.
+     * @param initializeController Initialize the USART controller directly within the object constructor.
+     */
+    BasicUART(unsigned int baudrate, bool initializeController = true) : baudrate(baudrate), USARTControllerInitialized(false) {
+        if (initializeController) {
+            begin();
+        }
+    }
+
+    /**
+     * @brief Begin a UART connection.
+     *
+     */
+    void begin() {
+        if (USARTControllerInitialized) {
+            return;
+        }
+
+        backend.begin(baudrate);
+        USARTControllerInitialized = true;
+    }
+
+    /**
+     * @brief Checks if the USART controller has been initialized.
+     *
+     * @return true USART controller is initialized.
+     * @return false USART controller has not been initialized.
+     */
+    bool isInitialized() const {
+        return USARTControllerInitialized;
+    }
+
+    /**
+     * @brief Check how many bytes are available to read.
+     *
+     * Moves a received byte, if any, into the receive buffer first.
+     *
+     * @return unsigned int Amount of bytes available to read.
+     */
+    unsigned int available() {
+        if (backend.rxReady()) {
+            rxBuffer.push(backend.readByte());
+        }
+
+        return rxBuffer.count();
+    }
+
+    /**
+     * @brief Send a single byte, waiting for the transmitter to be ready.
+     *
+     * @param b Byte.
+     */
+    void send(uint8_t b) {
+        while (!backend.txReady()) {
+        }
+
+        backend.writeByte(b);
+    }
+
+    /**
+     * @brief Send a string.
+     *
+     * @param str String.
+     */
+    void send(const char *str) {
+        for (const char *p = str; *p != '\0'; p++) {
+            send(static_cast<uint8_t>(*p));
+        }
+    }
+
+    /**
+     * @brief Send a array of bytes with a specified length.
+     *
+     * @param data Array of bytes.
+     * @param length Length of array.
+     */
+    void send(const uint8_t *data, size_t length) {
+        for (size_t i = 0; i < length; i++) {
+            send(data[i]);
+        }
+    }
+
+    /**
+     * @brief Receive a single byte from the receive buffer.
+     *
+     * @return uint8_t Received byte, 0 when the receive buffer is empty.
+     */
+    uint8_t receive() {
+        return rxBuffer.pop();
+    }
+
+    /**
+     * @brief Receive up to n bytes from the receive buffer.
+     *
+     * @param buf Array to receive into.
+     * @param n Size of the array.
+     * @return size_t Amount of bytes received.
+     */
+    size_t receive(uint8_t *buf, size_t n) {
+        return rxBuffer.pop(buf, n);
+    }
+
+    /**
+     * @brief Write a character, same as send().
+     *
+     * @param c Character to send.
+     */
+    void putc(char c) {
+        send(static_cast<uint8_t>(c));
+    }
+
+    /**
+     * @brief Read a character, if one is available.
+     *
+     * @return char Received character, 0 when nothing is available.
+     */
+    char getc() {
+        return available() > 0 ? receive() : 0;
+    }
+
+    /**
+     * @brief Access the backend, e.g. to inspect a MockBackend in tests.
+     *
+     * @return Backend& Backend.
+     */
+    Backend &getBackend() {
+        return backend;
+    }
+
+  private:
+    /**
+     * @brief Backend accessing the (mock) USART controller.
+     *
+     */
+    Backend backend;
+
+    /**
+     * @brief Data baudrate used for sending and receiving.
+     *
+     */
+    unsigned int baudrate;
+
+    /**
+     * @brief Holds the initialization status of the USART controller.
+     *
+     */
+    bool USARTControllerInitialized;
+
+    /**
+     * @brief UART receive buffer.
+     *
+     */
+    Queue<uint8_t, 256> rxBuffer;
+};
+
+} // namespace UARTLib
+
+#endif
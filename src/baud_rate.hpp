@@ -0,0 +1,149 @@
+/**
+ * @file
+ * @brief     Baudrate divisor calculation for the USART controllers, at compile time or at runtime.
+ * @author    Wiebe van Breukelen
+ * @license   See LICENSE
+ */
+
+#ifndef BAUD_RATE_HPP
+#define BAUD_RATE_HPP
+
+#include "wrap-hwlib.hpp"
+
+namespace UARTLib {
+
+/**
+ * @brief Master clock (MCK) frequency of the Arduino Due, which clocks the USART controllers.
+ *
+ */
+constexpr uint32_t masterClockFrequency = 84000000u;
+
+/**
+ * @brief Baudrate generator settings of a USART controller.
+ *
+ * The baudrate is MCK / (8 * (2 - OVER) * (CD + FP / 8)), see section 35.7.1 of the SAM3X datasheet.
+ */
+struct BaudRateConfig {
+    /**
+     * @brief Requested baudrate.
+     *
+     */
+    uint32_t requested;
+
+    /**
+     * @brief Clock divider, US_BRGR CD field.
+     *
+     */
+    uint16_t cd;
+
+    /**
+     * @brief Fractional part of the clock divider in eighths, US_BRGR FP field.
+     *
+     */
+    uint8_t fp;
+
+    /**
+     * @brief 8x instead of 16x oversampling, US_MR OVER bit.
+     *
+     */
+    bool over;
+
+    /**
+     * @brief Baudrate achieved with these settings.
+     *
+     */
+    uint32_t actual;
+
+    /**
+     * @brief Difference between the requested and achieved baudrate, in parts per million.
+     *
+     */
+    uint32_t errorPpm;
+
+    /**
+     * @brief False when the clock divider is out of range, the requested baudrate cannot be reached.
+     *
+     */
+    bool valid;
+};
+
+/**
+ * @brief Error up to which 16x oversampling is preferred, as it is more tolerant to noise than 8x oversampling.
+ *
+ */
+constexpr uint32_t preferredOversamplingErrorPpm = 5000;
+
+/**
+ * @brief Calculate the baudrate generator settings for one oversampling mode.
+ *
+ * @param masterClock Master clock frequency.
+ * @param baudrate Requested baudrate.
+ * @param over 8x instead of 16x oversampling.
+ * @return BaudRateConfig Settings, with the divider clamped to its range when invalid.
+ */
+constexpr BaudRateConfig computeBaudRate(uint32_t masterClock, uint32_t baudrate, bool over) {
+    uint64_t sampling = over ? 8 : 16;
+
+    ///< Divider in eighths, rounded to the nearest value.
+    uint64_t divider = baudrate == 0 ? 0 : (8ull * masterClock + sampling * baudrate / 2) / (sampling * baudrate);
+    bool valid = divider >= 8 && divider <= 0xFFFFull * 8 + 7;
+
+    if (divider < 8) {
+        divider = 8;
+    } else if (divider > 0xFFFFull * 8 + 7) {
+        divider = 0xFFFFull * 8 + 7;
+    }
+
+    uint32_t actual = static_cast<uint32_t>(8ull * masterClock / (sampling * divider));
+    uint32_t difference = actual > baudrate ? actual - baudrate : baudrate - actual;
+    uint32_t errorPpm = baudrate == 0 ? 1000000u : static_cast<uint32_t>(1000000ull * difference / baudrate);
+    uint16_t cd = static_cast<uint16_t>(divider / 8);
+    uint8_t fp = static_cast<uint8_t>(divider % 8);
+
+    return BaudRateConfig{baudrate, cd, fp, over, actual, errorPpm, valid};
+}
+
+/**
+ * @brief Calculate the baudrate generator settings, picking the oversampling mode.
+ *
+ * 16x oversampling is used when it reaches the baudrate within preferredOversamplingErrorPpm. Otherwise the mode with the
+ * smallest error is used, which allows rates like 921600 baud and above.
+ *
+ * @param masterClock Master clock frequency.
+ * @param baudrate Requested baudrate.
+ * @return BaudRateConfig Settings.
+ */
+constexpr BaudRateConfig computeBaudRate(uint32_t masterClock, uint32_t baudrate) {
+    BaudRateConfig normal = computeBaudRate(masterClock, baudrate, false);
+    BaudRateConfig fast = computeBaudRate(masterClock, baudrate, true);
+
+    if (normal.valid && (normal.errorPpm <= preferredOversamplingErrorPpm || !fast.valid || normal.errorPpm <= fast.errorPpm)) {
+        return normal;
+    }
+
+    return fast;
+}
+
+/**
+ * @brief Baudrate generator settings calculated at compile time.
+ *
+ * Fails to compile when the baudrate cannot be reached, or only with an error above MAX_ERROR_PPM.
+ *
+ * @tparam BAUDRATE Requested baudrate.
+ * @tparam MAX_ERROR_PPM Largest acceptable error in parts per million, 2% by default.
+ * @tparam MASTER_CLOCK Master clock frequency.
+ */
+template <uint32_t BAUDRATE, uint32_t MAX_ERROR_PPM = 20000, uint32_t MASTER_CLOCK = masterClockFrequency>
+struct BaudRate {
+    static constexpr BaudRateConfig config = computeBaudRate(MASTER_CLOCK, BAUDRATE);
+
+    static_assert(config.valid, "Baudrate out of range of the baudrate generator");
+    static_assert(config.errorPpm <= MAX_ERROR_PPM, "Baudrate error above the acceptable maximum");
+};
+
+template <uint32_t BAUDRATE, uint32_t MAX_ERROR_PPM, uint32_t MASTER_CLOCK>
+constexpr BaudRateConfig BaudRate<BAUDRATE, MAX_ERROR_PPM, MASTER_CLOCK>::config;
+
+} // namespace UARTLib
+
+#endif
@@ -0,0 +1,124 @@
+/**
+ * @file
+ * @brief     Pool of fixed-size memory blocks, used to hand whole messages to the transmitter without the heap.
+ * @author    Wiebe van Breukelen
+ * @license   See LICENSE
+ */
+
+#ifndef BLOCK_POOL_HPP
+#define BLOCK_POOL_HPP
+
+#include "queue.hpp"
+#include "wrap-hwlib.hpp"
+
+namespace UARTLib {
+
+/**
+ * @brief Pool of fixed-size blocks, without the block size and count.
+ *
+ * Lets the transmit path return a block to the pool it came from, see MessageTransmitter.
+ */
+class BlockPoolBase {
+  public:
+    /**
+     * @brief Take a free block.
+     *
+     * @return uint8_t* Block of blockSize() bytes, nullptr when every block is in use.
+     */
+    virtual uint8_t *allocate() = 0;
+
+    /**
+     * @brief Return a block to the pool.
+     *
+     * @param block Block taken using allocate().
+     */
+    virtual void release(const uint8_t *block) = 0;
+
+    /**
+     * @brief Get the size of each block.
+     *
+     * @return size_t Size in bytes.
+     */
+    virtual size_t blockSize() const = 0;
+
+    /**
+     * @brief Check how many blocks are free.
+     *
+     * @return size_t Amount of free blocks.
+     */
+    virtual size_t available() = 0;
+};
+
+/**
+ * @brief Pool of BLOCK_COUNT blocks of BLOCK_SIZE bytes, allocated and released in constant time.
+ *
+ * The indices of the free blocks are kept in a Queue, so like the Queue, one side may allocate from the main loop while the
+ * other side releases from an interrupt handler, without disabling interrupts. Releasing from both sides at once is not
+ * supported.
+ *
+ * @tparam BLOCK_SIZE Size of each block in bytes.
+ * @tparam BLOCK_COUNT Amount of blocks, a power of two.
+ */
+template <size_t BLOCK_SIZE, size_t BLOCK_COUNT>
+class BlockPool : public BlockPoolBase {
+    static_assert(BLOCK_SIZE > 0, "Blocks must hold at least one byte");
+    static_assert(BLOCK_COUNT >= 1 && (BLOCK_COUNT & (BLOCK_COUNT - 1)) == 0, "Block count must be a power of two");
+
+  public:
+    typedef typename QueueIndexType<BLOCK_COUNT <= 256, BLOCK_COUNT <= 65536>::type index_type;
+
+    /**
+     * @brief Construct a new BlockPool object, every block free.
+     *
+     */
+    BlockPool() {
+        for (size_t i = 0; i < BLOCK_COUNT; i++) {
+            freeBlocks.push(static_cast<index_type>(i));
+        }
+    }
+
+    BlockPool(const BlockPool &) = delete;
+    BlockPool &operator=(const BlockPool &) = delete;
+
+    uint8_t *allocate() override {
+        if (freeBlocks.count() == 0) {
+            return nullptr;
+        }
+
+        return blocks[freeBlocks.pop()];
+    }
+
+    void release(const uint8_t *block) override {
+        freeBlocks.push(static_cast<index_type>((block - blocks[0]) / BLOCK_SIZE));
+    }
+
+    size_t blockSize() const override {
+        return BLOCK_SIZE;
+    }
+
+    size_t available() override {
+        return freeBlocks.count();
+    }
+
+    /**
+     * @brief Check if a block belongs to this pool.
+     *
+     * @param block Block.
+     * @return true Taken from this pool.
+     * @return false Other memory.
+     */
+    bool owns(const uint8_t *block) const {
+        return block >= blocks[0] && block < blocks[0] + BLOCK_SIZE * BLOCK_COUNT && (block - blocks[0]) % BLOCK_SIZE == 0;
+    }
+
+  private:
+    ///< Word aligned, so blocks can be handed to the DMA controller or hold word sized fields.
+    alignas(uintptr_t) uint8_t blocks[BLOCK_COUNT][BLOCK_SIZE];
+
+    ///< One slot more than there are blocks, as the Queue keeps one free.
+    Queue<index_type, 2 * BLOCK_COUNT> freeBlocks;
+};
+
+} // namespace UARTLib
+
+#endif
@@ -0,0 +1,103 @@
+#include "buffered_output.hpp"
+
+namespace UARTLib {
+
+BufferedOutputBase::BufferedOutputBase(UARTConnection &connection, uint8_t *storage, size_t size)
+    : connection(connection), current(storage), other(storage + size / 2), halfSize(size / 2), fill(0), flushOnNewline(true),
+      droppedCharacters(0) {
+}
+
+BufferedOutputBase::~BufferedOutputBase() {
+    ///< Wait for the connection to take every staged character, as long as it keeps taking some.
+    size_t staged;
+    do {
+        staged = fill;
+        flush();
+        connection.flush();
+    } while (fill > 0 && fill < staged);
+}
+
+void BufferedOutputBase::setFlushOnNewline(bool enabled) {
+    flushOnNewline = enabled;
+}
+
+size_t BufferedOutputBase::pending() const {
+    return fill;
+}
+
+uint8_t *BufferedOutputBase::reserve(size_t length) {
+    if (length > halfSize) {
+        return nullptr;
+    }
+
+    if (halfSize - fill < length) {
+        flush();
+    }
+
+    ///< The connection did not take enough of the staged characters to make room.
+    if (halfSize - fill < length) {
+        return nullptr;
+    }
+
+    return current + fill;
+}
+
+void BufferedOutputBase::commit(size_t length) {
+    fill += length;
+
+    if (fill == halfSize) {
+        flush();
+    }
+}
+
+void BufferedOutputBase::putc(char c) {
+    ///< Only full when the connection did not take any of the staged characters on the last flush().
+    if (fill == halfSize) {
+        flush();
+
+        if (fill == halfSize) {
+            droppedCharacters++;
+            return;
+        }
+    }
+
+    current[fill++] = static_cast<uint8_t>(c);
+
+    if (fill == halfSize || (c == '\n' && flushOnNewline)) {
+        flush();
+    }
+}
+
+void BufferedOutputBase::flush() {
+    if (fill == 0) {
+        return;
+    }
+
+    ///< Never wait for room in the transmit buffer. What does not fit stays staged, the next flush() sends it.
+    size_t sent = connection.trySend(current, fill);
+    if (sent < fill) {
+        for (size_t i = sent; i < fill; i++) {
+            current[i - sent] = current[i];
+        }
+
+        fill -= sent;
+        return;
+    }
+
+    uint8_t *next = other;
+    other = current;
+    current = next;
+    fill = 0;
+
+    ///< In DMA transmit mode, the half sent before may still be in use. Transfers complete in order, so it is free once no
+    ///< more than the half just sent is pending. The other transfer modes copied the half into the transmit buffer.
+    if (connection.getTransmitMode() == TransferMode::DMA && connection.txPending() > sent) {
+        connection.flush();
+    }
+}
+
+size_t BufferedOutputBase::dropped() const {
+    return droppedCharacters;
+}
+
+} // namespace UARTLib
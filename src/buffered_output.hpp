@@ -0,0 +1,150 @@
+/**
+ * @file
+ * @brief     Buffered hwlib::ostream, sending formatted output in bulk.
+ * @author    Wiebe van Breukelen
+ * @license   See LICENSE
+ */
+
+#ifndef BUFFERED_OUTPUT_HPP
+#define BUFFERED_OUTPUT_HPP
+
+#include "uart_connection.hpp"
+#include "wrap-hwlib.hpp"
+
+namespace UARTLib {
+
+/**
+ * @brief Output stream collecting characters in a staging buffer, sent with a single bulk send.
+ *
+ * Streaming into a UARTConnection directly costs a virtual putc() and a sendByte() per character. This stream only appends
+ * characters to a staging buffer, and hands the buffer to the connection at once on flush(), on a newline (unless disabled)
+ * or when full. In DMA transmit mode the buffer is sent straight from memory.
+ *
+ * The staging buffer is split in two halves. While one half is being sent, the other one is filled. In DMA transmit mode,
+ * before filling a half again, the stream waits until the connection has sent it, using txPending(). The stream never waits
+ * for room in the transmit buffer: what the connection does not take stays staged, and is sent by the next flush(). Characters
+ * arriving while the staging buffer is still full are dropped, see dropped().
+ *
+ * For example:
+ *
+ *     UARTLib::BufferedOutput<128> out(conn);
+ *     out << "Temperature: " << temperature << "\n"; // Sent as a single transfer
+ */
+class BufferedOutputBase : public hwlib::ostream {
+  public:
+    /**
+     * @brief Construct a new BufferedOutputBase object.
+     *
+     * @param connection Connection to send on.
+     * @param storage Staging buffer.
+     * @param size Size of the staging buffer, holding two halves.
+     */
+    BufferedOutputBase(UARTConnection &connection, uint8_t *storage, size_t size);
+
+    BufferedOutputBase(const BufferedOutputBase &) = delete;
+    BufferedOutputBase &operator=(const BufferedOutputBase &) = delete;
+
+    /**
+     * @brief Select if a newline sends the staging buffer.
+     *
+     * @param enabled Send on a newline, enabled by default.
+     */
+    void setFlushOnNewline(bool enabled);
+
+    /**
+     * @brief Get the amount of characters staged, not yet handed to the connection.
+     *
+     * @return size_t Amount of characters.
+     */
+    size_t pending() const;
+
+    /**
+     * @brief Reserve room in the staging buffer, to write into directly, e.g. by a Schema.
+     *
+     * Sends the staged characters first when there is not enough room left. Follow up with commit().
+     *
+     * @param length Amount of bytes to reserve, at most half the size of the staging buffer.
+     * @return uint8_t* Reserved room, nullptr when length is too large, or the connection did not take enough of the staged
+     * characters to make room.
+     */
+    uint8_t *reserve(size_t length);
+
+    /**
+     * @brief Add bytes written into reserved room to the staged characters.
+     *
+     * @param length Amount of bytes written, at most the amount reserved.
+     */
+    void commit(size_t length);
+
+    /**
+     * @brief Append a character to the staging buffer.
+     *
+     * @param c Character.
+     */
+    void putc(char c) override;
+
+    /**
+     * @brief Hand the staged characters to the connection.
+     *
+     * Does not wait until they have been transmitted, use the flush() of the connection for that. What does not fit in the
+     * transmit buffer of the connection stays staged, call flush() again once the connection made room, e.g. after service().
+     */
+    void flush() override;
+
+    /**
+     * @brief Get the amount of characters dropped, as the staging buffer was full.
+     *
+     * @return size_t Amount of characters.
+     */
+    size_t dropped() const;
+
+    /**
+     * @brief Destroy the BufferedOutputBase object, sending what has been staged and waiting until it has been transmitted.
+     *
+     */
+    ~BufferedOutputBase();
+
+  private:
+    UARTConnection &connection;
+
+    ///< Start of the half being filled.
+    uint8_t *current;
+
+    ///< Start of the half being sent.
+    uint8_t *other;
+
+    size_t halfSize;
+
+    ///< Amount of characters in the half being filled.
+    size_t fill;
+
+    bool flushOnNewline;
+
+    size_t droppedCharacters;
+};
+
+/**
+ * @brief BufferedOutputBase with a staging buffer of a chosen size.
+ *
+ * @tparam SIZE Size of the staging buffer, twice the largest amount of characters sent at once.
+ */
+template <size_t SIZE>
+class BufferedOutput : public BufferedOutputBase {
+    static_assert(SIZE >= 2 && SIZE % 2 == 0, "Staging buffer size must be even");
+
+  public:
+    /**
+     * @brief Construct a new BufferedOutput object.
+     *
+     * @param connection Connection to send on.
+     */
+    explicit BufferedOutput(UARTConnection &connection) : BufferedOutputBase(connection, storage, SIZE) {
+    }
+
+  private:
+    uint8_t storage[SIZE];
+};
+
+} // namespace UARTLib
+
+#endif
@@ -0,0 +1,172 @@
+/**
+ * @file
+ * @brief     FIFO byte buffer using storage provided by its owner.
+ * @author    Wiebe van Breukelen
+ * @license   See LICENSE
+ */
+
+#ifndef BYTE_BUFFER_HPP
+#define BYTE_BUFFER_HPP
+
+#include "byte_span.hpp"
+#include "queue.hpp"
+#include "wrap-hwlib.hpp"
+
+namespace UARTLib {
+
+/**
+ * @brief Lock-free single producer, single consumer byte FIFO over storage provided by its owner.
+ *
+ * A Queue of bytes, its capacity is chosen at runtime by the size of the storage. This lets a connection be compiled once,
+ * while its owner decides how much memory the buffers take. The storage size must be a power of two, one byte of it is kept
+ * free to tell a full buffer from an empty one.
+ *
+ * Next to dropping new bytes when full, the producer can overwrite the oldest byte using pushOverwrite(), once allowed using
+ * setOverwriting(). Only then the consumer side advances the front index using compare and swap.
+ *
+ * The consumer can search the buffered bytes using find(), which remembers how far it got, so bytes are only searched once.
+ */
+class ByteBuffer : public Queue<uint8_t, 0, OverwritableFront> {
+  public:
+    /**
+     * @brief Construct a new ByteBuffer object over an array.
+     *
+     * @tparam SIZE Size of the array, a power of two.
+     * @param storage Array holding the buffered bytes.
+     */
+    template <size_t SIZE>
+    explicit ByteBuffer(uint8_t (&storage)[SIZE]) : Queue(storage), _scanFront(0), _scanned(0), _scanValue(0) {
+    }
+
+    /**
+     * @brief Remove the oldest byte, consumer side.
+     *
+     * @return uint8_t Oldest byte, 0 when empty.
+     */
+    uint8_t pop() {
+        uint32_t front = Queue::front();
+        uint8_t b = Queue::pop();
+
+        removed(front);
+
+        return b;
+    }
+
+    /**
+     * @brief Remove up to n bytes, consumer side.
+     *
+     * @param items Array to copy into.
+     * @param n Size of the array.
+     * @return size_t Amount of bytes removed.
+     */
+    size_t pop(uint8_t *items, size_t n) {
+        uint32_t front = Queue::front();
+        size_t taken = Queue::pop(items, n);
+
+        removed(front);
+
+        return taken;
+    }
+
+    /**
+     * @brief Remove up to n bytes without reading them, consumer side.
+     *
+     * @param n Amount of bytes.
+     */
+    void drop(size_t n) {
+        uint32_t front = Queue::front();
+
+        Queue::drop(n);
+        removed(front);
+    }
+
+    /**
+     * @brief Remove every byte, consumer side.
+     *
+     */
+    void clear() {
+        drop(capacity());
+    }
+
+    /**
+     * @brief Find a byte in the buffered bytes, consumer side.
+     *
+     * Remembers how many of the oldest bytes have been searched already, so calling it again after more bytes arrived only
+     * searches the new ones. Removing bytes keeps the remembered position. Searching for another byte, or bytes dropped by
+     * pushOverwrite(), make the next call search from the front again.
+     *
+     * @param value Byte to find.
+     * @param position Set to the position of the oldest occurrence, counted from the oldest byte.
+     * @return true Found.
+     * @return false Not buffered.
+     */
+    bool find(uint8_t value, size_t &position) {
+        const uint8_t *first;
+        const uint8_t *second;
+        size_t firstLength;
+        size_t secondLength;
+        size_t available = peekRegions(first, firstLength, second, secondLength);
+
+        ///< The second region always starts at the start of the storage, so this is the front index.
+        uint32_t front = static_cast<uint32_t>(first - second);
+        if (front != _scanFront || value != _scanValue) {
+            _scanFront = front;
+            _scanValue = value;
+            _scanned = 0;
+        }
+
+        size_t offset = _scanned;
+        if (offset < firstLength) {
+            offset += findByte(first + offset, firstLength - offset, value);
+        }
+
+        if (offset >= firstLength && offset < available) {
+            offset += findByte(second + (offset - firstLength), available - offset, value);
+        }
+
+        ///< A found byte is found again right away by the next call, until it is removed.
+        _scanned = offset;
+        position = offset;
+
+        return offset < available;
+    }
+
+  private:
+    ///< Front index at the last find() or removal, and the amount of bytes from there known not to hold the byte searched for.
+    uint32_t _scanFront;
+    size_t _scanned;
+    uint8_t _scanValue;
+
+    /**
+     * @brief Keep the search position of find() after removing bytes, consumer side.
+     *
+     * Bytes the producer overwrote in the meantime count as removed as well.
+     *
+     * @param front Front index the bytes were removed from.
+     */
+    void removed(uint32_t front) {
+        uint32_t next = Queue::front();
+        size_t taken = (next - front) & capacity();
+
+        _scanned = (front == _scanFront && _scanned > taken) ? _scanned - taken : 0;
+        _scanFront = next;
+    }
+};
+
+/**
+ * @brief Storage of the receive and transmit buffers of a connection.
+ *
+ * Inherited before the connection itself, so the storage exists before the connection is constructed.
+ *
+ * @tparam RX_BUFFER_SIZE Size of the receive buffer, a power of two.
+ * @tparam TX_BUFFER_SIZE Size of the transmit buffer, a power of two.
+ */
+template <size_t RX_BUFFER_SIZE, size_t TX_BUFFER_SIZE>
+struct BufferStorage {
+    uint8_t rxStorage[RX_BUFFER_SIZE];
+    uint8_t txStorage[TX_BUFFER_SIZE];
+};
+
+} // namespace UARTLib
+
+#endif
@@ -0,0 +1,82 @@
+/**
+ * @file
+ * @brief     Contiguous, read-only range of bytes.
+ * @author    Wiebe van Breukelen
+ * @license   See LICENSE
+ */
+
+#ifndef BYTE_SPAN_HPP
+#define BYTE_SPAN_HPP
+
+#include "wrap-hwlib.hpp"
+
+namespace UARTLib {
+
+/**
+ * @brief Contiguous, read-only range of bytes, pointing into memory owned by someone else.
+ *
+ */
+struct ByteSpan {
+    /**
+     * @brief First byte of the range.
+     *
+     */
+    const uint8_t *data;
+
+    /**
+     * @brief Amount of bytes in the range.
+     *
+     */
+    size_t length;
+};
+
+/**
+ * @brief Find the first occurrence of a byte in a contiguous range of bytes.
+ *
+ * Compares a machine word at a time (SWAR). XOR-ing a word with the byte repeated in every lane turns a match into a zero lane,
+ * and (x - 0x01..01) & ~x & 0x80..80 is only non-zero for a word x holding a zero lane. Only that word is searched byte by
+ * byte.
+ *
+ * @param data Range of bytes.
+ * @param length Length of the range.
+ * @param value Byte to find.
+ * @return size_t Index of the first occurrence, length when not found.
+ */
+inline size_t findByte(const uint8_t *data, size_t length, uint8_t value) {
+    typedef uintptr_t Word;
+    constexpr Word ones = ~static_cast<Word>(0) / 0xFF;
+    constexpr Word highs = ones * 0x80;
+
+    size_t i = 0;
+
+    ///< Byte by byte up to the first aligned word.
+    for (; i < length && (reinterpret_cast<uintptr_t>(data + i) & (sizeof(Word) - 1)) != 0; i++) {
+        if (data[i] == value) {
+            return i;
+        }
+    }
+
+    const Word pattern = ones * value;
+    for (; i + sizeof(Word) <= length; i += sizeof(Word)) {
+        Word word;
+        __builtin_memcpy(&word, data + i, sizeof(Word));
+        word ^= pattern;
+
+        if (((word - ones) & ~word & highs) != 0) {
+            break;
+        }
+    }
+
+    ///< The word holding the match, or the bytes after the last whole word.
+    for (; i < length; i++) {
+        if (data[i] == value) {
+            return i;
+        }
+    }
+
+    return length;
+}
+
+} // namespace UARTLib
+
+#endif
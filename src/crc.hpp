@@ -0,0 +1,244 @@
+/**
+ * @file
+ * @brief     Table driven CRC-8, CRC-16 and CRC-32, with tables generated at compile time.
+ * @author    Wiebe van Breukelen
+ * @license   See LICENSE
+ */
+
+#ifndef CRC_HPP
+#define CRC_HPP
+
+#include "byte_span.hpp"
+#include "wrap-hwlib.hpp"
+
+namespace UARTLib {
+
+/**
+ * @brief CRC lookup tables, one per byte processed at once.
+ *
+ * @tparam T CRC register type.
+ * @tparam SLICES Amount of tables.
+ */
+template <class T, size_t SLICES>
+struct CrcTable {
+    T entries[SLICES][256];
+};
+
+/**
+ * @brief Reverse the bit order of a value.
+ *
+ * @tparam T Value type.
+ * @param value Value.
+ * @return T Value with its bits reversed.
+ */
+template <class T>
+constexpr T reflectBits(T value) {
+    T result = 0;
+    for (size_t i = 0; i < sizeof(T) * 8; i++) {
+        result = static_cast<T>((result << 1) | ((value >> i) & 1));
+    }
+
+    return result;
+}
+
+/**
+ * @brief Generate the lookup tables of a CRC.
+ *
+ * The first table holds the CRC of every byte value. Every next table holds the CRC of a byte value followed by one more zero
+ * byte, used by slicing to process several bytes at once.
+ *
+ * @tparam T CRC register type.
+ * @tparam POLY Polynomial, in normal (not reflected) notation.
+ * @tparam REFLECTED Data and CRC are processed least significant bit first.
+ * @tparam SLICES Amount of tables.
+ * @return CrcTable<T, SLICES> Tables.
+ */
+template <class T, T POLY, bool REFLECTED, size_t SLICES>
+constexpr CrcTable<T, SLICES> makeCrcTable() {
+    CrcTable<T, SLICES> table{};
+    constexpr size_t width = sizeof(T) * 8;
+    constexpr T topBit = static_cast<T>(T(1) << (width - 1));
+
+    for (size_t i = 0; i < 256; i++) {
+        T crc = REFLECTED ? static_cast<T>(i) : static_cast<T>(static_cast<T>(i) << (width - 8));
+
+        for (int bit = 0; bit < 8; bit++) {
+            if (REFLECTED) {
+                crc = (crc & 1) != 0 ? static_cast<T>((crc >> 1) ^ reflectBits(POLY)) : static_cast<T>(crc >> 1);
+            } else {
+                crc = (crc & topBit) != 0 ? static_cast<T>((crc << 1) ^ POLY) : static_cast<T>(crc << 1);
+            }
+        }
+
+        table.entries[0][i] = crc;
+    }
+
+    for (size_t slice = 1; slice < SLICES; slice++) {
+        for (size_t i = 0; i < 256; i++) {
+            T previous = table.entries[slice - 1][i];
+            table.entries[slice][i] = static_cast<T>((previous >> 8) ^ table.entries[0][previous & 0xFF]);
+        }
+    }
+
+    return table;
+}
+
+/**
+ * @brief Table driven CRC, calculated incrementally.
+ *
+ * Feed bytes using update() as they arrive, e.g. right after receive(), and read the result using value(). The lookup tables
+ * are generated at compile time and stored in flash.
+ *
+ * With SLICES set to 4, four bytes are processed per step using four tables (slicing-by-4). That takes four times the flash
+ * (4 KiB for CRC-32), and is only available for reflected 32 bit CRCs.
+ *
+ * @tparam T CRC register type, uint8_t, uint16_t or uint32_t.
+ * @tparam POLY Polynomial, in normal (not reflected) notation.
+ * @tparam INIT Initial value of the CRC register.
+ * @tparam REFLECTED Data and CRC are processed least significant bit first.
+ * @tparam XOR_OUT Value xor-ed with the CRC register to give the result.
+ * @tparam SLICES Amount of bytes processed at once, 1 or 4.
+ */
+template <class T, T POLY, T INIT, bool REFLECTED, T XOR_OUT, size_t SLICES = 1>
+class Crc {
+    static_assert(SLICES == 1 || (SLICES == 4 && REFLECTED && sizeof(T) == 4), "Slicing-by-4 needs a reflected 32 bit CRC");
+
+  public:
+    /**
+     * @brief Lookup tables.
+     *
+     */
+    static constexpr CrcTable<T, SLICES> table = makeCrcTable<T, POLY, REFLECTED, SLICES>();
+
+    Crc() : crc(INIT) {
+    }
+
+    /**
+     * @brief Start a new calculation.
+     *
+     */
+    void reset() {
+        crc = INIT;
+    }
+
+    /**
+     * @brief Add a byte.
+     *
+     * @param b Byte.
+     */
+    void update(uint8_t b) {
+        crc = step(crc, b);
+    }
+
+    /**
+     * @brief Add an array of bytes.
+     *
+     * @param data Array of bytes.
+     * @param length Length of array.
+     */
+    void update(const uint8_t *data, size_t length) {
+        crc = run(crc, data, length);
+    }
+
+    /**
+     * @brief Add a span of bytes, e.g. one returned by UARTConnection::readableSpans().
+     *
+     * @param span Span of bytes.
+     */
+    void update(const ByteSpan &span) {
+        crc = run(crc, span.data, span.length);
+    }
+
+    /**
+     * @brief Get the CRC of the bytes added so far.
+     *
+     * @return T CRC.
+     */
+    T value() const {
+        return static_cast<T>(crc ^ XOR_OUT);
+    }
+
+    /**
+     * @brief Calculate the CRC of an array of bytes, at compile time when possible.
+     *
+     * @param data Array of bytes.
+     * @param length Length of array.
+     * @return T CRC.
+     */
+    static constexpr T compute(const uint8_t *data, size_t length) {
+        return static_cast<T>(run(INIT, data, length) ^ XOR_OUT);
+    }
+
+    /**
+     * @brief Calculate the CRC of a string, at compile time when possible.
+     *
+     * @param str String.
+     * @return T CRC.
+     */
+    static constexpr T compute(const char *str) {
+        T crc = INIT;
+        for (; *str != '\0'; str++) {
+            crc = step(crc, static_cast<uint8_t>(*str));
+        }
+
+        return static_cast<T>(crc ^ XOR_OUT);
+    }
+
+  private:
+    T crc;
+
+    static constexpr T step(T crc, uint8_t b) {
+        if (REFLECTED) {
+            return static_cast<T>((crc >> 8) ^ table.entries[0][(crc ^ b) & 0xFF]);
+        }
+
+        return static_cast<T>((crc << 8) ^ table.entries[0][((crc >> (sizeof(T) * 8 - 8)) ^ b) & 0xFF]);
+    }
+
+    static constexpr T run(T crc, const uint8_t *data, size_t length) {
+        if (SLICES == 4) {
+            for (; length >= 4; data += 4, length -= 4) {
+                crc ^= static_cast<T>(data[0] | (uint32_t(data[1]) << 8) | (uint32_t(data[2]) << 16) | (uint32_t(data[3]) << 24));
+                crc = table.entries[SLICES - 1][crc & 0xFF] ^ table.entries[SLICES / 2][(crc >> 8) & 0xFF] ^
+                      table.entries[SLICES / 4][(crc >> 16) & 0xFF] ^ table.entries[0][(crc >> 24) & 0xFF];
+            }
+        }
+
+        for (size_t i = 0; i < length; i++) {
+            crc = step(crc, data[i]);
+        }
+
+        return crc;
+    }
+};
+
+template <class T, T POLY, T INIT, bool REFLECTED, T XOR_OUT, size_t SLICES>
+constexpr CrcTable<T, SLICES> Crc<T, POLY, INIT, REFLECTED, XOR_OUT, SLICES>::table;
+
+/**
+ * @brief CRC-8 (polynomial 0x07, SMBus).
+ *
+ */
+typedef Crc<uint8_t, 0x07, 0x00, false, 0x00> Crc8;
+
+/**
+ * @brief CRC-16/CCITT-FALSE (polynomial 0x1021, initial value 0xFFFF).
+ *
+ */
+typedef Crc<uint16_t, 0x1021, 0xFFFF, false, 0x0000> Crc16;
+
+/**
+ * @brief CRC-32 (polynomial 0x04C11DB7, reflected, as used by Ethernet and zlib), one byte at a time.
+ *
+ */
+typedef Crc<uint32_t, 0x04C11DB7, 0xFFFFFFFF, true, 0xFFFFFFFF> Crc32;
+
+/**
+ * @brief CRC-32 using slicing-by-4, faster than Crc32 at the cost of 3 KiB more flash.
+ *
+ */
+typedef Crc<uint32_t, 0x04C11DB7, 0xFFFFFFFF, true, 0xFFFFFFFF, 4> Crc32Slicing;
+
+} // namespace UARTLib
+
+#endif
@@ -0,0 +1,372 @@
+/**
+ * @file
+ * @brief     Ping-pong DMA receiver, using the USART receiver timeout to split the received data into frames.
+ * @author    Wiebe van Breukelen
+ * @license   See LICENSE
+ */
+
+#ifndef DMA_FRAME_RECEIVER_HPP
+#define DMA_FRAME_RECEIVER_HPP
+
+#include "pdc_channel.hpp"
+#include "queue.hpp"
+#include "wrap-hwlib.hpp"
+
+namespace UARTLib {
+
+/**
+ * @brief A frame received by the DMA controller, as a contiguous span inside one of the receive buffers.
+ *
+ */
+struct DmaFrame {
+    /**
+     * @brief First byte of the frame.
+     *
+     */
+    const uint8_t *data;
+
+    /**
+     * @brief Length of the frame.
+     *
+     */
+    size_t length;
+
+    /**
+     * @brief True when the frame was ended by an idle line, false when it was cut off at the end of a receive buffer.
+     *
+     */
+    bool complete;
+};
+
+/**
+ * @brief Receives frames through the PDC receive channel of a USART controller.
+ *
+ * Two application provided buffers are used as current (US_RPR/US_RCR) and next (US_RNPR/US_RNCR) descriptor. The DMA
+ * controller fills them without any CPU involvement. When the line has been idle for the configured amount of bit periods,
+ * the receiver timeout (US_RTOR) raises the TIMEOUT flag and everything received since the previous frame is handed to the
+ * application as one frame. A buffer is given back to the DMA controller once every frame inside it has been released.
+ *
+ * onEndOfBuffer() and onTimeout() are called from the interrupt handler. releaseFrame() must not be interrupted by them.
+ *
+ * @tparam Registers Register block providing the PDC receive registers, US_RTOR, US_CR, US_IER and US_IDR (e.g. Usart).
+ */
+template <class Registers>
+class DmaFrameReceiver {
+  public:
+    /**
+     * @brief Construct a new DmaFrameReceiver object without buffers.
+     *
+     */
+    DmaFrameReceiver();
+
+    /**
+     * @brief Set the receive buffers.
+     *
+     * @param first First receive buffer.
+     * @param second Second receive buffer.
+     * @param size Size of each buffer, at most PdcChannel::maxTransferLength.
+     */
+    void setBuffers(uint8_t *first, uint8_t *second, size_t size);
+
+    /**
+     * @brief Check if receive buffers have been set.
+     *
+     * @return true Buffers set, the receiver can be started.
+     * @return false No buffers.
+     */
+    bool hasBuffers() const;
+
+    /**
+     * @brief Start receiving into the buffers. Frames that have not been released are discarded.
+     *
+     * @param registers Register block of the USART controller.
+     * @param idleBitPeriods Amount of idle bit periods that end a frame.
+     */
+    void start(Registers &registers, uint16_t idleBitPeriods);
+
+    /**
+     * @brief Stop receiving.
+     *
+     * @param registers Register block of the USART controller.
+     */
+    void stop(Registers &registers);
+
+    /**
+     * @brief Handle the ENDRX flag, raised when the current buffer is full.
+     *
+     * The DMA controller continues in the next buffer by itself. The remainder of the full buffer is handed over as an
+     * incomplete frame.
+     *
+     * @param registers Register block of the USART controller.
+     */
+    void onEndOfBuffer(Registers &registers);
+
+    /**
+     * @brief Handle the TIMEOUT flag, raised when the line has been idle.
+     *
+     * @param registers Register block of the USART controller.
+     */
+    void onTimeout(Registers &registers);
+
+    /**
+     * @brief Check how many frames are waiting to be read.
+     *
+     * @return unsigned int Amount of frames.
+     */
+    unsigned int framesAvailable();
+
+    /**
+     * @brief Get the oldest frame, without releasing it.
+     *
+     * @param frame Set to the oldest frame.
+     * @return true A frame was available.
+     * @return false No frames.
+     */
+    bool peekFrame(DmaFrame &frame);
+
+    /**
+     * @brief Release the oldest frame, its memory may be reused by the DMA controller afterwards.
+     *
+     * @param registers Register block of the USART controller.
+     */
+    void releaseFrame(Registers &registers);
+
+    /**
+     * @brief Check how many frames were lost, as the application did not release frames in time.
+     *
+     * @return unsigned int Amount of frames lost.
+     */
+    unsigned int framesDropped() const;
+
+  private:
+    /**
+     * @brief Frame position within one of the receive buffers.
+     *
+     */
+    struct Entry {
+        uint16_t offset;
+        uint16_t length;
+        uint8_t buffer;
+        bool complete;
+    };
+
+    /**
+     * @brief US_CR, US_IER/US_IDR and US_PTCR bits, see section 35.7 of the SAM3X datasheet. Spelled out, so the register model
+     * needs no device headers.
+     *
+     */
+    static constexpr uint32_t startTimeoutBit = 1u << 11;
+    static constexpr uint32_t endOfReceiveBit = 1u << 3;
+    static constexpr uint32_t timeoutBit = 1u << 8;
+    static constexpr uint32_t receiveEnableBit = 1u << 0;
+    static constexpr uint32_t receiveDisableBit = 1u << 1;
+
+    uint8_t *buffers[2];
+    size_t bufferSize;
+
+    /**
+     * @brief Buffer the DMA controller is writing into, and where the frame in progress starts.
+     *
+     */
+    uint8_t active;
+    size_t frameStart;
+
+    /**
+     * @brief Whether the other buffer is armed in the next descriptor.
+     *
+     */
+    bool nextArmed;
+
+    /**
+     * @brief Whether the DMA controller stopped, as the next buffer was still held by the application.
+     *
+     */
+    bool stalled;
+
+    /**
+     * @brief Amount of unreleased frames inside each buffer.
+     *
+     */
+    uint8_t held[2];
+
+    unsigned int dropped;
+    Queue<Entry, 8> frames;
+
+    /**
+     * @brief Queue a frame for the application.
+     *
+     */
+    void queueFrame(size_t end, bool complete);
+
+    /**
+     * @brief Hand over the remainder of the full buffer and continue in the other one.
+     *
+     */
+    void retireActive();
+
+    /**
+     * @brief Hand buffers without unreleased frames back to the DMA controller.
+     *
+     */
+    void armFreeBuffers(Registers &registers);
+};
+
+template <class Registers>
+DmaFrameReceiver<Registers>::DmaFrameReceiver()
+    : buffers{nullptr, nullptr}, bufferSize(0), active(0), frameStart(0), nextArmed(false), stalled(false), held{0, 0},
+      dropped(0) {
+}
+
+template <class Registers>
+void DmaFrameReceiver<Registers>::setBuffers(uint8_t *first, uint8_t *second, size_t size) {
+    buffers[0] = first;
+    buffers[1] = second;
+    bufferSize = size;
+}
+
+template <class Registers>
+bool DmaFrameReceiver<Registers>::hasBuffers() const {
+    return buffers[0] != nullptr && buffers[1] != nullptr && bufferSize > 0 &&
+           bufferSize <= PdcChannel<Registers>::maxTransferLength;
+}
+
+template <class Registers>
+void DmaFrameReceiver<Registers>::start(Registers &registers, uint16_t idleBitPeriods) {
+    registers.US_PTCR = receiveDisableBit;
+
+    active = 0;
+    frameStart = 0;
+    stalled = false;
+    held[0] = held[1] = 0;
+    frames.clear();
+
+    registers.US_RPR = PdcChannel<Registers>::address(buffers[0]);
+    registers.US_RCR = bufferSize;
+    registers.US_RNPR = PdcChannel<Registers>::address(buffers[1]);
+    registers.US_RNCR = bufferSize;
+    nextArmed = true;
+
+    registers.US_RTOR = idleBitPeriods;
+    registers.US_PTCR = receiveEnableBit;
+    registers.US_IER = endOfReceiveBit | timeoutBit;
+
+    ///< The timeout only starts counting after the first character has been received.
+    registers.US_CR = startTimeoutBit;
+}
+
+template <class Registers>
+void DmaFrameReceiver<Registers>::stop(Registers &registers) {
+    registers.US_IDR = endOfReceiveBit | timeoutBit;
+    registers.US_PTCR = receiveDisableBit;
+}
+
+template <class Registers>
+void DmaFrameReceiver<Registers>::onEndOfBuffer(Registers &registers) {
+    retireActive();
+
+    ///< The ENDRX flag is only cleared by writing a counter, silence it until the next buffer is armed.
+    registers.US_IDR = endOfReceiveBit;
+    armFreeBuffers(registers);
+}
+
+template <class Registers>
+void DmaFrameReceiver<Registers>::onTimeout(Registers &registers) {
+    if (!stalled) {
+        size_t end = registers.US_RPR - PdcChannel<Registers>::address(buffers[active]);
+
+        if (end > frameStart) {
+            queueFrame(end, true);
+        }
+    }
+
+    ///< Clear the TIMEOUT flag and wait for the first character of the next frame.
+    registers.US_CR = startTimeoutBit;
+}
+
+template <class Registers>
+unsigned int DmaFrameReceiver<Registers>::framesAvailable() {
+    return frames.count();
+}
+
+template <class Registers>
+bool DmaFrameReceiver<Registers>::peekFrame(DmaFrame &frame) {
+    if (frames.count() == 0) {
+        return false;
+    }
+
+    Entry entry = frames.peek();
+    frame.data = buffers[entry.buffer] + entry.offset;
+    frame.length = entry.length;
+    frame.complete = entry.complete;
+
+    return true;
+}
+
+template <class Registers>
+void DmaFrameReceiver<Registers>::releaseFrame(Registers &registers) {
+    if (frames.count() == 0) {
+        return;
+    }
+
+    held[frames.pop().buffer]--;
+    armFreeBuffers(registers);
+}
+
+template <class Registers>
+unsigned int DmaFrameReceiver<Registers>::framesDropped() const {
+    return dropped;
+}
+
+template <class Registers>
+void DmaFrameReceiver<Registers>::queueFrame(size_t end, bool complete) {
+    Entry entry = {static_cast<uint16_t>(frameStart), static_cast<uint16_t>(end - frameStart), active, complete};
+    frameStart = end;
+
+    if (frames.push(entry)) {
+        held[active]++;
+    } else {
+        dropped++;
+    }
+}
+
+template <class Registers>
+void DmaFrameReceiver<Registers>::retireActive() {
+    ///< Whatever did not end in an idle line yet is cut off at the end of the buffer.
+    if (frameStart < bufferSize) {
+        queueFrame(bufferSize, false);
+    }
+
+    active ^= 1;
+    frameStart = 0;
+
+    ///< Without an armed next buffer, the DMA controller has nowhere to continue.
+    stalled = !nextArmed;
+    nextArmed = false;
+}
+
+template <class Registers>
+void DmaFrameReceiver<Registers>::armFreeBuffers(Registers &registers) {
+    ///< The current buffer may have filled up while ENDRX was silenced, it is retired like any other full buffer.
+    if (!stalled && !nextArmed && registers.US_RCR == 0) {
+        retireActive();
+    }
+
+    if (stalled && held[active] == 0) {
+        ///< Restart the stalled DMA controller in the current descriptor.
+        registers.US_RPR = PdcChannel<Registers>::address(buffers[active]);
+        registers.US_RCR = bufferSize;
+        stalled = false;
+        registers.US_IER = endOfReceiveBit;
+    }
+
+    if (!stalled && !nextArmed && held[active ^ 1] == 0) {
+        registers.US_RNPR = PdcChannel<Registers>::address(buffers[active ^ 1]);
+        registers.US_RNCR = bufferSize;
+        nextArmed = true;
+        registers.US_IER = endOfReceiveBit;
+    }
+}
+
+} // namespace UARTLib
+
+#endif
@@ -0,0 +1,294 @@
+/**
+ * @file
+ * @brief     Index of the frames in the receive buffer, kept while bytes are received.
+ * @author    Wiebe van Breukelen
+ * @license   See LICENSE
+ */
+
+#ifndef FRAME_INDEX_HPP
+#define FRAME_INDEX_HPP
+
+#include "queue.hpp"
+#include "wrap-hwlib.hpp"
+
+namespace UARTLib {
+
+/**
+ * @brief Used to select what ends a frame in the received bytes.
+ *
+ * None          - Received bytes are not split into frames. Default.
+ * Delimiter     - A delimiter byte ends the frame, it is part of the frame.
+ * Length header - The frame starts with a 1 or 2 byte little endian header, holding the amount of bytes following it.
+ * Idle          - The line going idle for a number of bit periods ends the frame.
+ */
+enum class FrameBoundary { NONE, DELIMITER, LENGTH_HEADER, IDLE };
+
+/**
+ * @brief Condition of a received frame.
+ *
+ * Complete      - Every byte of the frame is in the receive buffer.
+ * Dropped bytes - Bytes of the frame were dropped as the receive buffer was full, they are missing.
+ * Too long      - The frame was cut off at FrameIndex::maxFrameLength bytes, the rest follows as the next frame.
+ */
+enum class FrameStatus { COMPLETE, DROPPED_BYTES, TOO_LONG };
+
+/**
+ * @brief Descriptor of a frame in the receive buffer.
+ *
+ */
+struct FrameDescriptor {
+    /**
+     * @brief Position of the first byte in the received byte stream, counting every byte stored in the receive buffer.
+     *
+     */
+    uint32_t offset;
+
+    /**
+     * @brief Amount of bytes of the frame in the receive buffer, including the delimiter or length header.
+     *
+     */
+    uint16_t length;
+
+    /**
+     * @brief Condition of the frame.
+     *
+     */
+    FrameStatus status;
+
+    /**
+     * @brief Time the first byte was received, using the clock set by FrameIndex::setClock(), 0 without one.
+     *
+     */
+    uint32_t timestamp;
+};
+
+/**
+ * @brief Ring of descriptors of the frames in the receive buffer, filled by the receive path as frame boundaries are found.
+ *
+ * The receive path reports every received byte using received(), and an idle line using idle(). Once a frame has been
+ * received completely, its descriptor is queued, so the application can take whole messages without parsing the received
+ * bytes again. The bytes of a frame are the next length bytes of the receive buffer, as long as the application only takes
+ * whole frames from it. Frames that did not fit in the ring of descriptors are counted by framesDropped(), pop() reports how
+ * many of their bytes precede the frame it takes, so they can be skipped.
+ *
+ * Like the receive buffer, a single producer (the receive path) and a single consumer (the application) are supported. The
+ * overwrite oldest overflow policy removes bytes of indexed frames, it is not supported.
+ */
+class FrameIndex {
+  public:
+    /**
+     * @brief Clock used for the timestamps of frames, e.g. returning hwlib::now_us().
+     *
+     */
+    typedef uint32_t (*Clock)();
+
+    /**
+     * @brief Largest frame, longer frames are cut off.
+     *
+     */
+    static constexpr uint32_t maxFrameLength = 0xFFFF;
+
+    /**
+     * @brief Construct a new FrameIndex object, not splitting the received bytes into frames.
+     *
+     */
+    FrameIndex() : boundary(FrameBoundary::NONE), parameter(0), clock(nullptr), position(0), taken(0), dropped(0) {
+        restart();
+    }
+
+    /**
+     * @brief Select what ends a frame. Discards the frames indexed so far, set it before receiving.
+     *
+     * @param boundary What ends a frame.
+     * @param parameter Delimiter byte, amount of length header bytes (1 or 2) or amount of idle bit periods.
+     */
+    void setBoundary(FrameBoundary boundary, uint16_t parameter) {
+        this->boundary = boundary;
+        this->parameter = parameter;
+        frames.clear();
+        restart();
+        taken = position;
+    }
+
+    /**
+     * @brief Get what ends a frame.
+     *
+     * @return FrameBoundary What ends a frame.
+     */
+    FrameBoundary getBoundary() const {
+        return boundary;
+    }
+
+    /**
+     * @brief Get the parameter of the frame boundary, e.g. the amount of idle bit periods.
+     *
+     * @return uint16_t Parameter passed to setBoundary().
+     */
+    uint16_t getParameter() const {
+        return parameter;
+    }
+
+    /**
+     * @brief Set the clock used for the timestamps of frames.
+     *
+     * @param clock Clock, nullptr for no timestamps.
+     */
+    void setClock(Clock clock) {
+        this->clock = clock;
+    }
+
+    /**
+     * @brief Account for a received byte, producer side.
+     *
+     * @param b Received byte.
+     * @param stored True when stored in the receive buffer, false when dropped.
+     */
+    void received(uint8_t b, bool stored) {
+        if (boundary == FrameBoundary::NONE) {
+            return;
+        }
+
+        if (!open) {
+            open = true;
+            start = position;
+            status = FrameStatus::COMPLETE;
+            timestamp = clock != nullptr ? clock() : 0;
+            headerReceived = 0;
+            payloadLength = 0;
+        }
+
+        if (stored) {
+            position++;
+        } else {
+            status = FrameStatus::DROPPED_BYTES;
+        }
+
+        if (boundary == FrameBoundary::DELIMITER) {
+            if (b == parameter) {
+                close();
+                return;
+            }
+        } else if (boundary == FrameBoundary::LENGTH_HEADER) {
+            if (headerReceived < parameter) {
+                payloadLength |= static_cast<uint32_t>(b) << (8 * headerReceived++);
+            } else {
+                payloadLength--;
+            }
+
+            if (headerReceived == parameter && payloadLength == 0) {
+                close();
+                return;
+            }
+        }
+
+        if (position - start >= maxFrameLength) {
+            status = FrameStatus::TOO_LONG;
+            close();
+        }
+    }
+
+    /**
+     * @brief Account for the line going idle, producer side. Ends the frame when idle frame boundaries are used.
+     *
+     */
+    void idle() {
+        if (boundary == FrameBoundary::IDLE && open) {
+            close();
+        }
+    }
+
+    /**
+     * @brief Check if a frame is being received, its end has not been found yet.
+     *
+     * @return true Receiving a frame.
+     * @return false Between frames.
+     */
+    bool isOpen() const {
+        return open;
+    }
+
+    /**
+     * @brief Check how many frames have been received, consumer side.
+     *
+     * @return unsigned int Amount of frames.
+     */
+    unsigned int count() {
+        return frames.count();
+    }
+
+    /**
+     * @brief Take the descriptor of the oldest frame, consumer side.
+     *
+     * @param frame Set to the descriptor.
+     * @param skipped Set to the amount of bytes between the end of the previous frame taken and this one, belonging to frames
+     * that were dropped as the ring of descriptors was full.
+     * @return true Taken.
+     * @return false No frame received.
+     */
+    bool pop(FrameDescriptor &frame, uint32_t &skipped) {
+        if (frames.count() == 0) {
+            return false;
+        }
+
+        frame = frames.pop();
+        skipped = frame.offset - taken;
+        taken = frame.offset + frame.length;
+
+        return true;
+    }
+
+    /**
+     * @brief Get the amount of frames not indexed, as the ring of descriptors was full.
+     *
+     * @return uint32_t Amount of frames.
+     */
+    uint32_t framesDropped() const {
+        return dropped;
+    }
+
+  private:
+    FrameBoundary boundary;
+    uint16_t parameter;
+    Clock clock;
+
+    ///< Position of the next byte stored, in the received byte stream.
+    uint32_t position;
+
+    ///< Position following the last frame taken, consumer side.
+    uint32_t taken;
+
+    ///< Frame being received.
+    bool open;
+    uint32_t start;
+    FrameStatus status;
+    uint32_t timestamp;
+    uint16_t headerReceived;
+    uint32_t payloadLength;
+
+    uint32_t dropped;
+
+    Queue<FrameDescriptor, 8> frames;
+
+    void restart() {
+        open = false;
+        start = position;
+        status = FrameStatus::COMPLETE;
+        timestamp = 0;
+        headerReceived = 0;
+        payloadLength = 0;
+    }
+
+    void close() {
+        FrameDescriptor frame = {start, static_cast<uint16_t>(position - start), status, timestamp};
+
+        if (!frames.push(frame)) {
+            dropped++;
+        }
+
+        open = false;
+    }
+};
+
+} // namespace UARTLib
+
+#endif
@@ -0,0 +1,310 @@
+#include "framing.hpp"
+
+namespace UARTLib {
+
+namespace {
+
+///< SLIP special bytes, see RFC 1055.
+constexpr uint8_t slipEnd = 0xC0;
+constexpr uint8_t slipEsc = 0xDB;
+constexpr uint8_t slipEscEnd = 0xDC;
+constexpr uint8_t slipEscEsc = 0xDD;
+
+///< Escape sequences, in static memory as they may be sent using DMA.
+const uint8_t slipEscapedEnd[] = {slipEsc, slipEscEnd};
+const uint8_t slipEscapedEsc[] = {slipEsc, slipEscEsc};
+
+///< Longest run handed to the connection at once, a full COBS block.
+constexpr size_t maxRunLength = 254;
+
+void sendAll(UARTConnection &connection, const uint8_t *data, size_t length) {
+    ///< Waits while the transmit buffer or the DMA descriptors are full. Never for long, as the frame was checked to fit when
+    ///< nothing drains the transmit buffer while waiting.
+    while (length > 0) {
+        size_t sent = connection.trySend(data, length);
+        data += sent;
+        length -= sent;
+    }
+}
+
+///< In cooperative transmit mode only service() drains the transmit buffer, waiting for room would never end.
+bool fits(UARTConnection &connection, size_t encodedLength) {
+    return connection.getTransmitMode() != TransferMode::COOPERATIVE || connection.txFree() >= encodedLength;
+}
+
+} // namespace
+
+bool sendCobsFrame(UARTConnection &connection, const uint8_t *data, size_t length) {
+    if (!connection.isInitialized() || !fits(connection, cobsEncodedLength(length))) {
+        return false;
+    }
+
+    const uint8_t *p = data;
+    const uint8_t *end = data + length;
+
+    while (true) {
+        const uint8_t *run = p;
+        while (p < end && *p != 0 && static_cast<size_t>(p - run) < maxRunLength) {
+            p++;
+        }
+
+        ///< The code byte tells the length of the run, the run itself is sent straight from the message.
+        connection.send(static_cast<uint8_t>(p - run + 1));
+        sendAll(connection, run, p - run);
+
+        if (p == end) {
+            break;
+        }
+
+        ///< A run shorter than a full block ends at a zero byte, which the code byte stands for.
+        if (p - run < static_cast<ptrdiff_t>(maxRunLength)) {
+            p++;
+        }
+    }
+
+    connection.send(static_cast<uint8_t>(0));
+
+    return true;
+}
+
+bool sendSlipFrame(UARTConnection &connection, const uint8_t *data, size_t length) {
+    if (!connection.isInitialized()) {
+        return false;
+    }
+
+    size_t encodedLength = length + 2;
+    for (size_t i = 0; i < length; i++) {
+        encodedLength += data[i] == slipEnd || data[i] == slipEsc ? 1 : 0;
+    }
+
+    if (!fits(connection, encodedLength)) {
+        return false;
+    }
+
+    const uint8_t *p = data;
+    const uint8_t *end = data + length;
+
+    ///< A leading END flushes any line noise received before the frame.
+    connection.send(slipEnd);
+
+    while (p < end) {
+        const uint8_t *run = p;
+        while (p < end && *p != slipEnd && *p != slipEsc && static_cast<size_t>(p - run) < maxRunLength) {
+            p++;
+        }
+
+        sendAll(connection, run, p - run);
+
+        if (p < end && *p == slipEnd) {
+            sendAll(connection, slipEscapedEnd, sizeof(slipEscapedEnd));
+            p++;
+        } else if (p < end && *p == slipEsc) {
+            sendAll(connection, slipEscapedEsc, sizeof(slipEscapedEsc));
+            p++;
+        }
+    }
+
+    connection.send(slipEnd);
+
+    return true;
+}
+
+bool cobsDecodeInPlace(uint8_t *data, size_t length, size_t &decodedLength) {
+    size_t in = 0;
+    size_t out = 0;
+
+    while (in < length) {
+        uint8_t code = data[in++];
+
+        if (code == 0 || in + code - 1 > length) {
+            return false;
+        }
+
+        ///< The output never overtakes the input, so copying forward is safe.
+        for (uint8_t i = 1; i < code; i++) {
+            data[out++] = data[in++];
+        }
+
+        if (code != 0xFF && in < length) {
+            data[out++] = 0;
+        }
+    }
+
+    decodedLength = out;
+
+    return true;
+}
+
+bool slipDecodeInPlace(uint8_t *data, size_t length, size_t &decodedLength) {
+    size_t out = 0;
+
+    for (size_t in = 0; in < length; in++) {
+        if (data[in] == slipEnd) {
+            return false;
+        }
+
+        if (data[in] != slipEsc) {
+            data[out++] = data[in];
+            continue;
+        }
+
+        if (++in == length) {
+            return false;
+        }
+
+        if (data[in] == slipEscEnd) {
+            data[out++] = slipEnd;
+        } else if (data[in] == slipEscEsc) {
+            data[out++] = slipEsc;
+        } else {
+            return false;
+        }
+    }
+
+    decodedLength = out;
+
+    return true;
+}
+
+FrameReader::FrameReader(UARTConnection &connection, uint8_t *buffer, size_t size, FrameEncoding encoding)
+    : connection(connection), buffer(buffer), size(size), encoding(encoding), complete(false), dropped(0) {
+    reset();
+}
+
+bool FrameReader::receive(ByteSpan &frame) {
+    if (complete) {
+        complete = false;
+        reset();
+    }
+
+    ///< In polling mode, this moves received bytes into the receive buffer.
+    connection.available();
+
+    ByteSpan spans[2];
+    connection.readableSpans(spans[0], spans[1]);
+
+    size_t used = 0;
+    for (const ByteSpan &span : spans) {
+        for (size_t i = 0; i < span.length; i++) {
+            used++;
+
+            bool done = encoding == FrameEncoding::COBS ? decodeCobs(span.data[i]) : decodeSlip(span.data[i]);
+            if (done) {
+                connection.consume(used);
+                complete = true;
+                frame.data = buffer;
+                frame.length = length;
+
+                return true;
+            }
+        }
+    }
+
+    connection.consume(used);
+
+    return false;
+}
+
+uint32_t FrameReader::framesDropped() const {
+    return dropped;
+}
+
+void FrameReader::reset() {
+    length = 0;
+    remaining = 0;
+    pendingZero = false;
+    discarding = false;
+}
+
+void FrameReader::discard() {
+    dropped++;
+    discarding = true;
+}
+
+inline void FrameReader::append(uint8_t b) {
+    if (length == size) {
+        discard();
+        return;
+    }
+
+    buffer[length++] = b;
+}
+
+bool FrameReader::decodeCobs(uint8_t b) {
+    if (b == 0) {
+        if (discarding) {
+            reset();
+            return false;
+        }
+
+        ///< A frame ending in the middle of a block has been cut short.
+        if (remaining != 0) {
+            dropped++;
+            reset();
+            return false;
+        }
+
+        ///< Delimiters without a frame in between are ignored.
+        return length > 0 || pendingZero;
+    }
+
+    if (discarding) {
+        return false;
+    }
+
+    if (remaining == 0) {
+        ///< Code byte, the previous block ended with a zero unless it was a full block.
+        if (pendingZero) {
+            append(0);
+        }
+
+        remaining = b - 1;
+        pendingZero = b != 0xFF;
+    } else {
+        append(b);
+        remaining--;
+    }
+
+    return false;
+}
+
+bool FrameReader::decodeSlip(uint8_t b) {
+    if (b == slipEnd) {
+        if (discarding || remaining != 0) {
+            ///< An ESC right before END is malformed.
+            dropped += discarding ? 0 : 1;
+            reset();
+            return false;
+        }
+
+        if (length == 0) {
+            return false;
+        }
+
+        return true;
+    }
+
+    if (discarding) {
+        return false;
+    }
+
+    if (remaining != 0) {
+        remaining = 0;
+
+        if (b == slipEscEnd) {
+            append(slipEnd);
+        } else if (b == slipEscEsc) {
+            append(slipEsc);
+        } else {
+            discard();
+        }
+    } else if (b == slipEsc) {
+        remaining = 1;
+    } else {
+        append(b);
+    }
+
+    return false;
+}
+
+} // namespace UARTLib
@@ -0,0 +1,215 @@
+/**
+ * @file
+ * @brief     COBS and SLIP message framing on top of any UARTConnection.
+ * @author    Wiebe van Breukelen
+ * @license   See LICENSE
+ */
+
+#ifndef FRAMING_HPP
+#define FRAMING_HPP
+
+#include "byte_span.hpp"
+#include "uart_connection.hpp"
+#include "wrap-hwlib.hpp"
+
+namespace UARTLib {
+
+/**
+ * @brief Used to select how messages are framed on the line.
+ *
+ * COBS  - Consistent Overhead Byte Stuffing. Frames end with a zero byte, at most one byte of overhead per 254 bytes.
+ * SLIP  - Serial Line Internet Protocol (RFC 1055). Frames are enclosed in END bytes, END and ESC bytes in the data are escaped.
+ */
+enum class FrameEncoding { COBS, SLIP };
+
+/**
+ * @brief Largest size of a COBS encoded frame, including the delimiter.
+ *
+ * @param length Length of the message.
+ * @return size_t Encoded size.
+ */
+constexpr size_t cobsEncodedLength(size_t length) {
+    return length + length / 254 + 2;
+}
+
+/**
+ * @brief Largest size of a SLIP encoded frame, including both END bytes.
+ *
+ * @param length Length of the message.
+ * @return size_t Encoded size.
+ */
+constexpr size_t slipEncodedLength(size_t length) {
+    return 2 * length + 2;
+}
+
+/**
+ * @brief Send a message as a COBS frame.
+ *
+ * Runs of non-zero bytes are handed to the connection straight from the message, only the COBS code bytes and the delimiter
+ * are sent separately. In DMA transmit mode the message must stay valid until it has been sent, see txPending().
+ *
+ * In cooperative transmit mode, the frame is only sent when all of it fits in the transmit buffer, see txFree(), so it never
+ * waits for service().
+ *
+ * @param connection Connection to send on.
+ * @param data Message.
+ * @param length Length of the message.
+ * @return true Frame sent.
+ * @return false Nothing has been sent, USART controller not initialized or the frame does not fit in cooperative mode.
+ */
+bool sendCobsFrame(UARTConnection &connection, const uint8_t *data, size_t length);
+
+/**
+ * @brief Send a message as a SLIP frame.
+ *
+ * Runs of bytes that need no escaping are handed to the connection straight from the message. In DMA transmit mode the
+ * message must stay valid until it has been sent, see txPending().
+ *
+ * In cooperative transmit mode, the frame is only sent when all of it fits in the transmit buffer, see txFree().
+ *
+ * @param connection Connection to send on.
+ * @param data Message.
+ * @param length Length of the message.
+ * @return true Frame sent.
+ * @return false Nothing has been sent, USART controller not initialized or the frame does not fit in cooperative mode.
+ */
+bool sendSlipFrame(UARTConnection &connection, const uint8_t *data, size_t length);
+
+/**
+ * @brief Decode a COBS frame in place.
+ *
+ * The decoded message is never longer than the frame, so it is written over the frame itself. Useful for frames that are
+ * already contiguous in memory, like the frames of HardwareUART in DMA receive mode.
+ *
+ * @param data Frame, without the delimiter. Overwritten by the message.
+ * @param length Length of the frame.
+ * @param decodedLength Set to the length of the message.
+ * @return true Decoded.
+ * @return false Malformed frame.
+ */
+bool cobsDecodeInPlace(uint8_t *data, size_t length, size_t &decodedLength);
+
+/**
+ * @brief Decode a SLIP frame in place.
+ *
+ * @param data Frame, without the END bytes. Overwritten by the message.
+ * @param length Length of the frame.
+ * @param decodedLength Set to the length of the message.
+ * @return true Decoded.
+ * @return false Malformed frame.
+ */
+bool slipDecodeInPlace(uint8_t *data, size_t length, size_t &decodedLength);
+
+/**
+ * @brief Receives COBS or SLIP frames from a connection.
+ *
+ * Bytes are decoded straight from the receive buffer of the connection (see UARTConnection::readableSpans()) into a frame
+ * buffer of a fixed size, in a single pass. The frame buffer is the only memory used, frames that do not fit are dropped.
+ */
+class FrameReader {
+  public:
+    /**
+     * @brief Construct a new FrameReader object.
+     *
+     * @tparam SIZE Size of the frame buffer, the largest message that can be received.
+     * @param connection Connection to receive from.
+     * @param buffer Frame buffer.
+     * @param encoding Frame encoding.
+     */
+    template <size_t SIZE>
+    FrameReader(UARTConnection &connection, uint8_t (&buffer)[SIZE], FrameEncoding encoding = FrameEncoding::COBS)
+        : FrameReader(connection, buffer, SIZE, encoding) {
+    }
+
+    /**
+     * @brief Construct a new FrameReader object.
+     *
+     * @param connection Connection to receive from.
+     * @param buffer Frame buffer.
+     * @param size Size of the frame buffer, the largest message that can be received.
+     * @param encoding Frame encoding.
+     */
+    FrameReader(UARTConnection &connection, uint8_t *buffer, size_t size, FrameEncoding encoding = FrameEncoding::COBS);
+
+    /**
+     * @brief Receive the next complete frame.
+     *
+     * Decodes whatever has been received so far. The frame stays valid until the next call.
+     *
+     * @param frame Set to the decoded message.
+     * @return true A complete frame has been received.
+     * @return false No complete frame yet.
+     */
+    bool receive(ByteSpan &frame);
+
+    /**
+     * @brief Get the amount of frames dropped, as they were malformed or did not fit the frame buffer.
+     *
+     * @return uint32_t Amount of dropped frames.
+     */
+    uint32_t framesDropped() const;
+
+  private:
+    UARTConnection &connection;
+    uint8_t *buffer;
+    size_t size;
+    FrameEncoding encoding;
+
+    ///< Length of the message decoded so far.
+    size_t length;
+
+    ///< COBS: bytes left in the current block. SLIP: an ESC byte has been received.
+    uint8_t remaining;
+
+    ///< COBS: a zero byte follows the current block, unless the frame ends there.
+    bool pendingZero;
+
+    ///< The current frame is dropped up to the next delimiter.
+    bool discarding;
+
+    ///< The previous call returned a frame, which is released by the next call.
+    bool complete;
+
+    uint32_t dropped;
+
+    /**
+     * @brief Start a new frame.
+     *
+     */
+    void reset();
+
+    /**
+     * @brief Drop the current frame up to the next delimiter.
+     *
+     */
+    void discard();
+
+    /**
+     * @brief Append a decoded byte to the frame.
+     *
+     * @param b Byte.
+     */
+    void append(uint8_t b);
+
+    /**
+     * @brief Decode a received COBS byte.
+     *
+     * @param b Received byte.
+     * @return true The frame is complete.
+     * @return false The frame continues.
+     */
+    bool decodeCobs(uint8_t b);
+
+    /**
+     * @brief Decode a received SLIP byte.
+     *
+     * @param b Received byte.
+     * @return true The frame is complete.
+     * @return false The frame continues.
+     */
+    bool decodeSlip(uint8_t b);
+};
+
+} // namespace UARTLib
+
+#endif
@@ -0,0 +1,91 @@
+/**
+ * @file
+ * @brief     Register level backend for BasicUART, using one of the USART controllers on the Arduino Due.
+ * @author    Wiebe van Breukelen
+ * @license   See LICENSE
+ */
+
+#ifndef HARDWARE_BACKEND_HPP
+#define HARDWARE_BACKEND_HPP
+
+#include "uart_connection.hpp"
+#include "usart_setup.hpp"
+#include "wrap-hwlib.hpp"
+
+namespace UARTLib {
+
+/**
+ * @brief Backend for BasicUART, accessing the registers of a USART controller selected at compile time.
+ *
+ * As the controller is a template parameter, the register block address is a constant and every call inlines to a single
+ * register access.
+ *
+ * @tparam CONTROLLER Controller used to transmit and receive.
+ */
+template <UARTController CONTROLLER>
+class HardwareBackend {
+  public:
+    /**
+     * @brief Set up and enable the USART controller.
+     *
+     * @param baudrate Transmit and receive baudrate.
+     */
+    void begin(unsigned int baudrate) {
+        setupUSART(CONTROLLER, computeBaudRate(masterClockFrequency, baudrate));
+
+        ///< Enable the transmitter and receiver
+        usart()->US_CR = UART_CR_RXEN | UART_CR_TXEN;
+    }
+
+    /**
+     * @brief Check if the transmitter is ready for the next byte.
+     *
+     * @return true Ready to send.
+     * @return false Not ready to send.
+     */
+    bool txReady() {
+        return (usart()->US_CSR & US_CSR_TXRDY) != 0;
+    }
+
+    /**
+     * @brief Write a byte into the US_THR register.
+     *
+     * @param b Byte to send.
+     */
+    void writeByte(uint8_t b) {
+        usart()->US_THR = b;
+    }
+
+    /**
+     * @brief Check if a received byte is waiting in the US_RHR register.
+     *
+     * @return true Byte received.
+     * @return false Nothing received.
+     */
+    bool rxReady() {
+        return (usart()->US_CSR & US_CSR_RXRDY) != 0;
+    }
+
+    /**
+     * @brief Read the US_RHR register.
+     *
+     * @return uint8_t Received byte.
+     */
+    uint8_t readByte() {
+        return usart()->US_RHR;
+    }
+
+  private:
+    /**
+     * @brief Register block of the selected controller.
+     *
+     * @return Usart* Register block.
+     */
+    static Usart *usart() {
+        return CONTROLLER == UARTController::ONE ? USART0 : (CONTROLLER == UARTController::TWO ? USART1 : USART3);
+    }
+};
+
+} // namespace UARTLib
+
+#endif
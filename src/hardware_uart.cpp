@@ -2,98 +2,78 @@
 
 namespace UARTLib {
 
-HardwareUART::HardwareUART(unsigned int baudrate, UARTController controller, bool initializeController)
-    : baudrate(baudrate), controller(controller), USARTControllerInitialized(false) {
+HardwareUARTBase::HardwareUARTBase(ByteBuffer rxBuffer, ByteBuffer txBuffer, unsigned int baudrate, UARTController controller,
+                                   bool initializeController)
+    : baudRate(computeBaudRate(masterClockFrequency, baudrate)), controller(controller), USARTControllerInitialized(false),
+      receiveMode(TransferMode::POLLING), transmitMode(TransferMode::POLLING), rxBuffer(rxBuffer), txBuffer(txBuffer),
+      rxControl(rxBuffer.capacity()), flowControl(FlowControl::NONE), frameIdleBitPeriods(20), pendingControl(0), dmaQueued(0) {
     if (initializeController) {
         begin();
     }
 }
 
-HardwareUART::~HardwareUART() {
+HardwareUARTBase::HardwareUARTBase(ByteBuffer rxBuffer, ByteBuffer txBuffer, const BaudRateConfig &baudRate,
+                                   UARTController controller, bool initializeController)
+    : baudRate(baudRate), controller(controller), USARTControllerInitialized(false), receiveMode(TransferMode::POLLING),
+      transmitMode(TransferMode::POLLING), rxBuffer(rxBuffer), txBuffer(txBuffer), rxControl(rxBuffer.capacity()),
+      flowControl(FlowControl::NONE), frameIdleBitPeriods(20), pendingControl(0), dmaQueued(0) {
+    if (initializeController) {
+        begin();
+    }
+}
+
+HardwareUARTBase::~HardwareUARTBase() {
     ///< Disable the UART controller on destruction
     disable();
+
+    if (USARTControllerInitialized) {
+        ///< Make sure the interrupt handler no longer refers to this object.
+        hardwareUSART->US_IDR = 0xFFFFFFFF;
+        InterruptRouter::detach(controller, this);
+    }
 }
 
-void HardwareUART::begin() {
+void HardwareUARTBase::begin() {
     ///< Only initialize the UART controller if it hasn't been enabled.
     if (USARTControllerInitialized) {
         return;
     }
 
-    ///< Setup the correct USART controller.
-    if (controller == UARTController::ONE) {
-        hardwareUSART = USART0;
-
-        ///< Disable PIO control on PA10, PA11 and set up for peripheral A.
-        PIOA->PIO_PDR = PIO_PA10;
-        PIOA->PIO_ABSR &= ~PIO_PA10;
-        PIOA->PIO_PDR = PIO_PA11;
-        PIOA->PIO_ABSR &= ~PIO_PA11;
-
-        ///< Enable the clock to USART0.
-        PMC->PMC_PCER0 = (0x01 << ID_USART0);
-    } else if (controller == UARTController::TWO) {
-        hardwareUSART = USART1;
+    ///< Setup the correct USART controller, it is left disabled.
+    hardwareUSART = setupUSART(controller, baudRate);
 
-        ///< Disable PIO control on PA12, PA13 and set up for peripheral A.
-        PIOA->PIO_PDR = PIO_PA12;
-        PIOA->PIO_ABSR &= ~PIO_PA12;
-        PIOA->PIO_PDR = PIO_PA13;
-        PIOA->PIO_ABSR &= ~PIO_PA13;
-
-        ///< Enable the clock to USART1.
-        PMC->PMC_PCER0 = (0x01 << ID_USART1);
-    } else {
-        hardwareUSART = USART3;
-
-        ///< Disable PIO control on PD4, PD5 and set up for peripheral B (setting a high bit).
-        ///< Section 31.7.24 -
-        ///< http://ww1.microchip.com/downloads/en/DeviceDoc/Atmel-11057-32-bit-Cortex-M3-Microcontroller-SAM3X-SAM3A_Datasheet.pdf
-        PIOD->PIO_PDR = PIO_PD4;
-        PIOD->PIO_ABSR |= PIO_PD4;
-        PIOD->PIO_PDR = PIO_PD5;
-        PIOD->PIO_ABSR |= PIO_PD5;
-
-        ///< Enable the clock to USART3.
-        PMC->PMC_PCER0 = (0x01 << ID_USART3);
+    if (flowControl == FlowControl::RTS_CTS) {
+        applyFlowControl();
     }
 
-    ///< Disable the UART connection to make changes.
-    disable();
-
-    ///< Set the baudrate to 115200. see page 799
-    ///< Calculation: 5241600 / desired baudrate
-    ///< 115200: 45
-    hardwareUSART->US_BRGR = (5241600u / baudrate);
-
-    ///< No parity, normal channel mode. Use a 8 bit data field.
-    hardwareUSART->US_MR = UART_MR_PAR_NO | UART_MR_CHMODE_NORMAL |
-                           US_MR_CHRL_8_BIT; // Might check if this definition is compatable with USART as well.
-
-    ///< Disable the interrupt controller.
-    hardwareUSART->US_IDR = 0xFFFFFFFF;
+    ///< Route the interrupt of this controller to us. Which interrupts fire is selected using US_IER.
+    InterruptRouter::attach(controller, this);
+    NVIC_EnableIRQ(interruptLine());
 
     ///< Enable the UART controller
     enable();
 
     ///< USART Controller initialized
     USARTControllerInitialized = true;
+
+    applyReceiveMode();
 }
 
-unsigned int HardwareUART::available() {
+unsigned int HardwareUARTBase::available() {
     if (!USARTControllerInitialized) {
         return 0;
     }
 
-    ///< We use the USART Channel status register to check if there is data available.
-    if ((hardwareUSART->US_CSR & 1) != 0) {
-        rxBuffer.push(receiveByte());
+    ///< In interrupt mode, the interrupt handler fills the receive buffer for us.
+    ///< Otherwise we use the USART Channel status register to check if there is data available.
+    if (receiveMode == TransferMode::POLLING) {
+        pollReceive(1);
     }
 
     return rxBuffer.count();
 }
 
-bool HardwareUART::send(const uint8_t b) {
+bool HardwareUARTBase::send(const uint8_t b) {
     if (!USARTControllerInitialized) {
         return false;
     }
@@ -103,7 +83,7 @@ bool HardwareUART::send(const uint8_t b) {
     return true;
 }
 
-bool HardwareUART::send(const uint8_t *str) {
+bool HardwareUARTBase::send(const uint8_t *str) {
     if (!USARTControllerInitialized) {
         return false;
     }
@@ -115,7 +95,7 @@ bool HardwareUART::send(const uint8_t *str) {
     return true;
 }
 
-bool HardwareUART::send(const char *str) {
+bool HardwareUARTBase::send(const char *str) {
     if (!USARTControllerInitialized) {
         return false;
     }
@@ -127,11 +107,38 @@ bool HardwareUART::send(const char *str) {
     return true;
 }
 
-bool HardwareUART::send(const uint8_t *data, size_t length) {
+bool HardwareUARTBase::send(const uint8_t *data, size_t length) {
     if (!USARTControllerInitialized) {
         return false;
     }
 
+    ///< Never wait in cooperative mode, service() has to make room. All bytes are queued, or none.
+    if (transmitMode == TransferMode::COOPERATIVE) {
+        return txFree() >= length && queueBytes(data, length) == length;
+    }
+
+    ///< Only wait when the transmit buffer is full, until the interrupt handler made room.
+    if (transmitMode == TransferMode::INTERRUPT) {
+        size_t queued = 0;
+        while (queued < length) {
+            queued += queueBytes(data + queued, length - queued);
+        }
+
+        return true;
+    }
+
+    ///< Wait for a free descriptor, the PDC moves the next transfer up on its own.
+    if (transmitMode == TransferMode::DMA) {
+        if (length > PdcChannel<Usart>::maxTransferLength) {
+            return false;
+        }
+
+        while (!queueTransfer(data, length))
+            ;
+
+        return true;
+    }
+
     for (unsigned int i = 0; i < length; i++) {
         sendByte(data[i]);
     }
@@ -139,23 +146,387 @@ bool HardwareUART::send(const uint8_t *data, size_t length) {
     return true;
 }
 
-uint8_t HardwareUART::receive() {
+size_t HardwareUARTBase::trySend(const uint8_t *data, size_t length) {
+    if (!USARTControllerInitialized) {
+        return 0;
+    }
+
+    if (transmitMode == TransferMode::INTERRUPT || transmitMode == TransferMode::COOPERATIVE) {
+        return queueBytes(data, length);
+    } else if (transmitMode == TransferMode::DMA) {
+        return queueTransfer(data, length) ? length : 0;
+    }
+
+    for (unsigned int i = 0; i < length; i++) {
+        sendByte(data[i]);
+    }
+
+    return length;
+}
+
+size_t HardwareUARTBase::txPending() {
+    if (transmitMode == TransferMode::DMA && USARTControllerInitialized) {
+        return PdcChannel<Usart>::transmitPending(*hardwareUSART);
+    }
+
+    return txBuffer.count();
+}
+
+size_t HardwareUARTBase::txFree() {
+    if (!USARTControllerInitialized) {
+        return 0;
+    }
+
+    if (transmitMode == TransferMode::INTERRUPT || transmitMode == TransferMode::COOPERATIVE) {
+        return txBuffer.capacity() - txBuffer.count();
+    } else if (transmitMode == TransferMode::DMA) {
+        return PdcChannel<Usart>::canQueueTransmit(*hardwareUSART) ? PdcChannel<Usart>::maxTransferLength : 0;
+    }
+
+    return txReady() ? 1 : 0;
+}
+
+void HardwareUARTBase::flush() {
+    if (!USARTControllerInitialized) {
+        return;
+    }
+
+    ///< In cooperative mode, nobody else drains the transmit buffer.
+    if (transmitMode == TransferMode::COOPERATIVE) {
+        while (txBuffer.count() > 0) {
+            pollTransmit(txBuffer.count());
+        }
+    }
+
+    ///< Likewise, a flow control character left for service() is sent by nobody else in the other transfer modes.
+    while (pendingControl != 0 && transmitMode != TransferMode::INTERRUPT) {
+        emitControl();
+    }
+
+    ///< The interrupt handler disables the TXRDY interrupt once the transmit buffer has been drained.
+    while ((hardwareUSART->US_IMR & US_IMR_TXRDY) != 0)
+        ;
+
+    ///< Likewise, it disables the TXBUFE interrupt once every DMA transfer has completed.
+    while ((hardwareUSART->US_IMR & US_IMR_TXBUFE) != 0)
+        ;
+
+    ///< Wait for the last byte to leave the shift register.
+    while ((hardwareUSART->US_CSR & US_CSR_TXEMPTY) == 0)
+        ;
+}
+
+uint8_t HardwareUARTBase::receive() {
     if (!USARTControllerInitialized || !rxBuffer.count()) {
         return 0;
     }
 
-    return rxBuffer.pop();
+    ///< The receive buffer is a single producer, single consumer queue, safe to pop while the interrupt handler pushes.
+    uint8_t b = rxBuffer.pop();
+    resumeSender();
+
+    return b;
+}
+
+size_t HardwareUARTBase::receive(uint8_t *buf, size_t n) {
+    if (!USARTControllerInitialized) {
+        return 0;
+    }
+
+    size_t received = rxBuffer.pop(buf, n);
+    resumeSender();
+
+    return received;
+}
+
+size_t HardwareUARTBase::readableSpans(ByteSpan &first, ByteSpan &second) {
+    if (!USARTControllerInitialized) {
+        first.length = second.length = 0;
+        return 0;
+    }
+
+    return rxBuffer.peekRegions(first.data, first.length, second.data, second.length);
+}
+
+void HardwareUARTBase::consume(size_t n) {
+    rxBuffer.drop(n);
+
+    if (USARTControllerInitialized) {
+        resumeSender();
+    }
+}
+
+bool HardwareUARTBase::findInBuffer(uint8_t delimiter, size_t &position) {
+    return USARTControllerInitialized && rxBuffer.find(delimiter, position);
 }
 
-bool HardwareUART::isInitialized() {
+bool HardwareUARTBase::isInitialized() {
     return USARTControllerInitialized;
 }
 
-void HardwareUART::putc(char c) {
+unsigned int HardwareUARTBase::actualBaudrate() const {
+    return baudRate.actual;
+}
+
+const BaudRateConfig &HardwareUARTBase::baudRateConfig() const {
+    return baudRate;
+}
+
+void HardwareUARTBase::setReceiveMode(TransferMode mode) {
+    receiveMode = mode;
+
+    ///< When not initialized yet, the mode is applied by begin().
+    if (USARTControllerInitialized) {
+        applyReceiveMode();
+    }
+}
+
+void HardwareUARTBase::setTransmitMode(TransferMode mode) {
+    ///< Hand over whatever is still queued before switching modes.
+    flush();
+
+    if (USARTControllerInitialized) {
+        if (mode == TransferMode::DMA) {
+            PdcChannel<Usart>::enableTransmit(*hardwareUSART);
+        } else {
+            PdcChannel<Usart>::disableTransmit(*hardwareUSART);
+        }
+    }
+
+    transmitMode = mode;
+}
+
+TransferMode HardwareUARTBase::getTransmitMode() const {
+    return transmitMode;
+}
+
+void HardwareUARTBase::setOverflowPolicy(OverflowPolicy policy) {
+    rxControl.setPolicy(policy, rxBuffer);
+
+    ///< Without backpressure, nothing releases a sender that is held off any more.
+    if (policy != OverflowPolicy::BACKPRESSURE && rxControl.isPaused() && USARTControllerInitialized) {
+        releaseSender();
+    }
+}
+
+void HardwareUARTBase::setWatermarks(size_t high, size_t low) {
+    rxControl.setWatermarks(high, low);
+}
+
+bool HardwareUARTBase::setFlowControl(FlowControl mode) {
+    if (mode == FlowControl::RTS_CTS && controller == UARTController::THREE) {
+        return false;
+    }
+
+    flowControl = mode;
+
+    if (mode == FlowControl::RTS_CTS) {
+        rxControl.setPolicy(OverflowPolicy::BACKPRESSURE, rxBuffer);
+    }
+
+    ///< When not initialized yet, the flow control is applied by begin().
+    if (USARTControllerInitialized) {
+        disable();
+        applyFlowControl();
+        enable();
+    }
+
+    return true;
+}
+
+void HardwareUARTBase::setFrameBuffers(uint8_t *first, uint8_t *second, size_t size, uint16_t idleBitPeriods) {
+    frameReceiver.setBuffers(first, second, size);
+    frameIdleBitPeriods = idleBitPeriods;
+}
+
+void HardwareUARTBase::setFrameBoundary(FrameBoundary boundary, uint16_t parameter) {
+    UARTConnection::setFrameBoundary(boundary, parameter);
+
+    if (USARTControllerInitialized) {
+        applyReceiveMode();
+    }
+}
+
+unsigned int HardwareUARTBase::dmaFramesAvailable() {
+    return frameReceiver.framesAvailable();
+}
+
+bool HardwareUARTBase::receiveFrame(DmaFrame &frame) {
+    return frameReceiver.peekFrame(frame);
+}
+
+void HardwareUARTBase::releaseFrame() {
+    if (!USARTControllerInitialized) {
+        return;
+    }
+
+    ///< Releasing may hand a buffer back to the DMA controller, which the interrupt handler does as well.
+    NVIC_DisableIRQ(interruptLine());
+    frameReceiver.releaseFrame(*hardwareUSART);
+    NVIC_EnableIRQ(interruptLine());
+}
+
+void HardwareUARTBase::handleInterrupt() {
+    ///< In polling and cooperative receive mode the main loop is the only one storing received bytes, even while transmit
+    ///< interrupts are serviced.
+    if (receiveMode == TransferMode::DMA) {
+        serviceReceiveDma();
+    } else if (receiveMode == TransferMode::INTERRUPT) {
+        serviceReceive();
+    }
+
+    serviceTransmit();
+    serviceTransmitDma();
+}
+
+inline void HardwareUARTBase::serviceReceive() {
+    uint32_t status = hardwareUSART->US_CSR;
+    recordLineErrors(status);
+    endIdleFrame(status);
+
+    ///< Drain everything the controller has received, so US_RHR cannot be overrun.
+    while ((status & US_CSR_RXRDY) != 0) {
+        storeReceived(receiveByte());
+        status = hardwareUSART->US_CSR;
+    }
+}
+
+inline void HardwareUARTBase::serviceReceiveDma() {
+    uint32_t status = hardwareUSART->US_CSR;
+    recordLineErrors(status);
+
+    ///< A full buffer is handled first, so an idle line right after it ends a frame in the next buffer.
+    if ((hardwareUSART->US_IMR & US_IMR_ENDRX) != 0 && (status & US_CSR_ENDRX) != 0) {
+        frameReceiver.onEndOfBuffer(*hardwareUSART);
+    }
+
+    if ((status & US_CSR_TIMEOUT) != 0) {
+        frameReceiver.onTimeout(*hardwareUSART);
+    }
+}
+
+inline void HardwareUARTBase::serviceTransmit() {
+    if ((hardwareUSART->US_IMR & US_IMR_TXRDY) == 0 || !txReady()) {
+        return;
+    }
+
+    if (emitControl()) {
+        return;
+    }
+
+    if (txBuffer.count() > 0) {
+        hardwareUSART->US_THR = txBuffer.pop();
+        stats.bytesSent++;
+    } else {
+        ///< Nothing left to send, stop the interrupt until new data is queued.
+        hardwareUSART->US_IDR = US_IDR_TXRDY;
+    }
+}
+
+inline void HardwareUARTBase::serviceTransmitDma() {
+    ///< TXBUFE stays set while the channel is idle, so the interrupt is disabled until the next transfer is queued.
+    if ((hardwareUSART->US_IMR & US_IMR_TXBUFE) != 0 && (hardwareUSART->US_CSR & US_CSR_TXBUFE) != 0) {
+        ///< Every queued transfer has completed, like the other transfer modes count bytes once written to US_THR.
+        stats.bytesSent += __atomic_exchange_n(&dmaQueued, 0, __ATOMIC_RELAXED);
+        hardwareUSART->US_IDR = US_IDR_TXBUFE;
+    }
+}
+
+size_t HardwareUARTBase::service(size_t budget) {
+    if (!USARTControllerInitialized) {
+        return 0;
+    }
+
+    size_t moved = emitControl() ? 1 : 0;
+
+    if (receiveMode == TransferMode::POLLING || receiveMode == TransferMode::COOPERATIVE) {
+        moved += pollReceive(budget);
+    }
+
+    if (transmitMode == TransferMode::COOPERATIVE) {
+        moved += pollTransmit(budget);
+    }
+
+    return moved;
+}
+
+size_t HardwareUARTBase::pollReceive(size_t budget) {
+    uint32_t status = hardwareUSART->US_CSR;
+    recordLineErrors(status);
+    endIdleFrame(status);
+
+    size_t received = 0;
+    while (received < budget && (status & US_CSR_RXRDY) != 0) {
+        storeReceived(receiveByte());
+        received++;
+        status = hardwareUSART->US_CSR;
+    }
+
+    return received;
+}
+
+size_t HardwareUARTBase::pollTransmit(size_t budget) {
+    size_t sent = 0;
+    while (sent < budget && txReady()) {
+        if (emitControl()) {
+            sent++;
+            continue;
+        }
+
+        if (txBuffer.count() == 0) {
+            break;
+        }
+
+        hardwareUSART->US_THR = txBuffer.pop();
+        stats.bytesSent++;
+        sent++;
+    }
+
+    return sent;
+}
+
+inline void HardwareUARTBase::storeReceived(uint8_t b) {
+    if (rtsLine.isAttached()) {
+        rtsLine.store(rxControl, rxBuffer, b, stats, &frames);
+    } else if (rxControl.store(rxBuffer, b, stats, &frames)) {
+        sendControl(XOFF);
+    }
+}
+
+inline void HardwareUARTBase::endIdleFrame(uint32_t status) {
+    ///< Only set while idle frame boundaries are used. A character waiting in US_RHR already belongs to the next frame.
+    if ((status & US_CSR_TIMEOUT) != 0) {
+        frames.idle();
+        hardwareUSART->US_CR = US_CR_STTTO;
+    }
+}
+
+inline void HardwareUARTBase::recordLineErrors(uint32_t status) {
+    if ((status & (US_CSR_OVRE | US_CSR_FRAME | US_CSR_PARE)) == 0) {
+        return;
+    }
+
+    if ((status & US_CSR_OVRE) != 0) {
+        stats.recordLineError(LineError::OVERRUN);
+    }
+
+    if ((status & US_CSR_FRAME) != 0) {
+        stats.recordLineError(LineError::FRAMING);
+    }
+
+    if ((status & US_CSR_PARE) != 0) {
+        stats.recordLineError(LineError::PARITY);
+    }
+
+    ///< The error flags are sticky, clear them so the next error is noticed.
+    hardwareUSART->US_CR = US_CR_RSTSTA;
+}
+
+void HardwareUARTBase::putc(char c) {
     sendByte(c);
 }
 
-char HardwareUART::getc() {
+char HardwareUARTBase::getc() {
     if (available() > 0) {
         return receive();
     }
@@ -163,36 +534,209 @@ char HardwareUART::getc() {
     return 0;
 }
 
-bool HardwareUART::char_available() {
+bool HardwareUARTBase::char_available() {
     return (available() > 0);
 }
 
-void HardwareUART::sendByte(const uint8_t &b) {
-    ///< Wait before we can send any more data
-    while (!txReady())
-        ;
+void HardwareUARTBase::sendByte(const uint8_t &b) {
+    if (transmitMode == TransferMode::INTERRUPT) {
+        ///< Only wait when the transmit buffer is full, until the interrupt handler made room.
+        while (queueBytes(&b, 1) == 0)
+            ;
+
+        return;
+    }
+
+    ///< Never wait in cooperative mode, service() has to make room.
+    if (transmitMode == TransferMode::COOPERATIVE) {
+        if (queueBytes(&b, 1) == 0) {
+            stats.txDropped++;
+        }
+
+        return;
+    }
+
+    ///< A single byte does not go through the DMA controller, wait for the transfers in progress to complete.
+    if (transmitMode == TransferMode::DMA) {
+        while (!PdcChannel<Usart>::transmitIdle(*hardwareUSART))
+            ;
+    }
+
+    ///< Wait before we can send any more data, a pending flow control character goes first.
+    do {
+        while (!txReady())
+            ;
+    } while (emitControl());
 
     ///< Send it!
     hardwareUSART->US_THR = b;
+    stats.bytesSent++;
 }
 
-inline uint8_t HardwareUART::receiveByte() {
+uint8_t HardwareUARTBase::receiveByte() {
     return hardwareUSART->US_RHR;
 }
 
-inline bool HardwareUART::txReady() {
+bool HardwareUARTBase::txReady() {
     ///< We use the USART Channel status register to wait until the TXRDY bit is cleared.
     return (hardwareUSART->US_CSR & 2);
 }
 
-inline void HardwareUART::enable() {
+void HardwareUARTBase::sendControl(uint8_t c) {
+    ///< Jumps the queue. A character still waiting is replaced, only the latest state matters to the sender.
+    __atomic_store_n(&pendingControl, c, __ATOMIC_RELEASE);
+
+    if (emitControl()) {
+        return;
+    }
+
+    ///< The transmitter is busy, never wait for it: the interrupt handler or service() sends the character once it is ready.
+    if (transmitMode == TransferMode::INTERRUPT) {
+        hardwareUSART->US_IER = US_IER_TXRDY;
+    }
+}
+
+inline bool HardwareUARTBase::emitControl() {
+    if (pendingControl == 0 || !txReady()) {
+        return false;
+    }
+
+    uint8_t c = __atomic_exchange_n(&pendingControl, 0, __ATOMIC_ACQ_REL);
+    if (c == 0) {
+        return false;
+    }
+
+    hardwareUSART->US_THR = c;
+    stats.bytesSent++;
+
+    return true;
+}
+
+void HardwareUARTBase::resumeSender() {
+    if (rxControl.resume(rxBuffer)) {
+        releaseSender();
+    }
+}
+
+void HardwareUARTBase::releaseSender() {
+    if (rtsLine.isAttached()) {
+        rtsLine.release();
+        rxControl.resumed();
+        return;
+    }
+
+    ///< The interrupt handler may write US_THR as well, keep it out until the sender has been released.
+    NVIC_DisableIRQ(interruptLine());
+    sendControl(XON);
+    rxControl.resumed();
+    NVIC_EnableIRQ(interruptLine());
+}
+
+void HardwareUARTBase::applyFlowControl() {
+    uint32_t rtsMask;
+    Pio *pio = setupHandshaking(hardwareUSART, controller, flowControl == FlowControl::RTS_CTS, rtsMask);
+
+    if (pio != nullptr && flowControl == FlowControl::RTS_CTS) {
+        rtsLine.attach(*pio, rtsMask);
+    } else {
+        rtsLine.detach();
+    }
+}
+
+size_t HardwareUARTBase::queueBytes(const uint8_t *data, size_t length) {
+    ///< The transmit buffer is a single producer, single consumer queue, safe to push while the interrupt handler pops.
+    size_t queued = 0;
+    while (queued < length && txBuffer.push(data[queued])) {
+        queued++;
+    }
+
+    stats.recordTxLevel(txBuffer.count());
+
+    ///< (Re)start the interrupt driven transmitter. It stops itself once the buffer is empty.
+    if (transmitMode == TransferMode::INTERRUPT) {
+        hardwareUSART->US_IER = US_IER_TXRDY;
+    }
+
+    return queued;
+}
+
+bool HardwareUARTBase::queueTransfer(const uint8_t *data, size_t length) {
+    if (!PdcChannel<Usart>::queueTransmit(*hardwareUSART, data, length)) {
+        return false;
+    }
+
+    ///< Report completion of the transfers through the TXBUFE interrupt, the bytes are counted as sent then.
+    __atomic_fetch_add(&dmaQueued, length, __ATOMIC_RELAXED);
+    hardwareUSART->US_IER = US_IER_TXBUFE;
+
+    return true;
+}
+
+void HardwareUARTBase::applyReceiveMode() {
+    if (receiveMode == TransferMode::INTERRUPT) {
+        hardwareUSART->US_IER = US_IER_RXRDY;
+    } else {
+        hardwareUSART->US_IDR = US_IDR_RXRDY;
+    }
+
+    ///< Without an interrupt handler receiving, errors are counted when polling.
+    if (receiveMode == TransferMode::POLLING || receiveMode == TransferMode::COOPERATIVE) {
+        hardwareUSART->US_IDR = US_IDR_OVRE | US_IDR_FRAME | US_IDR_PARE;
+    } else {
+        hardwareUSART->US_IER = US_IER_OVRE | US_IER_FRAME | US_IER_PARE;
+    }
+
+    if (receiveMode == TransferMode::DMA && frameReceiver.hasBuffers()) {
+        frameReceiver.start(*hardwareUSART, frameIdleBitPeriods);
+        return;
+    }
+
+    frameReceiver.stop(*hardwareUSART);
+
+    ///< Outside DMA mode, the receiver timeout ends the frames in the receive buffer.
+    if (frames.getBoundary() == FrameBoundary::IDLE) {
+        hardwareUSART->US_RTOR = frames.getParameter();
+        hardwareUSART->US_CR = US_CR_STTTO;
+
+        if (receiveMode == TransferMode::INTERRUPT) {
+            hardwareUSART->US_IER = US_IER_TIMEOUT;
+        }
+    } else {
+        hardwareUSART->US_RTOR = 0;
+    }
+}
+
+IRQn_Type HardwareUARTBase::interruptLine() const {
+    if (controller == UARTController::ONE) {
+        return USART0_IRQn;
+    } else if (controller == UARTController::TWO) {
+        return USART1_IRQn;
+    }
+
+    return USART3_IRQn;
+}
+
+void HardwareUARTBase::enable() {
     ///< Enable the transmitter and receiver
     hardwareUSART->US_CR = UART_CR_RXEN | UART_CR_TXEN;
 }
 
-inline void HardwareUART::disable() {
+void HardwareUARTBase::disable() {
     ///< Set the control register to reset and disable the receiver and transmitter.
     hardwareUSART->US_CR = UART_CR_RSTRX | UART_CR_RSTTX | UART_CR_RXDIS | UART_CR_TXDIS;
 }
 
-} // namespace UARTLib
\ No newline at end of file
+} // namespace UARTLib
+
+///< Interrupt vectors of the three USART controllers, routed to the connection attached to each controller.
+extern "C" void USART0_Handler() {
+    UARTLib::InterruptRouter::dispatch(UARTLib::UARTController::ONE);
+}
+
+extern "C" void USART1_Handler() {
+    UARTLib::InterruptRouter::dispatch(UARTLib::UARTController::TWO);
+}
+
+extern "C" void USART3_Handler() {
+    UARTLib::InterruptRouter::dispatch(UARTLib::UARTController::THREE);
+}
\ No newline at end of file
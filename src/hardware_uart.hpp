@@ -8,21 +8,40 @@
 #ifndef HARDWARE_UART_HPP
 #define HARDWARE_UART_HPP
 
+#include "byte_buffer.hpp"
+#include "dma_frame_receiver.hpp"
+#include "pdc_channel.hpp"
+#include "overflow_policy.hpp"
 #include "queue.hpp"
+#include "rts_line.hpp"
 #include "uart_connection.hpp"
+#include "uart_interrupt.hpp"
+#include "usart_setup.hpp"
 #include "wrap-hwlib.hpp"
 
 namespace UARTLib {
 
+/**
+ * @brief Used to select how the sender on the other end is held off, when using the backpressure overflow policy.
+ *
+ * None     - Software flow control, using XON and XOFF.
+ * RTS/CTS  - Hardware flow control. RTS is driven from the receive buffer level, the transmitter waits while CTS is high.
+ */
+enum class FlowControl { NONE, RTS_CTS };
+
 /**
  * @brief Establishes an serial/UART connection using on of the three dedicated serial controllers located on the Arduino Due.
  *
+ * The receive and transmit buffers use storage provided by the owner, so their capacity can be chosen per connection.
+ * HardwareUART provides 256 byte buffers, BufferedHardwareUART any other power of two.
  */
-class HardwareUART : public UARTConnection {
+class HardwareUARTBase : public UARTConnection {
   public:
     /**
-     * @brief Construct a new HardwareUART object.
+     * @brief Construct a new HardwareUARTBase object.
      *
+     * @param rxBuffer Receive buffer.
+     * @param txBuffer Transmit buffer, used in interrupt transmit mode.
      * @param baudrate Transmit and receive baudrate.
      * @param controller Controller used to transmit and receive.
      *
@@ -30,7 +49,25 @@ class HardwareUART : public UARTConnection {
      *
      * @param initializeController Initialize the USART controller directly within the object constructor.
      */
-    HardwareUART(unsigned int baudrate, UARTController controller = UARTController::ONE, bool initializeController = true);
+    HardwareUARTBase(ByteBuffer rxBuffer, ByteBuffer txBuffer, unsigned int baudrate,
+                     UARTController controller = UARTController::ONE, bool initializeController = true);
+
+    /**
+     * @brief Construct a new HardwareUARTBase object, using baudrate generator settings calculated at compile time.
+     *
+     * For example: HardwareUART uart(BaudRate<921600>::config). Fails to compile when the baudrate cannot be reached accurately.
+     *
+     * @param rxBuffer Receive buffer.
+     * @param txBuffer Transmit buffer, used in interrupt transmit mode.
+     * @param baudRate Baudrate generator settings.
+     * @param controller Controller used to transmit and receive.
+     * @param initializeController Initialize the USART controller directly within the object constructor.
+     */
+    HardwareUARTBase(ByteBuffer rxBuffer, ByteBuffer txBuffer, const BaudRateConfig &baudRate,
+                     UARTController controller = UARTController::ONE, bool initializeController = true);
+
+    HardwareUARTBase(const HardwareUARTBase &) = delete;
+    HardwareUARTBase &operator=(const HardwareUARTBase &) = delete;
 
     /**
      * @brief Begin a UART connection.
@@ -54,13 +91,13 @@ class HardwareUART : public UARTConnection {
      * @brief Enables the internal USART controller.
      *
      */
-    inline void enable() override;
+    void enable() override;
 
     /**
      * @brief Disables the internal USART controller.
      *
      */
-    inline void disable() override;
+    void disable() override;
 
     /**
      * @brief Send a single byte.
@@ -95,13 +132,54 @@ class HardwareUART : public UARTConnection {
     /**
      * @brief Send a array of bytes with a specified length.
      *
+     * In DMA transmit mode, the transfer is started and the method returns at once. The array must stay valid until the
+     * transfer has completed, see txPending(). Two transfers can be queued at a time, they are sent back to back, waiting for
+     * a free one when both are in use. In interrupt transmit mode, it waits while the transmit buffer is full. In cooperative
+     * transmit mode, it never waits, the array is only queued when it fits in the transmit buffer as a whole.
+     *
      * @param data Array of bytes.
      * @param length Length of array.
-     * @return true Array of bytes send.
-     * @return false Array of bytes has not been send, USART controller not initialized.
+     * @return true Every byte has been queued or sent.
+     * @return false Not a single byte has been queued, USART controller not initialized, the array does not fit in the
+     * transmit buffer in cooperative mode or is longer than PdcChannel::maxTransferLength in DMA mode.
      */
     bool send(const uint8_t *data, size_t length) override;
 
+    /**
+     * @brief Send as much of an array of bytes as possible without waiting.
+     *
+     * In interrupt transmit mode, bytes are queued in the transmit buffer until it is full. In DMA transmit mode, the whole
+     * array is handed to the DMA controller, or nothing when both descriptors are in use. In polling mode, every byte is sent.
+     *
+     * @param data Array of bytes.
+     * @param length Length of array.
+     * @return size_t Amount of bytes accepted, 0 if the USART controller is not initialized.
+     */
+    size_t trySend(const uint8_t *data, size_t length) override;
+
+    /**
+     * @brief Check how many bytes are waiting in the transmit buffer, or in DMA mode, in the DMA descriptors.
+     *
+     * @return size_t Amount of bytes not yet written to the US_THR register.
+     */
+    size_t txPending() override;
+
+    /**
+     * @brief Check how many bytes can be sent without waiting.
+     *
+     * In DMA transmit mode, a whole transfer fits while a descriptor is free.
+     *
+     * @return size_t Amount of bytes trySend() accepts right now, 0 when sending would wait.
+     */
+    size_t txFree() override;
+
+    /**
+     * @brief Wait until every queued byte has left the transmitter.
+     *
+     * Returns when the transmit buffer is empty and the USART controller reports TXEMPTY.
+     */
+    void flush() override;
+
     /**
      * @brief Receive a single byte.
      *
@@ -111,6 +189,49 @@ class HardwareUART : public UARTConnection {
      */
     uint8_t receive() override;
 
+    /**
+     * @brief Receive up to n bytes at once.
+     *
+     * Pops as many bytes from the receive buffer as are available, at most n, in a FIFO manner.
+     *
+     * @param buf Array to receive into.
+     * @param n Size of the array.
+     * @return size_t Amount of bytes received.
+     */
+    size_t receive(uint8_t *buf, size_t n) override;
+
+    /**
+     * @brief Get the readable part of the receive buffer, without copying it.
+     *
+     * As the receive buffer is a ring, the received bytes are split in at most two contiguous spans. The second span is empty
+     * unless the received bytes wrap around the end of the buffer. The spans stay valid until consume() is called.
+     *
+     * @param first Set to the oldest received bytes.
+     * @param second Set to the received bytes following the first span.
+     * @return size_t Amount of bytes in both spans.
+     */
+    size_t readableSpans(ByteSpan &first, ByteSpan &second) override;
+
+    /**
+     * @brief Remove bytes from the front of the receive buffer, after reading them using readableSpans().
+     *
+     * @param n Amount of bytes to remove, limited to the amount of bytes available.
+     */
+    void consume(size_t n) override;
+
+    /**
+     * @brief Find a byte in the receive buffer, e.g. the delimiter ending a line, without removing anything.
+     *
+     * Remembers how far the receive buffer has been searched, so each received byte is only inspected once, also when called
+     * again after more bytes arrived. Bytes are compared a word at a time.
+     *
+     * @param delimiter Byte to find.
+     * @param position Set to the position of the oldest occurrence, counted from the oldest received byte.
+     * @return true Found.
+     * @return false Not received yet.
+     */
+    bool findInBuffer(uint8_t delimiter, size_t &position) override;
+
     /**
      * @brief Checks if the internal USART controller has been initialized.
      *
@@ -119,6 +240,153 @@ class HardwareUART : public UARTConnection {
      */
     bool isInitialized() override;
 
+    /**
+     * @brief Get the baudrate achieved by the baudrate generator.
+     *
+     * As the baudrate is derived from the master clock using a divider, it may differ slightly from the requested baudrate.
+     *
+     * @return unsigned int Achieved baudrate.
+     */
+    unsigned int actualBaudrate() const;
+
+    /**
+     * @brief Get the baudrate generator settings.
+     *
+     * @return const BaudRateConfig& Settings, including the error relative to the requested baudrate.
+     */
+    const BaudRateConfig &baudRateConfig() const;
+
+    /**
+     * @brief Select how received bytes are moved into the receive buffer.
+     *
+     * In interrupt mode the RXRDY interrupt of the USART controller is enabled. The interrupt handler drains the US_RHR register
+     * into the receive buffer, so no bytes are overrun while the application is busy.
+     *
+     * In DMA mode the PDC receive channel fills the buffers given to setFrameBuffers(). Received data is read per frame, using
+     * receiveFrame() and releaseFrame(), the receive buffer and receive() are not used.
+     *
+     * @param mode Receive transfer mode, polling by default.
+     */
+    void setReceiveMode(TransferMode mode) override;
+
+    /**
+     * @brief Select how bytes are moved from the transmit buffer into the USART controller.
+     *
+     * In interrupt mode the TXRDY interrupt of the USART controller feeds the US_THR register from the transmit buffer.
+     * In DMA mode, the PDC transmit channel is enabled and the TXBUFE interrupt reports completion.
+     *
+     * @param mode Transmit transfer mode, polling by default.
+     */
+    void setTransmitMode(TransferMode mode) override;
+
+    /**
+     * @brief Get the selected transmit transfer mode.
+     *
+     * @return TransferMode Transmit transfer mode.
+     */
+    TransferMode getTransmitMode() const override;
+
+    /**
+     * @brief Select what happens to received bytes when the receive buffer is full.
+     *
+     * Without hardware flow control, the backpressure policy sends XON and XOFF straight to the US_THR register, ahead of
+     * queued data. That cannot be combined with DMA transmit mode.
+     *
+     * @param policy Overflow policy, dropping new bytes by default.
+     */
+    void setOverflowPolicy(OverflowPolicy policy) override;
+
+    /**
+     * @brief Set the receive buffer levels used by the backpressure policy.
+     *
+     * @param high Amount of buffered bytes at which the sender is held off.
+     * @param low Amount of buffered bytes at which the sender is released again, below high.
+     */
+    void setWatermarks(size_t high, size_t low) override;
+
+    /**
+     * @brief Select hardware or software flow control.
+     *
+     * RTS/CTS flow control switches the controller to hardware handshaking mode, so the transmitter waits while CTS is high,
+     * and selects the backpressure overflow policy, so RTS goes high at the high watermark of the receive buffer. Only
+     * controllers one and two have RTS and CTS pins, see setupHandshaking(). Preferably called before begin(), as the receiver
+     * and transmitter are reset to change modes.
+     *
+     * @param mode Flow control, none by default.
+     * @return true Flow control selected.
+     * @return false The controller has no RTS and CTS pins.
+     */
+    bool setFlowControl(FlowControl mode);
+
+    /**
+     * @brief Set the buffers used in DMA receive mode.
+     *
+     * The two buffers are filled by the DMA controller in turns. A frame ends when the line has been idle for the given amount
+     * of bit periods, or at the end of a buffer. Call this before selecting DMA receive mode.
+     *
+     * @param first First receive buffer.
+     * @param second Second receive buffer.
+     * @param size Size of each buffer, at most 65535 bytes.
+     * @param idleBitPeriods Amount of idle bit periods that end a frame.
+     */
+    void setFrameBuffers(uint8_t *first, uint8_t *second, size_t size, uint16_t idleBitPeriods = 20);
+
+    /**
+     * @brief Select what ends a frame in the receive buffer.
+     *
+     * Idle frame boundaries use the receiver timeout of the USART controller, in polling, cooperative and interrupt receive
+     * mode. DMA receive mode ends frames by itself, see setFrameBuffers().
+     *
+     * @param boundary What ends a frame, none by default.
+     * @param parameter Delimiter byte, amount of length header bytes (1 or 2) or amount of idle bit periods.
+     */
+    void setFrameBoundary(FrameBoundary boundary, uint16_t parameter = 0) override;
+
+    /**
+     * @brief Check how many frames have been received in DMA receive mode.
+     *
+     * These are the frames in the frame buffers, read using receiveFrame(). The frames in the receive buffer, used in the other
+     * receive modes, are counted by framesAvailable() and read using nextFrame().
+     *
+     * @return unsigned int Amount of frames waiting to be read.
+     */
+    unsigned int dmaFramesAvailable();
+
+    /**
+     * @brief Get the oldest received frame in DMA receive mode.
+     *
+     * The frame points into one of the frame buffers, and stays valid until it is released.
+     *
+     * @param frame Set to the oldest frame.
+     * @return true A frame was available.
+     * @return false No frames.
+     */
+    bool receiveFrame(DmaFrame &frame);
+
+    /**
+     * @brief Release the oldest received frame, so its memory can be reused by the DMA controller.
+     *
+     */
+    void releaseFrame();
+
+    /**
+     * @brief Service a USART interrupt.
+     *
+     * Moves every received byte from the US_RHR register into the receive buffer, and the next queued byte into US_THR.
+     */
+    void handleInterrupt() override;
+
+    /**
+     * @brief Move a bounded amount of data between the USART controller and the buffers, without waiting.
+     *
+     * In polling and cooperative receive mode, received bytes are moved from US_RHR into the receive buffer. In cooperative
+     * transmit mode, queued bytes are written to US_THR while the transmitter is ready.
+     *
+     * @param budget Most bytes moved in each direction.
+     * @return size_t Amount of bytes moved.
+     */
+    size_t service(size_t budget) override;
+
     /**
      * @brief Write a character using UART.
      *
@@ -148,12 +416,12 @@ class HardwareUART : public UARTConnection {
     char getc() override;
 
     /**
-     * @brief Destroy the HardwareUART object.
+     * @brief Destroy the HardwareUARTBase object.
      *
      * Disables the UART controller to save resources.
      *
      */
-    ~HardwareUART();
+    ~HardwareUARTBase();
 
   private:
     /**
@@ -163,10 +431,10 @@ class HardwareUART : public UARTConnection {
     Usart *hardwareUSART = nullptr;
 
     /**
-     * @brief Data baudrate used for sending and receiving.
+     * @brief Baudrate generator settings for the baudrate used for sending and receiving.
      *
      */
-    unsigned int baudrate;
+    BaudRateConfig baudRate;
 
     /**
      * @brief Enumerable type used to select on of the three USART controllers located on the Arduino Due.
@@ -180,11 +448,71 @@ class HardwareUART : public UARTConnection {
      */
     bool USARTControllerInitialized;
 
+    /**
+     * @brief Selected receive transfer mode.
+     *
+     */
+    TransferMode receiveMode;
+
+    /**
+     * @brief Selected transmit transfer mode.
+     *
+     */
+    TransferMode transmitMode;
+
     /**
      * @brief UART receive buffer.
      *
      */
-    Queue<uint8_t, 250> rxBuffer;
+    ByteBuffer rxBuffer;
+
+    /**
+     * @brief UART transmit buffer, drained by the interrupt handler in interrupt transmit mode.
+     *
+     */
+    ByteBuffer txBuffer;
+
+    /**
+     * @brief Applies the overflow policy to the receive buffer.
+     *
+     */
+    OverflowControl rxControl;
+
+    /**
+     * @brief Selected flow control.
+     *
+     */
+    FlowControl flowControl;
+
+    /**
+     * @brief RTS pin, attached when using RTS/CTS flow control.
+     *
+     */
+    RtsLine<Pio> rtsLine;
+
+    /**
+     * @brief Frame receiver used in DMA receive mode.
+     *
+     */
+    DmaFrameReceiver<Usart> frameReceiver;
+
+    /**
+     * @brief Amount of idle bit periods that end a frame in DMA receive mode.
+     *
+     */
+    uint16_t frameIdleBitPeriods;
+
+    /**
+     * @brief Flow control character waiting for the transmitter, 0 when none.
+     *
+     */
+    volatile uint8_t pendingControl;
+
+    /**
+     * @brief Bytes of the DMA transfers queued since the transmit channel was last idle, counted as sent once it is.
+     *
+     */
+    volatile uint32_t dmaQueued;
 
     /**
      * @brief Checks if the USART controller reports that the transmitter is ready to send.
@@ -192,7 +520,7 @@ class HardwareUART : public UARTConnection {
      * @return true Ready to send.
      * @return false Not ready to send.
      */
-    inline bool txReady() override;
+    bool txReady() override;
 
     /**
      * @brief Send a byte of the serial connection.
@@ -206,9 +534,185 @@ class HardwareUART : public UARTConnection {
      *
      * @return char
      */
-    inline uint8_t receiveByte() override;
+    uint8_t receiveByte() override;
+
+    /**
+     * @brief Enable or disable the receive interrupt and DMA channel, depending on the selected receive mode.
+     *
+     */
+    void applyReceiveMode();
+
+    /**
+     * @brief Queue bytes in the transmit buffer and start the interrupt driven transmitter, in interrupt transmit mode.
+     *
+     * @param data Array of bytes.
+     * @param length Length of array.
+     * @return size_t Amount of bytes queued.
+     */
+    size_t queueBytes(const uint8_t *data, size_t length);
+
+    /**
+     * @brief Hand an array of bytes to the PDC transmit channel.
+     *
+     * @param data Array of bytes.
+     * @param length Length of array.
+     * @return true Transfer queued.
+     * @return false Both DMA descriptors are in use.
+     */
+    bool queueTransfer(const uint8_t *data, size_t length);
+
+    /**
+     * @brief Move received bytes into the receive buffer, called from the interrupt handler.
+     *
+     */
+    inline void serviceReceive();
+
+    /**
+     * @brief Handle the end of a frame buffer or an idle line, called from the interrupt handler.
+     *
+     */
+    inline void serviceReceiveDma();
+
+    /**
+     * @brief Move the next queued byte into the transmitter, called from the interrupt handler.
+     *
+     */
+    inline void serviceTransmit();
+
+    /**
+     * @brief Acknowledge the completion of all DMA transfers, called from the interrupt handler.
+     *
+     */
+    inline void serviceTransmitDma();
+
+    /**
+     * @brief Move a bounded amount of received bytes from US_RHR into the receive buffer, without waiting.
+     *
+     * @param budget Most bytes moved.
+     * @return size_t Amount of bytes moved.
+     */
+    size_t pollReceive(size_t budget);
+
+    /**
+     * @brief Write a bounded amount of queued bytes to US_THR while the transmitter is ready, without waiting.
+     *
+     * @param budget Most bytes moved.
+     * @return size_t Amount of bytes moved.
+     */
+    size_t pollTransmit(size_t budget);
+
+    /**
+     * @brief Store a received byte in the receive buffer according to the overflow policy, counting it in the link statistics.
+     *
+     * @param b Received byte.
+     */
+    inline void storeReceived(uint8_t b);
+
+    /**
+     * @brief End the frame being received once the receiver timeout reports an idle line, and wait for the next character.
+     *
+     * @param status Value of the US_CSR register.
+     */
+    inline void endIdleFrame(uint32_t status);
+
+    /**
+     * @brief Count the overrun, framing and parity errors flagged in a channel status, and acknowledge them.
+     *
+     * The flags stay set until acknowledged, so multiple errors between two checks are counted once.
+     *
+     * @param status Value of the US_CSR register.
+     */
+    inline void recordLineErrors(uint32_t status);
+
+    /**
+     * @brief Send a flow control character ahead of any queued data, without waiting.
+     *
+     * When the transmitter is busy, the character is left pending, for the interrupt handler, service(), the next byte sent or
+     * flush().
+     *
+     * @param c Flow control character.
+     */
+    void sendControl(uint8_t c);
+
+    /**
+     * @brief Write the pending flow control character to US_THR, if any and the transmitter is ready.
+     *
+     * @return true Written.
+     * @return false Nothing pending, or the transmitter is busy.
+     */
+    inline bool emitControl();
+
+    /**
+     * @brief Release the sender, when held off and the receive buffer has been read down to the low watermark.
+     *
+     */
+    void resumeSender();
+
+    /**
+     * @brief Release the sender using RTS or XON.
+     *
+     */
+    void releaseSender();
+
+    /**
+     * @brief Apply the selected flow control to the USART controller.
+     *
+     */
+    void applyFlowControl();
+
+    /**
+     * @brief Get the interrupt line of the selected USART controller.
+     *
+     * @return IRQn_Type Interrupt line.
+     */
+    IRQn_Type interruptLine() const;
 };
 
+/**
+ * @brief HardwareUART with receive and transmit buffers of a chosen capacity.
+ *
+ * For example: BufferedHardwareUART<1024, 64> uart(115200) buffers up to 1023 received bytes.
+ *
+ * @tparam RX_BUFFER_SIZE Size of the receive buffer, a power of two. Holds one byte less.
+ * @tparam TX_BUFFER_SIZE Size of the transmit buffer, a power of two. Holds one byte less.
+ */
+template <size_t RX_BUFFER_SIZE, size_t TX_BUFFER_SIZE>
+class BufferedHardwareUART : private BufferStorage<RX_BUFFER_SIZE, TX_BUFFER_SIZE>, public HardwareUARTBase {
+    typedef BufferStorage<RX_BUFFER_SIZE, TX_BUFFER_SIZE> Storage;
+
+  public:
+    /**
+     * @brief Construct a new BufferedHardwareUART object.
+     *
+     * @param baudrate Transmit and receive baudrate.
+     * @param controller Controller used to transmit and receive.
+     * @param initializeController Initialize the USART controller directly within the object constructor.
+     */
+    BufferedHardwareUART(unsigned int baudrate, UARTController controller = UARTController::ONE, bool initializeController = true)
+        : HardwareUARTBase(ByteBuffer(Storage::rxStorage), ByteBuffer(Storage::txStorage), baudrate, controller,
+                           initializeController) {
+    }
+
+    /**
+     * @brief Construct a new BufferedHardwareUART object, using baudrate generator settings calculated at compile time.
+     *
+     * @param baudRate Baudrate generator settings.
+     * @param controller Controller used to transmit and receive.
+     * @param initializeController Initialize the USART controller directly within the object constructor.
+     */
+    BufferedHardwareUART(const BaudRateConfig &baudRate, UARTController controller = UARTController::ONE,
+                         bool initializeController = true)
+        : HardwareUARTBase(ByteBuffer(Storage::rxStorage), ByteBuffer(Storage::txStorage), baudRate, controller,
+                           initializeController) {
+    }
+};
+
+/**
+ * @brief HardwareUART with 256 byte receive and transmit buffers.
+ *
+ */
+typedef BufferedHardwareUART<256, 256> HardwareUART;
+
 } // namespace UARTLib
 
 #endif
\ No newline at end of file
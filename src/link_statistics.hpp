@@ -0,0 +1,131 @@
+/**
+ * @file
+ * @brief     Link health counters of a UART connection.
+ * @author    Wiebe van Breukelen
+ * @license   See LICENSE
+ */
+
+#ifndef LINK_STATISTICS_HPP
+#define LINK_STATISTICS_HPP
+
+#include "wrap-hwlib.hpp"
+
+namespace UARTLib {
+
+/**
+ * @brief Errors the USART controller reports about received data.
+ *
+ * Overrun  - A byte was received before the previous one was read, the previous byte is lost (US_CSR OVRE).
+ * Framing  - No valid stop bit was received, the line or baudrate is wrong (US_CSR FRAME).
+ * Parity   - The parity bit did not match the received byte (US_CSR PARE).
+ */
+enum class LineError { OVERRUN, FRAMING, PARITY };
+
+/**
+ * @brief Link health counters of a UART connection.
+ *
+ * Tells apart data lost on the line (framing and parity errors), in the USART controller (overruns) and in the buffers of the
+ * connection (drops). Every counter is a single word, updated by either the interrupt handler or the application, so reading
+ * one is always consistent. Counters wrap around on overflow.
+ */
+struct LinkStatistics {
+    /**
+     * @brief Bytes handed to the transmitter. Bytes sent using DMA are counted once their transfer has completed.
+     *
+     */
+    uint32_t bytesSent;
+
+    /**
+     * @brief Bytes read from the receiver, including the ones dropped afterwards.
+     *
+     */
+    uint32_t bytesReceived;
+
+    /**
+     * @brief Bytes lost in the USART controller as they were not read in time.
+     *
+     */
+    uint32_t overrunErrors;
+
+    /**
+     * @brief Bytes received without a valid stop bit.
+     *
+     */
+    uint32_t framingErrors;
+
+    /**
+     * @brief Bytes received with a wrong parity bit.
+     *
+     */
+    uint32_t parityErrors;
+
+    /**
+     * @brief Received bytes dropped as the receive buffer was full.
+     *
+     */
+    uint32_t rxDropped;
+
+    /**
+     * @brief Highest amount of bytes held by the receive buffer.
+     *
+     */
+    uint32_t rxHighWater;
+
+    /**
+     * @brief Highest amount of bytes held by the transmit buffer.
+     *
+     */
+    uint32_t txHighWater;
+
+    /**
+     * @brief Bytes dropped as the transmit buffer was full, in cooperative transmit mode.
+     *
+     */
+    uint32_t txDropped;
+
+    /**
+     * @brief Count a byte read from the receiver.
+     *
+     * @param stored The byte has been stored in the receive buffer, false when dropped.
+     * @param level Amount of bytes in the receive buffer afterwards.
+     */
+    void recordReceived(bool stored, size_t level) {
+        bytesReceived++;
+
+        if (!stored) {
+            rxDropped++;
+        } else if (level > rxHighWater) {
+            rxHighWater = level;
+        }
+    }
+
+    /**
+     * @brief Track the amount of bytes held by the transmit buffer.
+     *
+     * @param level Amount of bytes in the transmit buffer.
+     */
+    void recordTxLevel(size_t level) {
+        if (level > txHighWater) {
+            txHighWater = level;
+        }
+    }
+
+    /**
+     * @brief Count an error reported by the USART controller.
+     *
+     * @param error Error.
+     */
+    void recordLineError(LineError error) {
+        if (error == LineError::OVERRUN) {
+            overrunErrors++;
+        } else if (error == LineError::FRAMING) {
+            framingErrors++;
+        } else {
+            parityErrors++;
+        }
+    }
+};
+
+} // namespace UARTLib
+
+#endif
@@ -35,8 +35,15 @@ int main() {
 
     ///< Initialize a hardware UART connection, with a baudrate of 115200 and using RX1 and TX1 on the Arduino Due.
     UARTLib::HardwareUART connHw(115200, UARTLib::UARTController::ONE);
-    ///< Initiailze a mock/fake UART connection. Use this one in your tests.
-    UARTLib::MockUART connMock(115200, UARTLib::UARTController::ONE);
+    ///< Let the USART interrupt fill the receive buffer, so nothing is lost while we are printing to hwlib::cout.
+    connHw.setReceiveMode(UARTLib::TransferMode::INTERRUPT);
+    ///< Queue what we send, the loop below moves it into the transmitter in bounded steps. Sending never waits this way.
+    connHw.setTransmitMode(UARTLib::TransferMode::COOPERATIVE);
+    ///< Initiailze a mock/fake UART connection. Use this one in your tests. It polls, so it never takes over the interrupt of
+    ///< a controller, and uses another controller than connHw anyway.
+    UARTLib::MockUART connMock(115200, UARTLib::UARTController::THREE);
+    ///< Loop whatever the mock sends back into its own receiver.
+    connMock.setLoopback(true);
 
     ///< Create two dummy objects.
     ExampleUARTUser uartHwUser(connHw);
@@ -45,7 +52,13 @@ int main() {
     char availableRealUART = 0, availableFakeUART = 0;
 
     while (true) {
-        uartHwUser.sendSomething();
+        ///< Move at most 16 bytes into the transmitter, without waiting for it.
+        connHw.service(16);
+
+        ///< Only send when the whole message fits, instead of dropping part of it.
+        if (connHw.txFree() >= 14) {
+            uartHwUser.sendSomething();
+        }
         uartMockUser.sendSomething();
 
         ///< Send something using the real UART hardware.
@@ -53,7 +66,7 @@ int main() {
 
         ///< Send something using the fake implementation you want to use for unit tests.
         ///< The number of bytes available will quickly end up at the fixed size of the receive buffer, 255.
-        ///< As calling the MockUART::available() method will increase the number of received bytes one by one.
+        ///< As the mock is in loopback mode, every "Hello World!" sent is received again.
         availableFakeUART = uartMockUser.bytesAvailable();
 
         ///< Receive something using the real UART hardware. You better use a buffer it you expect loads of data (the cout delays
@@ -65,7 +78,7 @@ int main() {
         ///< Receive something using the fake/test UART hardware.
         if (availableFakeUART > 9) {
             ///< If you like, you can comment out the following code statement. This will demonstrate that the receive buffer of the
-            ///< fake UART is filled constantly with the value of 0xAA hwlib::cout << "Received from fake/testing UART: " <<
+            ///< fake UART is filled constantly with the looped back message hwlib::cout << "Received from fake/testing UART: " <<
             ///< uartMockUser.receiveSomething() << hwlib::endl;
         }
     }
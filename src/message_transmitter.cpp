@@ -0,0 +1,83 @@
+#include "message_transmitter.hpp"
+
+namespace UARTLib {
+
+MessageTransmitter::MessageTransmitter(UARTConnection &connection)
+    : connection(connection), messages{}, head(0), next(0), tail(0), offset(0), outstanding(0), listening(false) {
+    ///< Only connections raising interrupts notify us. Otherwise, or when another listener took them, poll() drives us.
+    listening = InterruptRouter::listen(&connection, this);
+}
+
+MessageTransmitter::~MessageTransmitter() {
+    InterruptRouter::unlisten(this);
+}
+
+bool MessageTransmitter::send(const uint8_t *block, size_t length, BlockPoolBase &pool) {
+    uint32_t end = tail;
+    if (end - __atomic_load_n(&head, __ATOMIC_ACQUIRE) == maxMessages) {
+        return false;
+    }
+
+    messages[end & mask] = {block, length, &pool};
+    __atomic_store_n(&tail, end + 1, __ATOMIC_RELEASE);
+
+    poll();
+
+    return true;
+}
+
+size_t MessageTransmitter::pending() const {
+    return tail - head;
+}
+
+bool MessageTransmitter::isListening() const {
+    return listening;
+}
+
+void MessageTransmitter::poll() {
+    if (!guard.enter()) {
+        return;
+    }
+
+    ///< Interrupts may arrive while we are busy, they are picked up by another round.
+    do {
+        advance();
+    } while (guard.leave());
+}
+
+void MessageTransmitter::interruptServiced() {
+    poll();
+}
+
+void MessageTransmitter::advance() {
+    uint32_t end = __atomic_load_n(&tail, __ATOMIC_ACQUIRE);
+
+    while (next != end) {
+        const Message &message = messages[next & mask];
+        size_t sent = connection.trySend(message.data + offset, message.length - offset);
+        offset += sent;
+        outstanding += sent;
+
+        if (offset < message.length) {
+            break;
+        }
+
+        next++;
+        offset = 0;
+    }
+
+    ///< Bytes are transmitted in order, so a message is done once the connection holds no more than the bytes following it.
+    uint32_t released = head;
+    size_t held = released != next ? connection.txPending() : 0;
+
+    while (released != next && held <= outstanding - messages[released & mask].length) {
+        const Message &message = messages[released & mask];
+        outstanding -= message.length;
+        message.pool->release(message.data);
+        released++;
+    }
+
+    __atomic_store_n(&head, released, __ATOMIC_RELEASE);
+}
+
+} // namespace UARTLib
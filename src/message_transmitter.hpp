@@ -0,0 +1,134 @@
+/**
+ * @file
+ * @brief     Transmit queue of whole messages held in pool blocks, returning each block to its pool once sent.
+ * @author    Wiebe van Breukelen
+ * @license   See LICENSE
+ */
+
+#ifndef MESSAGE_TRANSMITTER_HPP
+#define MESSAGE_TRANSMITTER_HPP
+
+#include "block_pool.hpp"
+#include "uart_connection.hpp"
+#include "uart_interrupt.hpp"
+#include "wrap-hwlib.hpp"
+
+namespace UARTLib {
+
+/**
+ * @brief Queues messages by reference, taking ownership of the pool blocks holding them until they have been transmitted.
+ *
+ * The application fills a block taken from a BlockPool and hands it over using send(). The messages are passed to the
+ * connection in order, using trySend(). A block is returned to its pool once the connection no longer holds any of its bytes,
+ * as reported by txPending(). In DMA transmit mode, the DMA controller reads straight from the block, so a message is never
+ * copied. In the other transfer modes, the connection copies the bytes into its transmit buffer, and the block is held until
+ * they have been transmitted.
+ *
+ * Like AsyncUART, messages are advanced after every interrupt of the connection, or by calling poll() from the main loop for
+ * connections without interrupts. Only one of them listens to the interrupts of a connection, the other one has to be polled,
+ * see isListening(). Do not send on the connection from elsewhere while messages are queued, that holds on to blocks longer
+ * than needed.
+ */
+class MessageTransmitter : private InterruptListener {
+  public:
+    /**
+     * @brief Amount of messages that can be queued at once.
+     *
+     */
+    static constexpr uint32_t maxMessages = 16;
+
+    /**
+     * @brief Construct a new MessageTransmitter object, listening to the interrupt of the connection when it has one.
+     *
+     * @param connection Connection to transmit on, initialized before.
+     */
+    explicit MessageTransmitter(UARTConnection &connection);
+
+    MessageTransmitter(const MessageTransmitter &) = delete;
+    MessageTransmitter &operator=(const MessageTransmitter &) = delete;
+
+    /**
+     * @brief Destroy the MessageTransmitter object. Queued messages are abandoned, their blocks are not returned.
+     *
+     */
+    ~MessageTransmitter();
+
+    /**
+     * @brief Queue a message, taking ownership of the block holding it.
+     *
+     * @param block Block taken from the pool, not touched again by the caller once queued.
+     * @param length Length of the message, at most the block size.
+     * @param pool Pool the block is returned to once the message has been transmitted.
+     * @return true Queued, the block is owned by the transmitter.
+     * @return false The queue is full, the caller keeps the block.
+     */
+    bool send(const uint8_t *block, size_t length, BlockPoolBase &pool);
+
+    /**
+     * @brief Check how many messages hold on to their block.
+     *
+     * @return size_t Amount of messages queued or being transmitted.
+     */
+    size_t pending() const;
+
+    /**
+     * @brief Check if the messages are advanced after every interrupt of the connection.
+     *
+     * @return true Listening to the interrupts of the connection.
+     * @return false The connection is not attached to a controller, or another listener listens to it. Call poll() instead.
+     */
+    bool isListening() const;
+
+    /**
+     * @brief Pass queued messages to the connection, and return the blocks of transmitted messages to their pools.
+     *
+     * Called after every interrupt of the connection. Call it from the main loop for connections without interrupts, or when
+     * not listening to them.
+     */
+    void poll();
+
+  private:
+    /**
+     * @brief A queued message.
+     *
+     */
+    struct Message {
+        const uint8_t *data;
+        size_t length;
+        BlockPoolBase *pool;
+    };
+
+    static constexpr uint32_t mask = maxMessages - 1;
+    static_assert((maxMessages & mask) == 0, "The message ring wraps using a mask");
+
+    UARTConnection &connection;
+    Message messages[maxMessages];
+
+    ///< Free running counters: messages before head have been released, before next handed over, before tail queued.
+    volatile uint32_t head;
+    uint32_t next;
+    volatile uint32_t tail;
+
+    ///< Bytes of the message at next handed over so far.
+    size_t offset;
+
+    ///< Bytes handed over to the connection, of messages that have not been released.
+    size_t outstanding;
+
+    bool listening;
+
+    ///< Keeps the interrupt handler from advancing the messages while poll() runs in the main loop.
+    ReentryGuard guard;
+
+    void interruptServiced() override;
+
+    /**
+     * @brief Hand queued messages to the connection, and release the ones it no longer holds.
+     *
+     */
+    void advance();
+};
+
+} // namespace UARTLib
+
+#endif
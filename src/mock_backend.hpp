@@ -0,0 +1,91 @@
+/**
+ * @file
+ * @brief     Mock backend for BasicUART.
+ * @author    Wiebe van Breukelen
+ * @license   See LICENSE
+ */
+
+#ifndef MOCK_BACKEND_HPP
+#define MOCK_BACKEND_HPP
+
+#include "wrap-hwlib.hpp"
+
+namespace UARTLib {
+
+/**
+ * @brief Backend for BasicUART without hardware access, e.g. to measure the cost of BasicUART itself.
+ *
+ * The transmitter is always ready and only counts what is written. The receiver is always ready and always returns 0xAA.
+ * Unlike MockUART, nothing is captured and no bytes can be injected, use MockUART to script a conversation.
+ */
+class MockBackend {
+  public:
+    /**
+     * @brief Construct a new MockBackend object.
+     *
+     */
+    MockBackend() : bytesWritten(0), lastByte(0) {
+    }
+
+    /**
+     * @brief Normally, we would set up the USART controller right now. Since it's a mock implementation, we don't do that.
+     *
+     * @param baudrate Transmit and receive baudrate.
+     */
+    void begin(unsigned int baudrate) {
+        (void)baudrate;
+    }
+
+    /**
+     * @brief The mock transmitter is always ready.
+     *
+     * @return true Ready to send.
+     */
+    bool txReady() {
+        return true;
+    }
+
+    /**
+     * @brief Count the byte instead of sending it.
+     *
+     * @param b Byte to send.
+     */
+    void writeByte(uint8_t b) {
+        lastByte = b;
+        bytesWritten++;
+    }
+
+    /**
+     * @brief The mock receiver always has a byte available.
+     *
+     * @return true Byte received.
+     */
+    bool rxReady() {
+        return true;
+    }
+
+    /**
+     * @brief Receive a byte, always 0xAA.
+     *
+     * @return uint8_t Received byte, 0xAA.
+     */
+    uint8_t readByte() {
+        return 0xAA;
+    }
+
+    /**
+     * @brief Amount of bytes written so far.
+     *
+     */
+    size_t bytesWritten;
+
+    /**
+     * @brief Last byte written.
+     *
+     */
+    uint8_t lastByte;
+};
+
+} // namespace UARTLib
+
+#endif
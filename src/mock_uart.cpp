@@ -2,47 +2,56 @@
 
 namespace UARTLib {
 
-MockUART::MockUART(unsigned int baudrate, UARTController controller, bool initializeController)
-    : baudrate(baudrate), controller(controller), USARTControllerInitialized(false) {
+MockUARTBase::MockUARTBase(ByteBuffer rxBuffer, ByteBuffer txBuffer, unsigned int baudrate, UARTController controller,
+                           bool initializeController)
+    : baudrate(baudrate), controller(controller), USARTControllerInitialized(false), receiveMode(TransferMode::POLLING),
+      transmitMode(TransferMode::POLLING), rxBuffer(rxBuffer), txBuffer(txBuffer), rxControl(rxBuffer.capacity()),
+      loopback(false), peer(nullptr) {
     if (initializeController) {
         begin();
     }
 }
 
-MockUART::~MockUART() {
+MockUARTBase::~MockUARTBase() {
     ///< Disable the UART controller on destruction
     disable();
+
+    ///< Make sure simulated interrupts and the connected mock no longer refer to this object.
+    InterruptRouter::detach(controller, this);
+    disconnect();
 }
 
-void MockUART::begin() {
+void MockUARTBase::begin() {
     ///< Only initialize the UART controller if it hasn't been enabled.
     if (USARTControllerInitialized) {
         return;
     }
 
-    ///< Normally, we would setup the correct USART controller.
-    ///< In the mock implementation, we do nothing.
-
     ///< Enable the UART controller
     enable();
 
     ///< USART Controller initialized
     USARTControllerInitialized = true;
+
+    routeInterrupt();
 }
 
-unsigned int MockUART::available() {
+unsigned int MockUARTBase::available() {
     if (!USARTControllerInitialized) {
         return 0;
     }
 
     ///< In the hardware implementation we use the USART Channel status register to check if there is data available.
-    ///< In the mock implementation, we just put in that we received from receiveByte() (will is always 0x80).
-    rxBuffer.push(receiveByte());
+    ///< In the mock implementation, we move whatever has been injected on the (fake) line into the receive buffer.
+    ///< In interrupt mode, handleInterrupt() fills the receive buffer instead.
+    if (receiveMode == TransferMode::POLLING) {
+        receiveLine(rxLine.count());
+    }
 
     return rxBuffer.count();
 }
 
-bool MockUART::send(const uint8_t b) {
+bool MockUARTBase::send(const uint8_t b) {
     if (!USARTControllerInitialized) {
         return false;
     }
@@ -52,7 +61,7 @@ bool MockUART::send(const uint8_t b) {
     return true;
 }
 
-bool MockUART::send(const uint8_t *str) {
+bool MockUARTBase::send(const uint8_t *str) {
     if (!USARTControllerInitialized) {
         return false;
     }
@@ -64,7 +73,7 @@ bool MockUART::send(const uint8_t *str) {
     return true;
 }
 
-bool MockUART::send(const char *str) {
+bool MockUARTBase::send(const char *str) {
     if (!USARTControllerInitialized) {
         return false;
     }
@@ -76,11 +85,16 @@ bool MockUART::send(const char *str) {
     return true;
 }
 
-bool MockUART::send(const uint8_t *data, size_t length) {
+bool MockUARTBase::send(const uint8_t *data, size_t length) {
     if (!USARTControllerInitialized) {
         return false;
     }
 
+    ///< Like the hardware implementation, never wait in cooperative mode. All bytes are queued, or none.
+    if (transmitMode == TransferMode::COOPERATIVE) {
+        return txFree() >= length && trySend(data, length) == length;
+    }
+
     for (unsigned int i = 0; i < length; i++) {
         sendByte(data[i]);
     }
@@ -88,56 +102,331 @@ bool MockUART::send(const uint8_t *data, size_t length) {
     return true;
 }
 
-uint8_t MockUART::receive() {
+size_t MockUARTBase::trySend(const uint8_t *data, size_t length) {
+    if (!USARTControllerInitialized) {
+        return 0;
+    }
+
+    if (transmitMode == TransferMode::INTERRUPT || transmitMode == TransferMode::COOPERATIVE) {
+        size_t queued = 0;
+        while (queued < length && txBuffer.push(data[queued])) {
+            queued++;
+        }
+
+        stats.recordTxLevel(txBuffer.count());
+
+        return queued;
+    }
+
+    for (unsigned int i = 0; i < length; i++) {
+        sendByte(data[i]);
+    }
+
+    return length;
+}
+
+size_t MockUARTBase::txPending() {
+    return txBuffer.count();
+}
+
+size_t MockUARTBase::txFree() {
+    if (!USARTControllerInitialized) {
+        return 0;
+    }
+
+    if (transmitMode == TransferMode::INTERRUPT || transmitMode == TransferMode::COOPERATIVE) {
+        return txBuffer.capacity() - txBuffer.count();
+    }
+
+    return txReady() ? 1 : 0;
+}
+
+void MockUARTBase::flush() {
+    ///< Normally, we would wait for the interrupt handler to drain the transmit buffer. Here, we drain it ourselves.
+    while (txBuffer.count() > 0) {
+        transmitByte(txBuffer.pop());
+    }
+}
+
+uint8_t MockUARTBase::receive() {
     if (!USARTControllerInitialized || !rxBuffer.count()) {
         return 0;
     }
 
-    return rxBuffer.pop();
+    uint8_t b = rxBuffer.pop();
+    resumeSender();
+
+    return b;
+}
+
+size_t MockUARTBase::receive(uint8_t *buf, size_t n) {
+    if (!USARTControllerInitialized) {
+        return 0;
+    }
+
+    size_t received = rxBuffer.pop(buf, n);
+    resumeSender();
+
+    return received;
+}
+
+size_t MockUARTBase::readableSpans(ByteSpan &first, ByteSpan &second) {
+    if (!USARTControllerInitialized) {
+        first.length = second.length = 0;
+        return 0;
+    }
+
+    return rxBuffer.peekRegions(first.data, first.length, second.data, second.length);
+}
+
+void MockUARTBase::consume(size_t n) {
+    rxBuffer.drop(n);
+    resumeSender();
+}
+
+bool MockUARTBase::findInBuffer(uint8_t delimiter, size_t &position) {
+    return USARTControllerInitialized && rxBuffer.find(delimiter, position);
 }
 
-void MockUART::putc(char c) {
+void MockUARTBase::putc(char c) {
     sendByte(c);
 }
 
-char MockUART::getc() {
+char MockUARTBase::getc() {
     return receive();
 }
 
-bool MockUART::char_available() {
+bool MockUARTBase::char_available() {
     return (available() > 0);
 }
 
-bool MockUART::isInitialized() {
+bool MockUARTBase::isInitialized() {
     return USARTControllerInitialized;
 }
 
-void MockUART::sendByte(const uint8_t &b) {
+void MockUARTBase::setReceiveMode(TransferMode mode) {
+    receiveMode = mode;
+    routeInterrupt();
+}
+
+void MockUARTBase::setTransmitMode(TransferMode mode) {
+    flush();
+
+    transmitMode = mode;
+    routeInterrupt();
+}
+
+TransferMode MockUARTBase::getTransmitMode() const {
+    return transmitMode;
+}
+
+void MockUARTBase::setOverflowPolicy(OverflowPolicy policy) {
+    rxControl.setPolicy(policy, rxBuffer);
+
+    ///< Without backpressure, nothing releases a sender that is held off any more.
+    if (policy != OverflowPolicy::BACKPRESSURE && rxControl.isPaused()) {
+        transmitByte(XON);
+        rxControl.resumed();
+    }
+}
+
+void MockUARTBase::setWatermarks(size_t high, size_t low) {
+    rxControl.setWatermarks(high, low);
+}
+
+void MockUARTBase::handleInterrupt() {
+    ///< Like the RXRDY interrupt, drain everything that has arrived on the (fake) line.
+    if (receiveMode == TransferMode::INTERRUPT) {
+        receiveLine(rxLine.count());
+    }
+
+    ///< The TXRDY interrupt moves a single byte into the transmitter.
+    if (transmitMode == TransferMode::INTERRUPT && txBuffer.count() > 0) {
+        transmitByte(txBuffer.pop());
+    }
+}
+
+size_t MockUARTBase::service(size_t budget) {
+    if (!USARTControllerInitialized) {
+        return 0;
+    }
+
+    size_t moved = 0;
+
+    if (receiveMode == TransferMode::POLLING || receiveMode == TransferMode::COOPERATIVE) {
+        moved += receiveLine(budget);
+    }
+
+    if (transmitMode == TransferMode::COOPERATIVE) {
+        for (size_t sent = 0; sent < budget && txBuffer.count() > 0; sent++) {
+            transmitByte(txBuffer.pop());
+            moved++;
+        }
+    }
+
+    return moved;
+}
+
+size_t MockUARTBase::inject(const uint8_t *data, size_t length) {
+    size_t injected = 0;
+    while (injected < length && rxLine.push(data[injected])) {
+        injected++;
+    }
+
+    return injected;
+}
+
+size_t MockUARTBase::inject(const char *str) {
+    size_t injected = 0;
+    while (str[injected] != '\0' && rxLine.push(str[injected])) {
+        injected++;
+    }
+
+    return injected;
+}
+
+size_t MockUARTBase::rxLinePending() {
+    return rxLine.count();
+}
+
+size_t MockUARTBase::txCaptured() {
+    return txCapture.count();
+}
+
+size_t MockUARTBase::readTransmitted(uint8_t *buf, size_t n) {
+    return txCapture.pop(buf, n);
+}
+
+void MockUARTBase::setLoopback(bool enabled) {
+    loopback = enabled;
+}
+
+void MockUARTBase::connect(MockUARTBase &other) {
+    disconnect();
+    other.disconnect();
+
+    peer = &other;
+    other.peer = this;
+}
+
+void MockUARTBase::disconnect() {
+    if (peer != nullptr) {
+        peer->peer = nullptr;
+        peer = nullptr;
+    }
+}
+
+void MockUARTBase::injectError(LineError error) {
+    stats.recordLineError(error);
+}
+
+size_t MockUARTBase::receiveLine(size_t budget) {
+    size_t received = 0;
+
+    while (received < budget && rxLine.count() > 0) {
+        if (receiveMode != TransferMode::INTERRUPT && rxBuffer.count() >= static_cast<int>(rxBuffer.capacity())) {
+            break;
+        }
+
+        if (rxControl.store(rxBuffer, receiveByte(), stats, &frames)) {
+            transmitByte(XOFF);
+        }
+
+        received++;
+    }
+
+    ///< The line goes idle once everything injected so far has been received.
+    if (received > 0 && rxLine.count() == 0) {
+        frames.idle();
+    }
+
+    return received;
+}
+
+void MockUARTBase::routeInterrupt() {
+    if (!USARTControllerInitialized) {
+        return;
+    }
+
+    ///< Normally, we would setup the correct USART controller. In the mock implementation, we only route the (simulated)
+    ///< interrupt of the controller to us while it is needed, never taking it away from a hardware connection.
+    if (receiveMode == TransferMode::INTERRUPT || transmitMode == TransferMode::INTERRUPT) {
+        InterruptRouter::claim(controller, this);
+    } else {
+        InterruptRouter::detach(controller, this);
+    }
+}
+
+void MockUARTBase::transmitByte(uint8_t b) {
+    stats.bytesSent++;
+
+    ///< Put the byte on the (fake) line: our own receiver, the connected mock, or the capture buffer.
+    if (loopback) {
+        rxLine.push(b);
+    } else if (peer != nullptr) {
+        peer->rxLine.push(b);
+    } else {
+        txCapture.push(b);
+    }
+}
+
+void MockUARTBase::resumeSender() {
+    if (rxControl.resume(rxBuffer)) {
+        transmitByte(XON);
+        rxControl.resumed();
+    }
+}
+
+void MockUARTBase::sendByte(const uint8_t &b) {
+    ///< In interrupt transmit mode, the byte is queued. When the transmit buffer is full, we transmit the oldest byte to make
+    ///< room, as there is no interrupt handler that would do that for us.
+    if (transmitMode == TransferMode::INTERRUPT) {
+        while (!txBuffer.push(b)) {
+            transmitByte(txBuffer.pop());
+        }
+
+        stats.recordTxLevel(txBuffer.count());
+
+        return;
+    }
+
+    ///< Like the hardware implementation, never wait in cooperative mode, service() has to make room.
+    if (transmitMode == TransferMode::COOPERATIVE) {
+        if (txBuffer.push(b)) {
+            stats.recordTxLevel(txBuffer.count());
+        } else {
+            stats.txDropped++;
+        }
+
+        return;
+    }
+
     ///< Wait before we can send any more data
     while (!txReady()) {
     }
 
-    ///< Normally, we would send right now. Since it's a mock implementation, we don't do that.
+    ///< Normally, we would send right now. Since it's a mock implementation, we put it on the (fake) line instead.
+    transmitByte(b);
 }
 
-inline uint8_t MockUART::receiveByte() {
+uint8_t MockUARTBase::receiveByte() {
     ///< Normally, we would receive right now. Since it's a mock implementation, we don't do that.
-    ///< Instead, we always send a fixed byte.
+    ///< Instead, we take the next byte that has been injected on the (fake) line.
 
-    return 0xAA;
+    return rxLine.pop();
 }
 
-inline bool MockUART::txReady() {
+bool MockUARTBase::txReady() {
     ///< Normally, we would wait for the tx line to be ready. Since it's a mock implementation, we don't do that.
 
     return true;
 }
 
-inline void MockUART::enable() {
+void MockUARTBase::enable() {
     ///< Normally, we would enable the USART controller right now. Since it's a mock implementation, we don't do that.
 }
 
-inline void MockUART::disable() {
+void MockUARTBase::disable() {
     ///< Normally, we would disable the USART controller right now. Since it's a mock implementation, we don't do that.
 }
 
@@ -9,7 +9,9 @@
 #ifndef MOCK_UART_HPP
 #define MOCK_UART_HPP
 
+#include "byte_buffer.hpp"
 #include "uart_connection.hpp"
+#include "uart_interrupt.hpp"
 
 namespace UARTLib {
 
@@ -17,12 +19,20 @@ namespace UARTLib {
  * @brief In the mock implementation of UART communication, we only provide the user a testable interface,
  * as we don't have access to hardware registers.
  *
+ * Instead of a real line, the mock has a receive line that tests inject bytes into, and a capture buffer that collects what
+ * has been transmitted. Transmitted bytes can also be looped back into the receive line, or delivered to another connected
+ * MockUART, to test both ends of a protocol on the host.
+ *
+ * The receive and transmit buffers use storage provided by the owner. MockUART provides 256 byte buffers, BufferedMockUART
+ * any other power of two.
  */
-class MockUART : public UARTConnection {
+class MockUARTBase : public UARTConnection {
   public:
     /**
-     * @brief Construct a new MockUART object.
+     * @brief Construct a new MockUARTBase object.
      *
+     * @param rxBuffer Receive buffer.
+     * @param txBuffer Transmit buffer, used in interrupt transmit mode.
      * @param baudrate Transmit and receive baudrate.
      * @param controller Controller used to transmit and receive.
      *
@@ -30,7 +40,11 @@ class MockUART : public UARTConnection {
      *
      * @param initializeController Initialize the USART controller directly within the object constructor.
      */
-    MockUART(unsigned int baudrate, UARTController controller = UARTController::ONE, bool initializeController = true);
+    MockUARTBase(ByteBuffer rxBuffer, ByteBuffer txBuffer, unsigned int baudrate, UARTController controller = UARTController::ONE,
+                 bool initializeController = true);
+
+    MockUARTBase(const MockUARTBase &) = delete;
+    MockUARTBase &operator=(const MockUARTBase &) = delete;
 
     /**
      * @brief Begin a UART connection.
@@ -54,13 +68,13 @@ class MockUART : public UARTConnection {
      * @brief Enables the internal USART controller.
      *
      */
-    inline void enable();
+    void enable();
 
     /**
      * @brief Disables the internal USART controller.
      *
      */
-    inline void disable();
+    void disable();
 
     /**
      * @brief Send a single byte.
@@ -95,13 +109,48 @@ class MockUART : public UARTConnection {
     /**
      * @brief Send a array of bytes with a specified length.
      *
+     * In interrupt transmit mode, the oldest queued bytes are transmitted to make room, as there is no interrupt handler that
+     * would. In cooperative transmit mode, the array is only queued when it fits in the transmit buffer as a whole.
+     *
      * @param data Array of bytes.
      * @param length Length of array.
-     * @return true Array of bytes send.
-     * @return false Array of bytes has not been send, USART controller not initialized.
+     * @return true Every byte has been queued or sent.
+     * @return false Not a single byte has been queued, USART controller not initialized or the array does not fit.
      */
     bool send(const uint8_t *data, size_t length);
 
+    /**
+     * @brief Send as much of an array of bytes as possible without waiting.
+     *
+     * In interrupt transmit mode, bytes are queued in the transmit buffer until it is full. In polling mode, every byte is sent.
+     *
+     * @param data Array of bytes.
+     * @param length Length of array.
+     * @return size_t Amount of bytes accepted, 0 if the USART controller is not initialized.
+     */
+    size_t trySend(const uint8_t *data, size_t length) override;
+
+    /**
+     * @brief Check how many bytes are waiting in the transmit buffer.
+     *
+     * @return size_t Amount of bytes not yet handed to the (fake) transmitter.
+     */
+    size_t txPending() override;
+
+    /**
+     * @brief Check how many bytes can be sent without waiting.
+     *
+     * @return size_t Amount of bytes trySend() accepts right now.
+     */
+    size_t txFree() override;
+
+    /**
+     * @brief Wait until every queued byte has left the transmitter.
+     *
+     * As there is no interrupt to wait for, the transmit buffer is drained directly.
+     */
+    void flush() override;
+
     /**
      * @brief Receive a single byte.
      *
@@ -111,6 +160,49 @@ class MockUART : public UARTConnection {
      */
     uint8_t receive();
 
+    /**
+     * @brief Receive up to n bytes at once.
+     *
+     * Pops as many bytes from the receive buffer as are available, at most n, in a FIFO manner.
+     *
+     * @param buf Array to receive into.
+     * @param n Size of the array.
+     * @return size_t Amount of bytes received.
+     */
+    size_t receive(uint8_t *buf, size_t n) override;
+
+    /**
+     * @brief Get the readable part of the receive buffer, without copying it.
+     *
+     * As the receive buffer is a ring, the received bytes are split in at most two contiguous spans. The second span is empty
+     * unless the received bytes wrap around the end of the buffer. The spans stay valid until consume() is called.
+     *
+     * @param first Set to the oldest received bytes.
+     * @param second Set to the received bytes following the first span.
+     * @return size_t Amount of bytes in both spans.
+     */
+    size_t readableSpans(ByteSpan &first, ByteSpan &second) override;
+
+    /**
+     * @brief Remove bytes from the front of the receive buffer, after reading them using readableSpans().
+     *
+     * @param n Amount of bytes to remove, limited to the amount of bytes available.
+     */
+    void consume(size_t n) override;
+
+    /**
+     * @brief Find a byte in the receive buffer, e.g. the delimiter ending a line, without removing anything.
+     *
+     * Remembers how far the receive buffer has been searched, so each received byte is only inspected once, also when called
+     * again after more bytes arrived. Bytes are compared a word at a time.
+     *
+     * @param delimiter Byte to find.
+     * @param position Set to the position of the oldest occurrence, counted from the oldest received byte.
+     * @return true Found.
+     * @return false Not received yet.
+     */
+    bool findInBuffer(uint8_t delimiter, size_t &position) override;
+
     /**
      * @brief Checks if the internal USART controller has been initialized.
      *
@@ -119,6 +211,143 @@ class MockUART : public UARTConnection {
      */
     bool isInitialized();
 
+    /**
+     * @brief Select how received bytes are moved into the receive buffer.
+     *
+     * In interrupt mode, available() no longer moves injected bytes into the receive buffer. Instead, every interrupt dispatched
+     * through the InterruptRouter for the selected controller does. The mock is only attached to the controller while receive
+     * or transmit uses interrupt mode, and only when no other connection is attached to it.
+     *
+     * @param mode Receive transfer mode, polling by default.
+     */
+    void setReceiveMode(TransferMode mode) override;
+
+    /**
+     * @brief Select how bytes are moved from the transmit buffer into the (fake) transmitter.
+     *
+     * In interrupt mode, every interrupt dispatched through the InterruptRouter transmits a single queued byte.
+     * In DMA mode, transfers complete at once, as in polling mode.
+     *
+     * @param mode Transmit transfer mode, polling by default.
+     */
+    void setTransmitMode(TransferMode mode) override;
+
+    /**
+     * @brief Get the selected transmit transfer mode.
+     *
+     * @return TransferMode Transmit transfer mode.
+     */
+    TransferMode getTransmitMode() const override;
+
+    /**
+     * @brief Select what happens to received bytes when the receive buffer is full.
+     *
+     * When polling, injected bytes stay on the receive line until the receive buffer has room, the policy only matters in
+     * interrupt receive mode. XON and XOFF are transmitted like any other byte.
+     *
+     * @param policy Overflow policy, dropping new bytes by default.
+     */
+    void setOverflowPolicy(OverflowPolicy policy) override;
+
+    /**
+     * @brief Set the receive buffer levels used by the backpressure policy.
+     *
+     * @param high Amount of buffered bytes at which the sender is held off.
+     * @param low Amount of buffered bytes at which the sender is released again, below high.
+     */
+    void setWatermarks(size_t high, size_t low) override;
+
+    /**
+     * @brief Service a (simulated) USART interrupt.
+     *
+     * In interrupt receive mode, every injected byte is received into the receive buffer.
+     * In interrupt transmit mode, a single byte is taken from the transmit buffer and transmitted.
+     */
+    void handleInterrupt() override;
+
+    /**
+     * @brief Move a bounded amount of data between the (fake) line and the buffers, without waiting.
+     *
+     * In polling and cooperative receive mode, injected bytes are received into the receive buffer. In cooperative transmit
+     * mode, queued bytes are transmitted.
+     *
+     * @param budget Most bytes moved in each direction.
+     * @return size_t Amount of bytes moved.
+     */
+    size_t service(size_t budget) override;
+
+    /**
+     * @brief Inject bytes on the (fake) receive line.
+     *
+     * The bytes are received by available(), or by handleInterrupt() in interrupt receive mode. The line is idle once every
+     * injected byte has been received, which ends the frame when idle frame boundaries are used.
+     *
+     * @param data Array of bytes.
+     * @param length Length of array.
+     * @return size_t Amount of bytes injected, less than length when the receive line is full.
+     */
+    size_t inject(const uint8_t *data, size_t length);
+
+    /**
+     * @brief Inject a string on the (fake) receive line.
+     *
+     * @param str String.
+     * @return size_t Amount of bytes injected, less than the string length when the receive line is full.
+     */
+    size_t inject(const char *str);
+
+    /**
+     * @brief Check how many injected bytes have not been received yet.
+     *
+     * @return size_t Amount of bytes waiting on the receive line.
+     */
+    size_t rxLinePending();
+
+    /**
+     * @brief Simulate an error reported by the USART controller, counted in the link statistics.
+     *
+     * @param error Error.
+     */
+    void injectError(LineError error);
+
+    /**
+     * @brief Check how many transmitted bytes have been captured.
+     *
+     * Bytes are only captured when the mock is neither in loopback mode nor connected to another mock.
+     *
+     * @return size_t Amount of captured bytes.
+     */
+    size_t txCaptured();
+
+    /**
+     * @brief Read and remove captured transmitted bytes, in the order they were transmitted.
+     *
+     * @param buf Array to read into.
+     * @param n Size of the array.
+     * @return size_t Amount of bytes read.
+     */
+    size_t readTransmitted(uint8_t *buf, size_t n);
+
+    /**
+     * @brief Enable or disable loopback mode, in which transmitted bytes are put on our own receive line.
+     *
+     * @param enabled Loopback mode enabled.
+     */
+    void setLoopback(bool enabled);
+
+    /**
+     * @brief Connect to another mock back to back, so the bytes transmitted by one are put on the receive line of the other.
+     *
+     * @param other Mock to connect to.
+     */
+    void connect(MockUARTBase &other);
+
+    /**
+     * @brief Disconnect from the connected mock, if any.
+     *
+     */
+    void disconnect();
+
     /**
      * @brief Write a character using UART.
      *
@@ -148,12 +377,12 @@ class MockUART : public UARTConnection {
     char getc() override;
 
     /**
-     * @brief Destroy the MockUART object.
+     * @brief Destroy the MockUARTBase object.
      *
      * Disables the UART controller to save resources.
      *
      */
-    ~MockUART();
+    ~MockUARTBase();
 
   private:
     /**
@@ -174,11 +403,89 @@ class MockUART : public UARTConnection {
      */
     bool USARTControllerInitialized;
 
+    /**
+     * @brief Selected receive transfer mode.
+     *
+     */
+    TransferMode receiveMode;
+
+    /**
+     * @brief Selected transmit transfer mode.
+     *
+     */
+    TransferMode transmitMode;
+
     /**
      * @brief UART receive buffer.
      *
      */
-    Queue<uint8_t, 250> rxBuffer;
+    ByteBuffer rxBuffer;
+
+    /**
+     * @brief UART transmit buffer, drained by (simulated) interrupts in interrupt transmit mode.
+     *
+     */
+    ByteBuffer txBuffer;
+
+    /**
+     * @brief Applies the overflow policy to the receive buffer.
+     *
+     */
+    OverflowControl rxControl;
+
+    /**
+     * @brief Fake receive line, holding injected bytes until they are received.
+     *
+     */
+    Queue<uint8_t, 1024> rxLine;
+
+    /**
+     * @brief Captured transmitted bytes.
+     *
+     */
+    Queue<uint8_t, 1024> txCapture;
+
+    /**
+     * @brief Loopback mode enabled.
+     *
+     */
+    bool loopback;
+
+    /**
+     * @brief Mock connected back to back, nullptr when not connected.
+     *
+     */
+    MockUARTBase *peer;
+
+    /**
+     * @brief Move injected bytes from the receive line into the receive buffer.
+     *
+     * When polling, bytes are only moved as far as the receive buffer has room. Like the interrupt handler of the hardware
+     * implementation, interrupt mode drains the whole line and drops what does not fit.
+     *
+     * @param budget Most bytes moved.
+     * @return size_t Amount of bytes moved.
+     */
+    size_t receiveLine(size_t budget);
+
+    /**
+     * @brief Attach to the (simulated) interrupt of the controller while a direction uses interrupt mode, detach otherwise.
+     *
+     */
+    void routeInterrupt();
+
+    /**
+     * @brief Put a transmitted byte on the (fake) line.
+     *
+     * @param b Byte.
+     */
+    void transmitByte(uint8_t b);
+
+    /**
+     * @brief Release the sender, when held off and the receive buffer has been read down to the low watermark.
+     *
+     */
+    void resumeSender();
 
     /**
      * @brief Checks if the USART controller reports that the transmitter is ready to send.
@@ -186,7 +493,7 @@ class MockUART : public UARTConnection {
      * @return true Ready to send.
      * @return false Not ready to send.
      */
-    inline bool txReady();
+    bool txReady();
 
     /**
      * @brief Send a byte of the serial connection.
@@ -196,13 +503,42 @@ class MockUART : public UARTConnection {
     void sendByte(const uint8_t &b);
 
     /**
-     * @brief Receive a single byte by reading the US_RHR register.
+     * @brief Receive a single byte from the receive line.
      *
      * @return char
      */
-    inline uint8_t receiveByte();
+    uint8_t receiveByte();
+};
+
+/**
+ * @brief MockUART with receive and transmit buffers of a chosen capacity.
+ *
+ * @tparam RX_BUFFER_SIZE Size of the receive buffer, a power of two. Holds one byte less.
+ * @tparam TX_BUFFER_SIZE Size of the transmit buffer, a power of two. Holds one byte less.
+ */
+template <size_t RX_BUFFER_SIZE, size_t TX_BUFFER_SIZE>
+class BufferedMockUART : private BufferStorage<RX_BUFFER_SIZE, TX_BUFFER_SIZE>, public MockUARTBase {
+    typedef BufferStorage<RX_BUFFER_SIZE, TX_BUFFER_SIZE> Storage;
+
+  public:
+    /**
+     * @brief Construct a new BufferedMockUART object.
+     *
+     * @param baudrate Transmit and receive baudrate.
+     * @param controller Controller used to transmit and receive.
+     * @param initializeController Initialize the USART controller directly within the object constructor.
+     */
+    BufferedMockUART(unsigned int baudrate, UARTController controller = UARTController::ONE, bool initializeController = true)
+        : MockUARTBase(ByteBuffer(Storage::rxStorage), ByteBuffer(Storage::txStorage), baudrate, controller, initializeController) {
+    }
 };
 
+/**
+ * @brief MockUART with 256 byte receive and transmit buffers.
+ *
+ */
+typedef BufferedMockUART<256, 256> MockUART;
+
 } // namespace UARTLib
 
 #endif
\ No newline at end of file
@@ -0,0 +1,167 @@
+/**
+ * @file
+ * @brief     What a connection does when its receive buffer fills up.
+ * @author    Wiebe van Breukelen
+ * @license   See LICENSE
+ */
+
+#ifndef OVERFLOW_POLICY_HPP
+#define OVERFLOW_POLICY_HPP
+
+#include "byte_buffer.hpp"
+#include "frame_index.hpp"
+#include "link_statistics.hpp"
+#include "wrap-hwlib.hpp"
+
+namespace UARTLib {
+
+/**
+ * @brief Used to select what happens to received bytes when the receive buffer is full.
+ *
+ * Drop newest      - The received byte is dropped, what has been buffered is kept. Default.
+ * Overwrite oldest - The oldest buffered byte is dropped to make room, e.g. for telemetry where only recent data matters.
+ * Backpressure     - The sender is held off once the receive buffer reaches the high watermark, and released again once it
+ *                    has been read down to the low watermark. Bytes still arriving when full are dropped.
+ */
+enum class OverflowPolicy { DROP_NEWEST, OVERWRITE_OLDEST, BACKPRESSURE };
+
+/**
+ * @brief Software flow control character releasing the sender (DC1).
+ *
+ */
+constexpr uint8_t XON = 0x11;
+
+/**
+ * @brief Software flow control character holding off the sender (DC3).
+ *
+ */
+constexpr uint8_t XOFF = 0x13;
+
+/**
+ * @brief Applies the overflow policy of a connection to its receive buffer.
+ *
+ * The producer side (interrupt handler or polling receive) stores bytes through store(), the consumer side asks resume() after
+ * reading. Both tell the connection when to hold off or release the sender, the connection decides how.
+ */
+class OverflowControl {
+  public:
+    /**
+     * @brief Construct a new OverflowControl object, dropping new bytes when full.
+     *
+     * @param capacity Capacity of the receive buffer, the watermarks are set to three and one quarter of it.
+     */
+    explicit OverflowControl(size_t capacity)
+        : policy(OverflowPolicy::DROP_NEWEST), highWatermark(capacity * 3 / 4), lowWatermark(capacity / 4), paused(false) {
+    }
+
+    /**
+     * @brief Select the overflow policy, consumer side.
+     *
+     * Only the overwrite oldest policy lets the producer advance the front index of the receive buffer, making the consumer
+     * side use compare and swap.
+     *
+     * @param policy Overflow policy.
+     * @param buffer Receive buffer.
+     */
+    void setPolicy(OverflowPolicy policy, ByteBuffer &buffer) {
+        ///< Allow overwriting before the producer starts, disallow it once the producer stopped.
+        if (policy == OverflowPolicy::OVERWRITE_OLDEST) {
+            buffer.setOverwriting(true);
+            this->policy = policy;
+        } else {
+            this->policy = policy;
+            buffer.setOverwriting(false);
+        }
+    }
+
+    /**
+     * @brief Get the overflow policy.
+     *
+     * @return OverflowPolicy Overflow policy.
+     */
+    OverflowPolicy getPolicy() const {
+        return policy;
+    }
+
+    /**
+     * @brief Set the buffer levels at which the sender is held off and released again, using the backpressure policy.
+     *
+     * @param high Amount of buffered bytes at which the sender is held off.
+     * @param low Amount of buffered bytes at which the sender is released again, below high.
+     */
+    void setWatermarks(size_t high, size_t low) {
+        highWatermark = high;
+        lowWatermark = low < high || high == 0 ? low : high - 1;
+    }
+
+    /**
+     * @brief Check if the sender is currently held off.
+     *
+     * @return true Held off.
+     * @return false Free to send.
+     */
+    bool isPaused() const {
+        return paused;
+    }
+
+    /**
+     * @brief Store a received byte according to the policy, producer side.
+     *
+     * @param buffer Receive buffer.
+     * @param b Received byte.
+     * @param stats Statistics counting the byte.
+     * @param frames Frame index accounting for the byte, nullptr for none.
+     * @return true The sender must be held off now.
+     * @return false Nothing to do.
+     */
+    bool store(ByteBuffer &buffer, uint8_t b, LinkStatistics &stats, FrameIndex *frames = nullptr) {
+        bool stored = policy == OverflowPolicy::OVERWRITE_OLDEST ? buffer.pushOverwrite(b) : buffer.push(b);
+        size_t level = buffer.count();
+
+        stats.recordReceived(stored, level);
+
+        if (frames != nullptr) {
+            frames->received(b, stored);
+        }
+
+        if (policy == OverflowPolicy::BACKPRESSURE && !paused && level >= highWatermark) {
+            paused = true;
+            return true;
+        }
+
+        return false;
+    }
+
+    /**
+     * @brief Check if the sender can be released, consumer side.
+     *
+     * Call resumed() once the sender has been released, not before, so the producer side does not hold it off in between.
+     *
+     * @param buffer Receive buffer.
+     * @return true The sender must be released now.
+     * @return false Nothing to do.
+     */
+    bool resume(ByteBuffer &buffer) {
+        return paused && static_cast<size_t>(buffer.count()) <= lowWatermark;
+    }
+
+    /**
+     * @brief Mark the sender as released.
+     *
+     */
+    void resumed() {
+        paused = false;
+    }
+
+  private:
+    OverflowPolicy policy;
+    size_t highWatermark;
+    size_t lowWatermark;
+
+    ///< Written by the producer while false, by the consumer while true.
+    volatile bool paused;
+};
+
+} // namespace UARTLib
+
+#endif
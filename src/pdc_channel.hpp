@@ -0,0 +1,169 @@
+/**
+ * @file
+ * @brief     Peripheral DMA Controller (PDC) descriptor handling for the USART controllers.
+ * @author    Wiebe van Breukelen
+ * @license   See LICENSE
+ */
+
+#ifndef PDC_CHANNEL_HPP
+#define PDC_CHANNEL_HPP
+
+#include "wrap-hwlib.hpp"
+
+namespace UARTLib {
+
+/**
+ * @brief Programs the PDC pointer and counter registers of a USART controller.
+ *
+ * Every USART controller on the Arduino Due has a PDC channel with a current (US_TPR/US_TCR) and a next (US_TNPR/US_TNCR)
+ * transmit descriptor. When the current counter reaches zero, the PDC loads the next descriptor by itself, so two chained
+ * transfers leave the transmitter without a gap.
+ *
+ * The register block is a template parameter, so the descriptor handling can be verified against a register model on the host.
+ *
+ * @tparam Registers Register block providing the US_TPR, US_TCR, US_TNPR, US_TNCR and US_PTCR registers (e.g. Usart).
+ */
+template <class Registers>
+class PdcChannel {
+  public:
+    /**
+     * @brief Largest amount of bytes a single descriptor can transfer, as the counter registers are 16 bit.
+     *
+     */
+    static constexpr size_t maxTransferLength = 0xFFFF;
+
+    /**
+     * @brief Queue a transmit transfer.
+     *
+     * The transfer is placed in the current descriptor when the channel is idle, or chained in the next descriptor when a
+     * transfer is in progress. The data is read by the PDC while it is being sent, so it should stay valid until transmitPending()
+     * has dropped far enough.
+     *
+     * @param registers Register block of the USART controller.
+     * @param data Array of bytes to send.
+     * @param length Length of array, at most maxTransferLength.
+     * @return true Transfer queued.
+     * @return false Both descriptors are in use, or the transfer is too long.
+     */
+    static bool queueTransmit(Registers &registers, const uint8_t *data, size_t length);
+
+    /**
+     * @brief Check if a transfer can be queued right now.
+     *
+     * @param registers Register block of the USART controller.
+     * @return true The next descriptor is free.
+     * @return false Both descriptors are in use.
+     */
+    static bool canQueueTransmit(Registers &registers);
+
+    /**
+     * @brief Check how many bytes the PDC still has to send.
+     *
+     * @param registers Register block of the USART controller.
+     * @return size_t Bytes left in the current and next descriptor.
+     */
+    static size_t transmitPending(Registers &registers);
+
+    /**
+     * @brief Check if the transmit channel has finished every queued transfer.
+     *
+     * @param registers Register block of the USART controller.
+     * @return true No transfers left.
+     * @return false A transfer is in progress.
+     */
+    static bool transmitIdle(Registers &registers);
+
+    /**
+     * @brief Enable transfers of the transmit channel.
+     *
+     * @param registers Register block of the USART controller.
+     */
+    static void enableTransmit(Registers &registers);
+
+    /**
+     * @brief Disable transfers of the transmit channel.
+     *
+     * @param registers Register block of the USART controller.
+     */
+    static void disableTransmit(Registers &registers);
+
+    /**
+     * @brief Convert a buffer address to the value of a pointer register.
+     *
+     * On the Arduino Due addresses are 32 bit. A host side register model may use wider pointer registers.
+     *
+     * @param data Buffer address.
+     * @return uintptr_t Register value.
+     */
+    static uintptr_t address(const uint8_t *data);
+
+  private:
+    /**
+     * @brief US_PTCR bits, see section 26.5.6 of the SAM3X datasheet. Spelled out, so the register model needs no device headers.
+     *
+     */
+    static constexpr uint32_t transmitEnableBit = 1u << 8;
+    static constexpr uint32_t transmitDisableBit = 1u << 9;
+};
+
+template <class Registers>
+constexpr size_t PdcChannel<Registers>::maxTransferLength;
+
+template <class Registers>
+bool PdcChannel<Registers>::queueTransmit(Registers &registers, const uint8_t *data, size_t length) {
+    if (length == 0) {
+        return true;
+    }
+
+    if (length > maxTransferLength) {
+        return false;
+    }
+
+    if (registers.US_TCR == 0 && registers.US_TNCR == 0) {
+        ///< Channel is idle, start right away.
+        registers.US_TPR = address(data);
+        registers.US_TCR = length;
+    } else if (registers.US_TNCR == 0) {
+        ///< Chain behind the transfer in progress. Writing the counter arms the descriptor, so the pointer goes first.
+        registers.US_TNPR = address(data);
+        registers.US_TNCR = length;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+template <class Registers>
+bool PdcChannel<Registers>::canQueueTransmit(Registers &registers) {
+    return registers.US_TNCR == 0;
+}
+
+template <class Registers>
+size_t PdcChannel<Registers>::transmitPending(Registers &registers) {
+    return registers.US_TCR + registers.US_TNCR;
+}
+
+template <class Registers>
+bool PdcChannel<Registers>::transmitIdle(Registers &registers) {
+    return registers.US_TCR == 0 && registers.US_TNCR == 0;
+}
+
+template <class Registers>
+void PdcChannel<Registers>::enableTransmit(Registers &registers) {
+    registers.US_PTCR = transmitEnableBit;
+}
+
+template <class Registers>
+void PdcChannel<Registers>::disableTransmit(Registers &registers) {
+    registers.US_PTCR = transmitDisableBit;
+}
+
+template <class Registers>
+uintptr_t PdcChannel<Registers>::address(const uint8_t *data) {
+    return reinterpret_cast<uintptr_t>(data);
+}
+
+} // namespace UARTLib
+
+#endif
@@ -0,0 +1,435 @@
+#include "posix_serial_uart.hpp"
+
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__APPLE__)
+#include <util.h>
+#else
+#include <pty.h>
+#endif
+
+namespace UARTLib {
+
+namespace {
+
+///< Largest read from the kernel at once, when overwriting the oldest bytes.
+constexpr size_t maxReadLength = 512;
+
+bool toSpeed(unsigned int baudrate, speed_t &speed) {
+    struct Rate {
+        unsigned int baudrate;
+        speed_t speed;
+    };
+
+    static const Rate rates[] = {{1200, B1200},     {2400, B2400},     {4800, B4800},   {9600, B9600},
+                                 {19200, B19200},   {38400, B38400},   {57600, B57600}, {115200, B115200},
+                                 {230400, B230400},
+#ifdef B460800
+                                 {460800, B460800},
+#endif
+#ifdef B921600
+                                 {921600, B921600},
+#endif
+    };
+
+    for (const Rate &rate : rates) {
+        if (rate.baudrate == baudrate) {
+            speed = rate.speed;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+uint64_t monotonicMicros() {
+    timespec now;
+    ::clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return static_cast<uint64_t>(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+}
+
+bool waitFor(int fd, short events, int timeoutMs) {
+    pollfd request = {fd, events, 0};
+
+    int result;
+    do {
+        result = ::poll(&request, 1, timeoutMs);
+    } while (result < 0 && errno == EINTR);
+
+    return result > 0 && (request.revents & events) != 0;
+}
+
+} // namespace
+
+PosixSerialUARTBase::PosixSerialUARTBase(ByteBuffer rxBuffer, const char *path, unsigned int baudrate,
+                                         bool initializeController)
+    : path(path), fd(-1), baudrate(baudrate), USARTControllerInitialized(false), rxBuffer(rxBuffer),
+      rxControl(rxBuffer.capacity()), transmitMode(TransferMode::POLLING), lastReceived(0) {
+    if (initializeController) {
+        begin();
+    }
+}
+
+PosixSerialUARTBase::PosixSerialUARTBase(ByteBuffer rxBuffer, int fd, unsigned int baudrate, bool initializeController)
+    : path(nullptr), fd(fd), baudrate(baudrate), USARTControllerInitialized(false), rxBuffer(rxBuffer),
+      rxControl(rxBuffer.capacity()), transmitMode(TransferMode::POLLING), lastReceived(0) {
+    if (initializeController) {
+        begin();
+    }
+}
+
+PosixSerialUARTBase::~PosixSerialUARTBase() {
+    if (fd >= 0) {
+        ::close(fd);
+    }
+}
+
+void PosixSerialUARTBase::begin() {
+    if (USARTControllerInitialized) {
+        return;
+    }
+
+    if (fd < 0 && path != nullptr) {
+        fd = ::open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    }
+
+    if (fd < 0) {
+        return;
+    }
+
+    ///< Raw mode: no line editing, echo or character translation, reads return whatever has arrived.
+    termios settings;
+    speed_t speed;
+    if (!toSpeed(baudrate, speed) || ::tcgetattr(fd, &settings) != 0) {
+        return;
+    }
+
+    ::cfmakeraw(&settings);
+    settings.c_cflag |= CLOCAL | CREAD;
+    settings.c_cc[VMIN] = 0;
+    settings.c_cc[VTIME] = 0;
+    ::cfsetispeed(&settings, speed);
+    ::cfsetospeed(&settings, speed);
+
+    if (::tcsetattr(fd, TCSANOW, &settings) != 0) {
+        return;
+    }
+
+    ///< A descriptor handed to us may still be blocking.
+    ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    USARTControllerInitialized = true;
+}
+
+unsigned int PosixSerialUARTBase::available() {
+    if (!USARTControllerInitialized) {
+        return 0;
+    }
+
+    receiveKernel(static_cast<size_t>(-1));
+
+    return rxBuffer.count();
+}
+
+void PosixSerialUARTBase::enable() {
+    if (fd >= 0) {
+        ::tcflow(fd, TCOON);
+    }
+}
+
+void PosixSerialUARTBase::disable() {
+    if (fd >= 0) {
+        ::tcflow(fd, TCOOFF);
+    }
+}
+
+bool PosixSerialUARTBase::send(const uint8_t b) {
+    return send(&b, 1);
+}
+
+bool PosixSerialUARTBase::send(const uint8_t *str) {
+    size_t length = 0;
+    while (str[length] != '\0') {
+        length++;
+    }
+
+    return send(str, length);
+}
+
+bool PosixSerialUARTBase::send(const char *str) {
+    return send(reinterpret_cast<const uint8_t *>(str));
+}
+
+bool PosixSerialUARTBase::send(const uint8_t *data, size_t length) {
+    if (!USARTControllerInitialized) {
+        return false;
+    }
+
+    ///< Never wait in cooperative mode. All bytes are written, or none.
+    if (transmitMode == TransferMode::COOPERATIVE && txFree() < length) {
+        return false;
+    }
+
+    size_t sent = 0;
+    while (sent < length) {
+        sent += trySend(data + sent, length - sent);
+
+        ///< After a short write, wait for room. Only a device that hung up stops us halfway.
+        if (sent < length && !txReady()) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+size_t PosixSerialUARTBase::trySend(const uint8_t *data, size_t length) {
+    if (!USARTControllerInitialized || length == 0) {
+        return 0;
+    }
+
+    ssize_t written;
+    do {
+        written = ::write(fd, data, length);
+    } while (written < 0 && errno == EINTR);
+
+    if (written <= 0) {
+        return 0;
+    }
+
+    stats.bytesSent += written;
+
+    return written;
+}
+
+size_t PosixSerialUARTBase::txPending() {
+    int pending = 0;
+    if (!USARTControllerInitialized || ::ioctl(fd, TIOCOUTQ, &pending) != 0 || pending < 0) {
+        return 0;
+    }
+
+    stats.recordTxLevel(pending);
+
+    return pending;
+}
+
+size_t PosixSerialUARTBase::txFree() {
+    if (!USARTControllerInitialized) {
+        return 0;
+    }
+
+    return waitFor(fd, POLLOUT, 0) ? 1 : 0;
+}
+
+void PosixSerialUARTBase::flush() {
+    if (USARTControllerInitialized) {
+        ::tcdrain(fd);
+    }
+}
+
+uint8_t PosixSerialUARTBase::receive() {
+    uint8_t b = 0;
+    receive(&b, 1);
+
+    return b;
+}
+
+size_t PosixSerialUARTBase::receive(uint8_t *buf, size_t n) {
+    if (!USARTControllerInitialized) {
+        return 0;
+    }
+
+    size_t received = rxBuffer.pop(buf, n);
+    resumeSender();
+
+    ///< With the receive buffer empty, the rest can skip it. Unless frames are indexed, as they count the buffered bytes.
+    if (received < n && frames.getBoundary() == FrameBoundary::NONE) {
+        ssize_t result;
+        do {
+            result = ::read(fd, buf + received, n - received);
+        } while (result < 0 && errno == EINTR);
+
+        if (result > 0) {
+            stats.bytesReceived += result;
+            received += result;
+        }
+    }
+
+    return received;
+}
+
+size_t PosixSerialUARTBase::readableSpans(ByteSpan &first, ByteSpan &second) {
+    if (!USARTControllerInitialized) {
+        first.length = second.length = 0;
+        return 0;
+    }
+
+    receiveKernel(static_cast<size_t>(-1));
+
+    return rxBuffer.peekRegions(first.data, first.length, second.data, second.length);
+}
+
+void PosixSerialUARTBase::consume(size_t n) {
+    rxBuffer.drop(n);
+    resumeSender();
+}
+
+bool PosixSerialUARTBase::findInBuffer(uint8_t delimiter, size_t &position) {
+    if (!USARTControllerInitialized) {
+        return false;
+    }
+
+    receiveKernel(static_cast<size_t>(-1));
+
+    return rxBuffer.find(delimiter, position);
+}
+
+bool PosixSerialUARTBase::isInitialized() {
+    return USARTControllerInitialized;
+}
+
+void PosixSerialUARTBase::setReceiveMode(TransferMode) {
+}
+
+void PosixSerialUARTBase::setTransmitMode(TransferMode mode) {
+    transmitMode = mode;
+}
+
+TransferMode PosixSerialUARTBase::getTransmitMode() const {
+    return transmitMode;
+}
+
+void PosixSerialUARTBase::setOverflowPolicy(OverflowPolicy policy) {
+    rxControl.setPolicy(policy, rxBuffer);
+
+    ///< Without backpressure, nothing releases a sender that is held off any more.
+    if (policy != OverflowPolicy::BACKPRESSURE && rxControl.isPaused()) {
+        ::tcflow(fd, TCION);
+        rxControl.resumed();
+    }
+}
+
+void PosixSerialUARTBase::setWatermarks(size_t high, size_t low) {
+    rxControl.setWatermarks(high, low);
+}
+
+void PosixSerialUARTBase::handleInterrupt() {
+}
+
+size_t PosixSerialUARTBase::service(size_t budget) {
+    if (!USARTControllerInitialized) {
+        return 0;
+    }
+
+    return receiveKernel(budget);
+}
+
+bool PosixSerialUARTBase::waitReadable(int timeoutMs) {
+    if (!USARTControllerInitialized) {
+        return false;
+    }
+
+    return available() > 0 || (waitFor(fd, POLLIN, timeoutMs) && available() > 0);
+}
+
+int PosixSerialUARTBase::fileDescriptor() const {
+    return fd;
+}
+
+void PosixSerialUARTBase::putc(char c) {
+    sendByte(c);
+}
+
+char PosixSerialUARTBase::getc() {
+    if (available() > 0) {
+        return receive();
+    }
+
+    return 0;
+}
+
+bool PosixSerialUARTBase::char_available() {
+    return (available() > 0);
+}
+
+size_t PosixSerialUARTBase::receiveKernel(size_t budget) {
+    uint8_t chunk[maxReadLength];
+    size_t received = 0;
+
+    while (received < budget) {
+        ///< Bytes that do not fit are left to the kernel, unless the oldest buffered bytes make room for them.
+        size_t room = rxBuffer.capacity() - rxBuffer.count();
+        if (rxControl.getPolicy() == OverflowPolicy::OVERWRITE_OLDEST) {
+            room = maxReadLength;
+        }
+
+        room = room < budget - received ? room : budget - received;
+        if (room == 0) {
+            break;
+        }
+
+        ssize_t result = ::read(fd, chunk, room < maxReadLength ? room : maxReadLength);
+        if (result <= 0) {
+            break;
+        }
+
+        received += result;
+
+        for (ssize_t i = 0; i < result; i++) {
+            ///< The kernel sends XOFF, as the terminal driver handles flow control.
+            if (rxControl.store(rxBuffer, chunk[i], stats, &frames)) {
+                ::tcflow(fd, TCIOFF);
+            }
+        }
+    }
+
+    ///< The kernel keeps no receive times, the line counts as idle once nothing arrived for the idle bit periods.
+    if (frames.getBoundary() == FrameBoundary::IDLE) {
+        uint64_t now = monotonicMicros();
+
+        if (received > 0) {
+            lastReceived = now;
+        } else if (frames.isOpen() && now - lastReceived >= uint64_t(frames.getParameter()) * 1000000 / baudrate) {
+            frames.idle();
+        }
+    }
+
+    return received;
+}
+
+void PosixSerialUARTBase::resumeSender() {
+    if (rxControl.resume(rxBuffer)) {
+        ::tcflow(fd, TCION);
+        rxControl.resumed();
+    }
+}
+
+bool PosixSerialUARTBase::txReady() {
+    return USARTControllerInitialized && waitFor(fd, POLLOUT, -1);
+}
+
+void PosixSerialUARTBase::sendByte(const uint8_t &b) {
+    send(&b, 1);
+}
+
+uint8_t PosixSerialUARTBase::receiveByte() {
+    uint8_t b = 0;
+    if (USARTControllerInitialized && ::read(fd, &b, 1) == 1) {
+        stats.bytesReceived++;
+    }
+
+    return b;
+}
+
+bool openPseudoTerminal(int &first, int &second) {
+    return ::openpty(&first, &second, nullptr, nullptr, nullptr) == 0;
+}
+
+} // namespace UARTLib
@@ -0,0 +1,474 @@
+/**
+ * @file
+ * @brief     UART connection over a POSIX serial device or pseudo-terminal, for host builds.
+ * @author    Wiebe van Breukelen
+ * @license   See LICENSE
+ */
+
+#ifndef POSIX_SERIAL_UART_HPP
+#define POSIX_SERIAL_UART_HPP
+
+#include "byte_buffer.hpp"
+#include "overflow_policy.hpp"
+#include "uart_connection.hpp"
+#include "wrap-hwlib.hpp"
+
+namespace UARTLib {
+
+/**
+ * @brief Establishes a serial connection using a tty device (e.g. /dev/ttyUSB0) or a pseudo-terminal, on Linux or another
+ * POSIX host.
+ *
+ * This lets code written against UARTConnection run on a host, e.g. a gateway talking to an Arduino Due. The device is used in
+ * raw, non-blocking mode. The kernel buffers received bytes and moves them from the device, so the transfer modes make no
+ * difference. available() moves received bytes from the kernel into the receive buffer using bulk reads, and
+ * receive(buf, n) reads straight from the kernel into the caller's array once the receive buffer is empty, unless frames are
+ * indexed. Idle frame boundaries are found when moving bytes from the kernel, so the gap must outlast the time between two
+ * calls.
+ *
+ * The receive buffer uses storage provided by the owner. PosixSerialUART provides a 4096 byte buffer,
+ * BufferedPosixSerialUART any other power of two.
+ */
+class PosixSerialUARTBase : public UARTConnection {
+  public:
+    /**
+     * @brief Construct a new PosixSerialUARTBase object, opening a device.
+     *
+     * @param rxBuffer Receive buffer.
+     * @param path Path of the device, e.g. /dev/ttyUSB0. Must stay valid until begin() has been called.
+     * @param baudrate Transmit and receive baudrate, one of the rates supported by termios.
+     * @param initializeController Open the device directly within the object constructor.
+     */
+    PosixSerialUARTBase(ByteBuffer rxBuffer, const char *path, unsigned int baudrate, bool initializeController = true);
+
+    /**
+     * @brief Construct a new PosixSerialUARTBase object, using a device that has already been opened.
+     *
+     * For example, one end of a pseudo-terminal pair created using openpty(). The object takes ownership of the descriptor.
+     *
+     * @param rxBuffer Receive buffer.
+     * @param fd File descriptor of the device.
+     * @param baudrate Transmit and receive baudrate, one of the rates supported by termios.
+     * @param initializeController Configure the device directly within the object constructor.
+     */
+    PosixSerialUARTBase(ByteBuffer rxBuffer, int fd, unsigned int baudrate, bool initializeController = true);
+
+    PosixSerialUARTBase(const PosixSerialUARTBase &) = delete;
+    PosixSerialUARTBase &operator=(const PosixSerialUARTBase &) = delete;
+
+    /**
+     * @brief Begin a UART connection.
+     *
+     * Opens the device if needed, and puts it in raw, non-blocking mode at the selected baudrate. When the device cannot be
+     * opened or configured, the connection stays uninitialized, see isInitialized().
+     *
+     */
+    void begin() override;
+
+    /**
+     * @brief Check how many bytes are available to read.
+     *
+     * Moves whatever the kernel has received into the receive buffer, as far as it has room.
+     *
+     * @return unsigned int Amount of bytes available to read.
+     */
+    unsigned int available() override;
+
+    /**
+     * @brief Resume transmission, after disable().
+     *
+     */
+    void enable() override;
+
+    /**
+     * @brief Suspend transmission. Bytes sent in the meantime are kept by the kernel.
+     *
+     */
+    void disable() override;
+
+    /**
+     * @brief Send a single byte.
+     *
+     * @param c Byte.
+     * @return true Byte send.
+     * @return false Byte has not been send, device not initialized.
+     */
+    bool send(const uint8_t c) override;
+
+    /**
+     * @brief Send a string.
+     *
+     * @param str String.
+     * @return true String send.
+     * @return false String has not been send, device not initialized.
+     */
+    bool send(const uint8_t *str) override;
+
+    /**
+     * @brief Send a string.
+     *
+     * @param data String.
+     * @return true String has been send.
+     * @return false String has not been send, device not initialized.
+     */
+    bool send(const char *data) override;
+
+    /**
+     * @brief Send a array of bytes with a specified length.
+     *
+     * Waits while the kernel transmit buffer is full. In cooperative transmit mode, it never waits. As the kernel does not tell
+     * how much room is left, only arrays of at most txFree() bytes are written then, use trySend() for longer ones.
+     *
+     * @param data Array of bytes.
+     * @param length Length of array.
+     * @return true Every byte has been written.
+     * @return false Not a single byte has been written, device not initialized or the array does not fit in cooperative
+     * mode. Or the device hung up while writing, the bytes written are lost along with it.
+     */
+    bool send(const uint8_t *data, size_t length) override;
+
+    /**
+     * @brief Send as much of an array of bytes as the kernel accepts without waiting.
+     *
+     * @param data Array of bytes.
+     * @param length Length of array.
+     * @return size_t Amount of bytes accepted, 0 if the device is not initialized.
+     */
+    size_t trySend(const uint8_t *data, size_t length) override;
+
+    /**
+     * @brief Check how many bytes are waiting in the kernel transmit buffer.
+     *
+     * @return size_t Amount of bytes not yet transmitted, 0 when the device does not tell.
+     */
+    size_t txPending() override;
+
+    /**
+     * @brief Check if bytes can be sent without waiting.
+     *
+     * The kernel does not tell how much room its transmit buffer has left.
+     *
+     * @return size_t 1 when trySend() accepts at least one byte right now, 0 otherwise.
+     */
+    size_t txFree() override;
+
+    /**
+     * @brief Wait until every sent byte has been transmitted.
+     *
+     */
+    void flush() override;
+
+    /**
+     * @brief Receive a single byte.
+     *
+     * @return uint8_t Received byte, 0 if nothing has been received.
+     */
+    uint8_t receive() override;
+
+    /**
+     * @brief Receive up to n bytes at once.
+     *
+     * Takes the bytes in the receive buffer first, then reads the rest straight from the kernel into the array, unless a frame
+     * boundary has been selected.
+     *
+     * @param buf Array to receive into.
+     * @param n Size of the array.
+     * @return size_t Amount of bytes received.
+     */
+    size_t receive(uint8_t *buf, size_t n) override;
+
+    /**
+     * @brief Get the readable part of the receive buffer, without copying it.
+     *
+     * @param first Set to the oldest received bytes.
+     * @param second Set to the received bytes following the first span.
+     * @return size_t Amount of bytes in both spans.
+     */
+    size_t readableSpans(ByteSpan &first, ByteSpan &second) override;
+
+    /**
+     * @brief Remove bytes from the front of the receive buffer, after reading them using readableSpans().
+     *
+     * @param n Amount of bytes to remove, limited to the amount of bytes available.
+     */
+    void consume(size_t n) override;
+
+    /**
+     * @brief Find a byte in the receive buffer, e.g. the delimiter ending a line, without removing anything.
+     *
+     * Remembers how far the receive buffer has been searched, so each received byte is only inspected once, also when called
+     * again after more bytes arrived. Bytes are compared a word at a time.
+     *
+     * @param delimiter Byte to find.
+     * @param position Set to the position of the oldest occurrence, counted from the oldest received byte.
+     * @return true Found.
+     * @return false Not received yet.
+     */
+    bool findInBuffer(uint8_t delimiter, size_t &position) override;
+
+    /**
+     * @brief Checks if the device has been opened and configured.
+     *
+     * @return true Device is ready.
+     * @return false Device could not be opened or configured, or begin() has not been called.
+     */
+    bool isInitialized() override;
+
+    /**
+     * @brief Select the receive transfer mode.
+     *
+     * The kernel moves received bytes from the device, so every mode behaves the same.
+     *
+     * @param mode Receive transfer mode.
+     */
+    void setReceiveMode(TransferMode mode) override;
+
+    /**
+     * @brief Select the transmit transfer mode.
+     *
+     * The kernel moves sent bytes to the device, so the modes behave the same, except that send() does not wait in cooperative
+     * mode.
+     *
+     * @param mode Transmit transfer mode.
+     */
+    void setTransmitMode(TransferMode mode) override;
+
+    /**
+     * @brief Get the selected transmit transfer mode.
+     *
+     * @return TransferMode Transmit transfer mode.
+     */
+    TransferMode getTransmitMode() const override;
+
+    /**
+     * @brief Select what happens to received bytes when the receive buffer is full.
+     *
+     * Bytes that do not fit are left to the kernel, unless the oldest bytes are overwritten. Using backpressure, the kernel sends
+     * XOFF at the high watermark and XON at the low watermark.
+     *
+     * @param policy Overflow policy, dropping new bytes by default.
+     */
+    void setOverflowPolicy(OverflowPolicy policy) override;
+
+    /**
+     * @brief Set the receive buffer levels used by the backpressure policy.
+     *
+     * @param high Amount of buffered bytes at which the sender is held off.
+     * @param low Amount of buffered bytes at which the sender is released again, below high.
+     */
+    void setWatermarks(size_t high, size_t low) override;
+
+    /**
+     * @brief There are no interrupts to service on a host, does nothing.
+     *
+     */
+    void handleInterrupt() override;
+
+    /**
+     * @brief Move a bounded amount of received bytes from the kernel into the receive buffer, without waiting.
+     *
+     * The kernel transmits sent bytes by itself.
+     *
+     * @param budget Most bytes moved.
+     * @return size_t Amount of bytes moved.
+     */
+    size_t service(size_t budget) override;
+
+    /**
+     * @brief Wait until bytes have been received, or the timeout has passed.
+     *
+     * @param timeoutMs Timeout in milliseconds, -1 to wait forever.
+     * @return true Bytes are available to read.
+     * @return false Timed out, or the device is not initialized.
+     */
+    bool waitReadable(int timeoutMs);
+
+    /**
+     * @brief Get the file descriptor of the device, e.g. to add it to an epoll set.
+     *
+     * @return int File descriptor, -1 when the device is not open.
+     */
+    int fileDescriptor() const;
+
+    /**
+     * @brief Write a character using UART.
+     *
+     * Used for interface inheriting between hwlib::istream and hwlib::ostream.
+     *
+     * @param c Character to send.
+     */
+    void putc(char c) override;
+
+    /**
+     * @brief Check if a character is available to read.
+     *
+     * Used for interface inheriting between hwlib::istream and hwlib::ostream.
+     *
+     * @return true
+     * @return false
+     */
+    bool char_available() override;
+
+    /**
+     * @brief Read a character using UART.
+     *
+     * Used for interface inheriting between hwlib::istream and hwlib::ostream.
+     *
+     * @return char
+     */
+    char getc() override;
+
+    /**
+     * @brief Destroy the PosixSerialUARTBase object, closing the device.
+     *
+     */
+    ~PosixSerialUARTBase();
+
+  private:
+    /**
+     * @brief Path of the device, nullptr when constructed from a file descriptor.
+     *
+     */
+    const char *path;
+
+    /**
+     * @brief File descriptor of the device, -1 when not open.
+     *
+     */
+    int fd;
+
+    /**
+     * @brief Data baudrate used for sending and receiving.
+     *
+     */
+    unsigned int baudrate;
+
+    /**
+     * @brief Holds the initialization status of the device.
+     *
+     */
+    bool USARTControllerInitialized;
+
+    /**
+     * @brief UART receive buffer.
+     *
+     */
+    ByteBuffer rxBuffer;
+
+    /**
+     * @brief Applies the overflow policy to the receive buffer.
+     *
+     */
+    OverflowControl rxControl;
+
+    /**
+     * @brief Selected transmit transfer mode.
+     *
+     */
+    TransferMode transmitMode;
+
+    /**
+     * @brief Monotonic time in microseconds at which bytes were last moved from the kernel, used for idle frame boundaries.
+     *
+     */
+    uint64_t lastReceived;
+
+    /**
+     * @brief Move bytes received by the kernel into the receive buffer.
+     *
+     * @param budget Most bytes moved.
+     * @return size_t Amount of bytes moved.
+     */
+    size_t receiveKernel(size_t budget);
+
+    /**
+     * @brief Release the sender, when held off and the receive buffer has been read down to the low watermark.
+     *
+     */
+    void resumeSender();
+
+    /**
+     * @brief Wait until the kernel accepts bytes to send.
+     *
+     * @return true Ready to send.
+     * @return false Not ready to send.
+     */
+    bool txReady() override;
+
+    /**
+     * @brief Send a byte of the serial connection.
+     *
+     * @param b Byte to send.
+     */
+    void sendByte(const uint8_t &b) override;
+
+    /**
+     * @brief Receive a single byte, straight from the kernel.
+     *
+     * @return uint8_t Received byte, 0 if nothing has been received.
+     */
+    uint8_t receiveByte() override;
+};
+
+/**
+ * @brief Storage of the receive buffer of a BufferedPosixSerialUART.
+ *
+ * @tparam RX_BUFFER_SIZE Size of the receive buffer.
+ */
+template <size_t RX_BUFFER_SIZE>
+struct PosixSerialStorage {
+    uint8_t rxStorage[RX_BUFFER_SIZE];
+};
+
+/**
+ * @brief PosixSerialUART with a receive buffer of a chosen capacity.
+ *
+ * @tparam RX_BUFFER_SIZE Size of the receive buffer, a power of two. Holds one byte less.
+ */
+template <size_t RX_BUFFER_SIZE>
+class BufferedPosixSerialUART : private PosixSerialStorage<RX_BUFFER_SIZE>, public PosixSerialUARTBase {
+    typedef PosixSerialStorage<RX_BUFFER_SIZE> Storage;
+
+  public:
+    /**
+     * @brief Construct a new BufferedPosixSerialUART object, opening a device.
+     *
+     * @param path Path of the device, e.g. /dev/ttyUSB0.
+     * @param baudrate Transmit and receive baudrate.
+     * @param initializeController Open the device directly within the object constructor.
+     */
+    BufferedPosixSerialUART(const char *path, unsigned int baudrate, bool initializeController = true)
+        : PosixSerialUARTBase(ByteBuffer(Storage::rxStorage), path, baudrate, initializeController) {
+    }
+
+    /**
+     * @brief Construct a new BufferedPosixSerialUART object, taking ownership of an open device.
+     *
+     * @param fd File descriptor of the device.
+     * @param baudrate Transmit and receive baudrate.
+     * @param initializeController Configure the device directly within the object constructor.
+     */
+    BufferedPosixSerialUART(int fd, unsigned int baudrate, bool initializeController = true)
+        : PosixSerialUARTBase(ByteBuffer(Storage::rxStorage), fd, baudrate, initializeController) {
+    }
+};
+
+/**
+ * @brief PosixSerialUART with a 4096 byte receive buffer.
+ *
+ */
+typedef BufferedPosixSerialUART<4096> PosixSerialUART;
+
+/**
+ * @brief Create a pseudo-terminal pair, two connected ends that behave like a serial line.
+ *
+ * @param first Set to the file descriptor of the controlling end.
+ * @param second Set to the file descriptor of the terminal end.
+ * @return true Created.
+ * @return false Not supported, or out of pseudo-terminals.
+ */
+bool openPseudoTerminal(int &first, int &second);
+
+} // namespace UARTLib
+
+#endif
@@ -3,7 +3,9 @@
  * @brief     FIFO Queue.
  *
  * Queue without using the internal heap.
- * Based on the following code: https://github.com/sdesalas/Arduino-Queue.h/blob/master/Queue.h
+ * Single producer, single consumer: one side may push from an interrupt handler while the other side pops from the main loop
+ * (or the other way around), without disabling interrupts.
+ * Originally based on the following code: https://github.com/sdesalas/Arduino-Queue.h/blob/master/Queue.h
  * @author    Wiebe van Breukelen, Steven de Salas
  * @license   See LICENSE
  */
@@ -13,80 +15,337 @@
 
 #include "wrap-hwlib.hpp"
 
+/**
+ * @brief Selects the smallest unsigned type able to index a queue, as loads and stores of it are atomic on the Cortex-M3.
+ *
+ * @tparam FITS_8_BIT Indices fit in 8 bits.
+ * @tparam FITS_16_BIT Indices fit in 16 bits.
+ */
+template <bool FITS_8_BIT, bool FITS_16_BIT>
+struct QueueIndexType {
+    typedef uint32_t type;
+};
+
+template <bool FITS_16_BIT>
+struct QueueIndexType<true, FITS_16_BIT> {
+    typedef uint8_t type;
+};
+
+template <>
+struct QueueIndexType<false, true> {
+    typedef uint16_t type;
+};
+
+/**
+ * @brief Storage of a Queue, an array of QUEUE_SIZE items held by the queue itself.
+ *
+ * @tparam T Item type.
+ * @tparam QUEUE_SIZE Amount of slots, a power of two.
+ */
 template <class T, size_t QUEUE_SIZE>
-class Queue {
+struct QueueStorage {
+    typedef typename QueueIndexType<QUEUE_SIZE <= 256, QUEUE_SIZE <= 65536>::type index_type;
+
+    T data[QUEUE_SIZE];
+
+    static constexpr size_t size() {
+        return QUEUE_SIZE;
+    }
+};
+
+/**
+ * @brief Storage of a Queue provided by its owner, its size is chosen at runtime.
+ *
+ * This lets code using the queue be compiled once, while the owner decides how much memory it takes.
+ *
+ * @tparam T Item type.
+ */
+template <class T>
+struct QueueStorage<T, 0> {
+    typedef uint32_t index_type;
+
+    T *data;
+    uint32_t length;
+
+    template <size_t SIZE>
+    explicit QueueStorage(T (&storage)[SIZE]) : data(storage), length(SIZE) {
+        static_assert(SIZE >= 2 && (SIZE & (SIZE - 1)) == 0, "Queue size must be a power of two");
+    }
+
+    size_t size() const {
+        return length;
+    }
+};
+
+/**
+ * @brief Front index policy of a Queue, only the consumer advances the front index, using plain stores. Default.
+ *
+ */
+class ExclusiveFront {
+  public:
+    ///< Memory order the consumer reads the front index with, only written by itself.
+    static constexpr int frontOrder = __ATOMIC_RELAXED;
+
+  protected:
+    template <class I>
+    bool advance(I *front, I &, I next) {
+        __atomic_store_n(front, next, __ATOMIC_RELEASE);
+        return true;
+    }
+};
+
+/**
+ * @brief Front index policy of a Queue whose producer may advance the front index as well, to overwrite the oldest item.
+ *
+ * Only while overwriting is allowed, the consumer advances the front index using compare and swap, and reads the items again
+ * when the producer overwrote them in the meantime. Otherwise it uses plain stores, like ExclusiveFront.
+ */
+class OverwritableFront {
+  public:
+    ///< Memory order the consumer reads the front index with, the producer may write it.
+    static constexpr int frontOrder = __ATOMIC_ACQUIRE;
+
+    OverwritableFront() : overwriting(false) {
+    }
+
+    /**
+     * @brief Allow the producer to overwrite the oldest item using pushOverwrite(), consumer side.
+     *
+     * Allow it before the producer starts overwriting, and disallow it only once the producer stopped doing so.
+     *
+     * @param enabled Allow overwriting, disallowed by default.
+     */
+    void setOverwriting(bool enabled) {
+        __atomic_store_n(&overwriting, enabled, __ATOMIC_RELEASE);
+    }
+
+    /**
+     * @brief Check if the producer is allowed to overwrite the oldest item.
+     *
+     * @return true Allowed.
+     * @return false Not allowed, pushOverwrite() drops the new item when full.
+     */
+    bool isOverwriting() const {
+        return overwriting;
+    }
+
+  protected:
+    template <class I>
+    bool advance(I *front, I &expected, I next) {
+        if (!overwriting) {
+            __atomic_store_n(front, next, __ATOMIC_RELEASE);
+            return true;
+        }
+
+        return __atomic_compare_exchange_n(front, &expected, next, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+    }
+
+    template <class I>
+    bool overwrite(I *front, I expected, I next) {
+        return overwriting && __atomic_compare_exchange_n(front, &expected, next, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+    }
+
+  private:
+    volatile bool overwriting;
+};
+
+/**
+ * @brief Lock-free single producer, single consumer FIFO queue.
+ *
+ * Only a head (_back) and tail (_front) index are shared. The producer only writes _back, the consumer only writes _front,
+ * unless the OverwritableFront policy lets the producer overwrite the oldest item. Indices wrap using a mask, so the amount of
+ * slots must be a power of two. One slot is kept free to tell a full queue from an empty one, so the queue holds at most
+ * QUEUE_SIZE - 1 items.
+ *
+ * With a QUEUE_SIZE of 0, the storage is an array provided by the owner of the queue, passed to the constructor.
+ *
+ * @tparam T Item type.
+ * @tparam QUEUE_SIZE Amount of slots, a power of two, or 0 for storage provided by the owner.
+ * @tparam FRONT Front index policy, ExclusiveFront or OverwritableFront.
+ */
+template <class T, size_t QUEUE_SIZE, class FRONT = ExclusiveFront>
+class Queue : public FRONT {
+    static_assert(QUEUE_SIZE == 0 || (QUEUE_SIZE >= 2 && (QUEUE_SIZE & (QUEUE_SIZE - 1)) == 0),
+                  "Queue size must be a power of two");
+
+  public:
+    typedef typename QueueStorage<T, QUEUE_SIZE>::index_type index_type;
+
   private:
-    unsigned int _front, _back, _count;
-    T _data[QUEUE_SIZE];
+    index_type _front, _back;
+    QueueStorage<T, QUEUE_SIZE> _storage;
+
+    inline index_type mask() const {
+        return static_cast<index_type>(_storage.size() - 1);
+    }
 
   public:
-    Queue() {
-        _front = 0;
-        _back = 0;
-        _count = 0;
+    Queue() : _front(0), _back(0) {
+    }
+    template <size_t SIZE>
+    explicit Queue(T (&storage)[SIZE]) : _front(0), _back(0), _storage(storage) {
+    }
+    size_t capacity() const {
+        return _storage.size() - 1;
     }
     inline int count();
     inline int front();
     inline int back();
-    void push(const T &item);
+    bool push(const T &item);
+    bool pushOverwrite(const T &item);
     T peek();
     T pop();
+    size_t pop(T *items, size_t n);
+    size_t peekRegions(const T *&first, size_t &firstLength, const T *&second, size_t &secondLength);
+    void drop(size_t n);
     void clear();
 };
 
-template <class T, size_t QUEUE_SIZE>
-inline int Queue<T, QUEUE_SIZE>::count() {
-    return _count;
+template <class T, size_t QUEUE_SIZE, class FRONT>
+inline int Queue<T, QUEUE_SIZE, FRONT>::count() {
+    index_type back = __atomic_load_n(&_back, __ATOMIC_ACQUIRE);
+    index_type front = __atomic_load_n(&_front, __ATOMIC_ACQUIRE);
+
+    return (back - front) & mask();
 }
 
-template <class T, size_t QUEUE_SIZE>
-inline int Queue<T, QUEUE_SIZE>::front() {
-    return _front;
+template <class T, size_t QUEUE_SIZE, class FRONT>
+inline int Queue<T, QUEUE_SIZE, FRONT>::front() {
+    return __atomic_load_n(&_front, __ATOMIC_RELAXED);
 }
 
-template <class T, size_t QUEUE_SIZE>
-inline int Queue<T, QUEUE_SIZE>::back() {
-    return _back;
+template <class T, size_t QUEUE_SIZE, class FRONT>
+inline int Queue<T, QUEUE_SIZE, FRONT>::back() {
+    return __atomic_load_n(&_back, __ATOMIC_RELAXED);
 }
 
-template <class T, size_t QUEUE_SIZE>
-void Queue<T, QUEUE_SIZE>::push(const T &item) {
-    if (_count < QUEUE_SIZE) { // Drops out when full
-        _data[_back++] = item;
-        ++_count;
-        // Check wrap around
-        if (_back > QUEUE_SIZE)
-            _back -= (QUEUE_SIZE + 1);
+template <class T, size_t QUEUE_SIZE, class FRONT>
+bool Queue<T, QUEUE_SIZE, FRONT>::push(const T &item) {
+    index_type back = __atomic_load_n(&_back, __ATOMIC_RELAXED); // Only written by us
+    index_type next = (back + 1) & mask();
+
+    if (next == __atomic_load_n(&_front, __ATOMIC_ACQUIRE)) {
+        return false; // Drops out when full
     }
+
+    _storage.data[back] = item;
+    // Publish the item before the consumer can see the new index
+    __atomic_store_n(&_back, next, __ATOMIC_RELEASE);
+
+    return true;
 }
 
-template <class T, size_t QUEUE_SIZE>
-T Queue<T, QUEUE_SIZE>::pop() {
-    if (_count <= 0)
-        return T(); // Returns empty
-    else {
-        T result = _data[_front];
-        _front++;
-        --_count;
-        // Check wrap around
-        if (_front > QUEUE_SIZE)
-            _front -= (QUEUE_SIZE + 1);
-        return result;
+template <class T, size_t QUEUE_SIZE, class FRONT>
+bool Queue<T, QUEUE_SIZE, FRONT>::pushOverwrite(const T &item) {
+    index_type back = __atomic_load_n(&_back, __ATOMIC_RELAXED);
+    index_type next = (back + 1) & mask();
+    index_type front = __atomic_load_n(&_front, __ATOMIC_ACQUIRE);
+    bool overwritten = false;
+
+    // Advance the front past the oldest item, unless the consumer made room in the meantime. Requires OverwritableFront.
+    if (next == front) {
+        overwritten = this->overwrite(&_front, front, static_cast<index_type>((front + 1) & mask()));
+
+        if (!overwritten && next == __atomic_load_n(&_front, __ATOMIC_ACQUIRE)) {
+            return false; // Overwriting not allowed, drops out like push()
+        }
     }
+
+    _storage.data[back] = item;
+    __atomic_store_n(&_back, next, __ATOMIC_RELEASE);
+
+    return !overwritten;
 }
 
-template <class T, size_t QUEUE_SIZE>
-T Queue<T, QUEUE_SIZE>::peek() {
-    if (_count <= 0)
+template <class T, size_t QUEUE_SIZE, class FRONT>
+T Queue<T, QUEUE_SIZE, FRONT>::pop() {
+    index_type front = __atomic_load_n(&_front, FRONT::frontOrder);
+
+    do {
+        if (front == __atomic_load_n(&_back, __ATOMIC_ACQUIRE)) {
+            return T(); // Returns empty
+        }
+
+        T result = _storage.data[front];
+
+        // Hand the slot back to the producer only after it has been read. Read again when the producer overwrote it meanwhile.
+        if (this->advance(&_front, front, static_cast<index_type>((front + 1) & mask()))) {
+            return result;
+        }
+    } while (true);
+}
+
+template <class T, size_t QUEUE_SIZE, class FRONT>
+T Queue<T, QUEUE_SIZE, FRONT>::peek() {
+    index_type front = __atomic_load_n(&_front, FRONT::frontOrder);
+
+    if (front == __atomic_load_n(&_back, __ATOMIC_ACQUIRE)) {
         return T(); // Returns empty
-    else
-        return _data[_front];
+    }
+
+    return _storage.data[front];
 }
 
-template <class T, size_t QUEUE_SIZE>
-void Queue<T, QUEUE_SIZE>::clear() {
-    _front = _back;
-    _count = 0;
+template <class T, size_t QUEUE_SIZE, class FRONT>
+size_t Queue<T, QUEUE_SIZE, FRONT>::pop(T *items, size_t n) {
+    index_type front = __atomic_load_n(&_front, FRONT::frontOrder);
+    size_t taken;
+
+    do {
+        size_t available = (__atomic_load_n(&_back, __ATOMIC_ACQUIRE) - front) & mask();
+        taken = n < available ? n : available;
+
+        // The items are contiguous up to the end of the storage, and continue at its start when wrapped around
+        size_t firstLength = _storage.size() - front;
+        if (firstLength > taken) {
+            firstLength = taken;
+        }
+
+        for (size_t i = 0; i < firstLength; i++) {
+            items[i] = _storage.data[front + i];
+        }
+
+        for (size_t i = firstLength; i < taken; i++) {
+            items[i] = _storage.data[i - firstLength];
+        }
+
+        // Copy again when the producer overwrote the oldest items while we copied them
+    } while (taken > 0 && !this->advance(&_front, front, static_cast<index_type>((front + taken) & mask())));
+
+    return taken;
+}
+
+template <class T, size_t QUEUE_SIZE, class FRONT>
+size_t Queue<T, QUEUE_SIZE, FRONT>::peekRegions(const T *&first, size_t &firstLength, const T *&second,
+                                                size_t &secondLength) {
+    // The stored items are contiguous up to the end of the storage, and continue at its start when wrapped around
+    index_type front = __atomic_load_n(&_front, FRONT::frontOrder);
+    size_t available = (__atomic_load_n(&_back, __ATOMIC_ACQUIRE) - front) & mask();
+    size_t untilEnd = _storage.size() - front;
+
+    first = &_storage.data[front];
+    firstLength = available < untilEnd ? available : untilEnd;
+    second = &_storage.data[0];
+    secondLength = available - firstLength;
+
+    return available;
+}
+
+template <class T, size_t QUEUE_SIZE, class FRONT>
+void Queue<T, QUEUE_SIZE, FRONT>::drop(size_t n) {
+    index_type front = __atomic_load_n(&_front, FRONT::frontOrder);
+    size_t taken;
+
+    do {
+        size_t available = (__atomic_load_n(&_back, __ATOMIC_ACQUIRE) - front) & mask();
+        taken = n < available ? n : available;
+    } while (taken > 0 && !this->advance(&_front, front, static_cast<index_type>((front + taken) & mask())));
+}
+
+template <class T, size_t QUEUE_SIZE, class FRONT>
+void Queue<T, QUEUE_SIZE, FRONT>::clear() {
+    // Consumer side operation, drops everything pushed so far
+    drop(capacity());
 }
 
 #endif
@@ -0,0 +1,125 @@
+/**
+ * @file
+ * @brief     RTS (request to send) output driven by the receive buffer level.
+ * @author    Wiebe van Breukelen
+ * @license   See LICENSE
+ */
+
+#ifndef RTS_LINE_HPP
+#define RTS_LINE_HPP
+
+#include "byte_buffer.hpp"
+#include "link_statistics.hpp"
+#include "overflow_policy.hpp"
+#include "wrap-hwlib.hpp"
+
+namespace UARTLib {
+
+/**
+ * @brief Drives an RTS pin from the fill level of a receive buffer.
+ *
+ * The hardware handshaking mode of the USART controllers only drives RTS from the PDC receive buffer. As received bytes go
+ * through the receive buffer of the connection instead, the RTS pin is driven as a PIO output: high holds off the sender once
+ * the buffer reaches the high watermark of the overflow control, low releases it again at the low watermark. RTS is active
+ * low, so the sender is free to send while the pin is low.
+ *
+ * The PIO register block is a template parameter, so the thresholds can be verified against a register model on the host.
+ *
+ * @tparam Registers PIO register block providing the PIO_PER, PIO_OER, PIO_SODR and PIO_CODR registers (e.g. Pio).
+ */
+template <class Registers>
+class RtsLine {
+  public:
+    RtsLine() : pio(nullptr), mask(0) {
+    }
+
+    /**
+     * @brief Take control of the RTS pin, as a PIO output releasing the sender.
+     *
+     * @param registers PIO controller of the pin.
+     * @param pinMask Mask of the pin.
+     */
+    void attach(Registers &registers, uint32_t pinMask) {
+        pio = &registers;
+        mask = pinMask;
+
+        pio->PIO_CODR = mask;
+        pio->PIO_OER = mask;
+        pio->PIO_PER = mask;
+    }
+
+    /**
+     * @brief Stop driving RTS. The pin is left low, releasing the sender.
+     *
+     */
+    void detach() {
+        release();
+        pio = nullptr;
+    }
+
+    /**
+     * @brief Check if an RTS pin is attached.
+     *
+     * @return true Attached.
+     * @return false Not attached, the connection has no hardware flow control.
+     */
+    bool isAttached() const {
+        return pio != nullptr;
+    }
+
+    /**
+     * @brief Hold off the sender, RTS high.
+     *
+     */
+    void hold() {
+        if (pio != nullptr) {
+            pio->PIO_SODR = mask;
+        }
+    }
+
+    /**
+     * @brief Release the sender, RTS low.
+     *
+     */
+    void release() {
+        if (pio != nullptr) {
+            pio->PIO_CODR = mask;
+        }
+    }
+
+    /**
+     * @brief Store a received byte, holding off the sender at the high watermark. Producer side.
+     *
+     * @param control Overflow control of the receive buffer, using the backpressure policy.
+     * @param buffer Receive buffer.
+     * @param b Received byte.
+     * @param stats Statistics counting the byte.
+     * @param frames Frame index accounting for the byte, nullptr for none.
+     */
+    void store(OverflowControl &control, ByteBuffer &buffer, uint8_t b, LinkStatistics &stats, FrameIndex *frames = nullptr) {
+        if (control.store(buffer, b, stats, frames)) {
+            hold();
+        }
+    }
+
+    /**
+     * @brief Release the sender once the receive buffer has been read down to the low watermark. Consumer side.
+     *
+     * @param control Overflow control of the receive buffer.
+     * @param buffer Receive buffer.
+     */
+    void resume(OverflowControl &control, ByteBuffer &buffer) {
+        if (control.resume(buffer)) {
+            release();
+            control.resumed();
+        }
+    }
+
+  private:
+    Registers *pio;
+    uint32_t mask;
+};
+
+} // namespace UARTLib
+
+#endif
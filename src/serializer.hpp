@@ -0,0 +1,509 @@
+/**
+ * @file
+ * @brief     Binary serialization of structs, described by a schema at compile time.
+ * @author    Wiebe van Breukelen
+ * @license   See LICENSE
+ */
+
+#ifndef SERIALIZER_HPP
+#define SERIALIZER_HPP
+
+#include "buffered_output.hpp"
+#include "byte_span.hpp"
+#include "uart_connection.hpp"
+#include "wrap-hwlib.hpp"
+
+namespace UARTLib {
+
+/**
+ * @brief Outcome of decoding a record.
+ *
+ * OK         - Decoded.
+ * INCOMPLETE - More bytes are needed, nothing has been consumed.
+ * MALFORMED  - The bytes do not form a valid record, e.g. a varint that is too long or too many bytes in a Bytes field. The
+ *              bytes examined, up to and including the invalid one, are reported so they can be skipped.
+ */
+enum class DecodeResult { OK, INCOMPLETE, MALFORMED };
+
+/**
+ * @brief Reads bytes from one or two spans, e.g. the readable spans of a receive buffer, without copying them.
+ *
+ */
+class SpanReader {
+  public:
+    /**
+     * @brief Construct a new SpanReader object over two spans, read one after the other.
+     *
+     * @param first First span.
+     * @param second Second span.
+     */
+    SpanReader(const ByteSpan &first, const ByteSpan &second) : first(first), second(second), position(0) {
+    }
+
+    /**
+     * @brief Construct a new SpanReader object over an array.
+     *
+     * @param data Array of bytes.
+     * @param length Length of array.
+     */
+    SpanReader(const uint8_t *data, size_t length) : first{data, length}, second{nullptr, 0}, position(0) {
+    }
+
+    /**
+     * @brief Read the next byte.
+     *
+     * @param b Set to the byte.
+     * @return true Read.
+     * @return false No bytes left.
+     */
+    bool read(uint8_t &b) {
+        if (position < first.length) {
+            b = first.data[position++];
+            return true;
+        }
+
+        if (position - first.length < second.length) {
+            b = second.data[position++ - first.length];
+            return true;
+        }
+
+        return false;
+    }
+
+    /**
+     * @brief Get the amount of bytes read so far.
+     *
+     * @return size_t Amount of bytes read.
+     */
+    size_t consumed() const {
+        return position;
+    }
+
+  private:
+    ByteSpan first;
+    ByteSpan second;
+    size_t position;
+};
+
+/**
+ * @brief Unsigned integer of a given size.
+ *
+ * @tparam SIZE Size in bytes.
+ */
+template <size_t SIZE>
+struct UnsignedOfSize;
+
+template <>
+struct UnsignedOfSize<1> {
+    typedef uint8_t type;
+};
+
+template <>
+struct UnsignedOfSize<2> {
+    typedef uint16_t type;
+};
+
+template <>
+struct UnsignedOfSize<4> {
+    typedef uint32_t type;
+};
+
+template <>
+struct UnsignedOfSize<8> {
+    typedef uint64_t type;
+};
+
+/**
+ * @brief Converts a field value to and from the unsigned integer holding its bits.
+ *
+ * @tparam T Integer, enumeration or floating point type.
+ */
+template <class T>
+struct FieldBits {
+    typedef typename UnsignedOfSize<sizeof(T)>::type Bits;
+
+    static Bits toBits(T value) {
+        return static_cast<Bits>(value);
+    }
+
+    static T fromBits(Bits bits) {
+        return static_cast<T>(bits);
+    }
+};
+
+template <>
+struct FieldBits<float> {
+    typedef uint32_t Bits;
+
+    static Bits toBits(float value) {
+        Bits bits;
+        __builtin_memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    static float fromBits(Bits bits) {
+        float value;
+        __builtin_memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+};
+
+template <>
+struct FieldBits<double> {
+    typedef uint64_t Bits;
+
+    static Bits toBits(double value) {
+        Bits bits;
+        __builtin_memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    static double fromBits(Bits bits) {
+        double value;
+        __builtin_memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+};
+
+/**
+ * @brief Schema field stored as a fixed size little-endian value.
+ *
+ * @tparam S Record type.
+ * @tparam T Field type, an integer, enumeration, float or double.
+ * @tparam MEMBER Field of the record.
+ */
+template <class S, class T, T S::*MEMBER>
+struct LittleEndian {
+    typedef typename FieldBits<T>::Bits Bits;
+
+    static constexpr size_t maxLength = sizeof(T);
+
+    static void encode(const S &record, uint8_t *&out) {
+        Bits bits = FieldBits<T>::toBits(record.*MEMBER);
+        for (size_t i = 0; i < sizeof(Bits); i++) {
+            *out++ = static_cast<uint8_t>(bits >> (8 * i));
+        }
+    }
+
+    static DecodeResult decode(S &record, SpanReader &reader) {
+        Bits bits = 0;
+        for (size_t i = 0; i < sizeof(Bits); i++) {
+            uint8_t b;
+            if (!reader.read(b)) {
+                return DecodeResult::INCOMPLETE;
+            }
+
+            bits = static_cast<Bits>(bits | (static_cast<Bits>(b) << (8 * i)));
+        }
+
+        record.*MEMBER = FieldBits<T>::fromBits(bits);
+
+        return DecodeResult::OK;
+    }
+};
+
+/**
+ * @brief Schema field stored as a varint (LEB128), taking fewer bytes for small values.
+ *
+ * Seven bits are stored per byte, least significant first, the top bit tells if more bytes follow. Signed values are zigzag
+ * encoded first (0, -1, 1, -2 becomes 0, 1, 2, 3), so small negative values stay small too.
+ *
+ * @tparam S Record type.
+ * @tparam T Field type, an integer.
+ * @tparam MEMBER Field of the record.
+ */
+template <class S, class T, T S::*MEMBER>
+struct Varint {
+    typedef typename UnsignedOfSize<sizeof(T)>::type Bits;
+
+    static constexpr bool isSigned = T(-1) < T(0);
+    static constexpr size_t maxLength = (sizeof(T) * 8 + 6) / 7;
+
+    static void encode(const S &record, uint8_t *&out) {
+        T value = record.*MEMBER;
+        Bits bits = isSigned ? static_cast<Bits>((static_cast<Bits>(value) << 1) ^ static_cast<Bits>(value < 0 ? ~Bits(0) : 0))
+                             : static_cast<Bits>(value);
+
+        while (bits >= 0x80) {
+            *out++ = static_cast<uint8_t>(bits | 0x80);
+            bits = static_cast<Bits>(bits >> 7);
+        }
+
+        *out++ = static_cast<uint8_t>(bits);
+    }
+
+    static DecodeResult decode(S &record, SpanReader &reader) {
+        Bits bits = 0;
+
+        for (size_t i = 0; i < maxLength; i++) {
+            uint8_t b;
+            if (!reader.read(b)) {
+                return DecodeResult::INCOMPLETE;
+            }
+
+            bits = static_cast<Bits>(bits | (static_cast<Bits>(b & 0x7F) << (7 * i)));
+
+            if ((b & 0x80) == 0) {
+                record.*MEMBER = isSigned ? static_cast<T>((bits >> 1) ^ (Bits(0) - (bits & 1))) : static_cast<T>(bits);
+                return DecodeResult::OK;
+            }
+        }
+
+        return DecodeResult::MALFORMED;
+    }
+};
+
+/**
+ * @brief Schema field holding a variable amount of bytes, stored as a varint length followed by the bytes.
+ *
+ * @tparam S Record type.
+ * @tparam N Capacity of the field.
+ * @tparam DATA Array field of the record holding the bytes.
+ * @tparam LENGTH Field of the record holding the amount of bytes used, at most N.
+ */
+template <class S, size_t N, uint8_t (S::*DATA)[N], size_t S::*LENGTH>
+struct Bytes {
+    static constexpr size_t maxLength = (sizeof(size_t) * 8 + 6) / 7 + N;
+
+    static void encode(const S &record, uint8_t *&out) {
+        size_t length = record.*LENGTH < N ? record.*LENGTH : N;
+
+        size_t remaining = length;
+        while (remaining >= 0x80) {
+            *out++ = static_cast<uint8_t>(remaining | 0x80);
+            remaining >>= 7;
+        }
+        *out++ = static_cast<uint8_t>(remaining);
+
+        const uint8_t *data = record.*DATA;
+        for (size_t i = 0; i < length; i++) {
+            *out++ = data[i];
+        }
+    }
+
+    static DecodeResult decode(S &record, SpanReader &reader) {
+        size_t length = 0;
+        uint8_t b = 0x80;
+
+        for (size_t shift = 0; (b & 0x80) != 0; shift += 7) {
+            if (shift >= sizeof(size_t) * 8) {
+                return DecodeResult::MALFORMED;
+            }
+
+            if (!reader.read(b)) {
+                return DecodeResult::INCOMPLETE;
+            }
+
+            length |= static_cast<size_t>(b & 0x7F) << shift;
+        }
+
+        if (length > N) {
+            return DecodeResult::MALFORMED;
+        }
+
+        uint8_t *data = record.*DATA;
+        for (size_t i = 0; i < length; i++) {
+            if (!reader.read(data[i])) {
+                return DecodeResult::INCOMPLETE;
+            }
+        }
+
+        record.*LENGTH = length;
+
+        return DecodeResult::OK;
+    }
+};
+
+/**
+ * @brief List of schema fields, encoded one after the other.
+ *
+ * @tparam S Record type.
+ * @tparam FIELDS Fields.
+ */
+template <class S, class... FIELDS>
+struct FieldList;
+
+template <class S>
+struct FieldList<S> {
+    static constexpr size_t maxLength = 0;
+
+    static void encode(const S &, uint8_t *&) {
+    }
+
+    static DecodeResult decode(S &, SpanReader &) {
+        return DecodeResult::OK;
+    }
+};
+
+template <class S, class FIELD, class... FIELDS>
+struct FieldList<S, FIELD, FIELDS...> {
+    static constexpr size_t maxLength = FIELD::maxLength + FieldList<S, FIELDS...>::maxLength;
+
+    static void encode(const S &record, uint8_t *&out) {
+        FIELD::encode(record, out);
+        FieldList<S, FIELDS...>::encode(record, out);
+    }
+
+    static DecodeResult decode(S &record, SpanReader &reader) {
+        DecodeResult result = FIELD::decode(record, reader);
+        if (result != DecodeResult::OK) {
+            return result;
+        }
+
+        return FieldList<S, FIELDS...>::decode(record, reader);
+    }
+};
+
+/**
+ * @brief Binary encoding of a record, described by a list of fields at compile time.
+ *
+ * Records are encoded straight into the staging buffer of a BufferedOutput, and decoded straight out of the receive buffer of
+ * a connection, without copies in between. For example:
+ *
+ *     struct Sample {
+ *         uint16_t id;
+ *         int32_t temperature;
+ *         float humidity;
+ *     };
+ *
+ *     typedef UARTLib::Schema<Sample, UARTLib::LittleEndian<Sample, uint16_t, &Sample::id>,
+ *                             UARTLib::Varint<Sample, int32_t, &Sample::temperature>,
+ *                             UARTLib::LittleEndian<Sample, float, &Sample::humidity>> SampleSchema;
+ *
+ *     SampleSchema::send(out, sample);
+ *
+ * Records carry no framing. After a malformed record the stream cannot be resynchronized, so on noisy lines encode records
+ * into COBS or SLIP frames instead, and decode them from the received frame.
+ *
+ * @tparam S Record type.
+ * @tparam FIELDS Fields, LittleEndian, Varint or Bytes.
+ */
+template <class S, class... FIELDS>
+class Schema {
+    typedef FieldList<S, FIELDS...> Fields;
+
+  public:
+    /**
+     * @brief Largest size of an encoded record.
+     *
+     */
+    static constexpr size_t maxEncodedLength = Fields::maxLength;
+
+    /**
+     * @brief Encode a record into an array.
+     *
+     * @param record Record.
+     * @param out Array of at least maxEncodedLength bytes.
+     * @return size_t Length of the encoded record.
+     */
+    static size_t encode(const S &record, uint8_t *out) {
+        uint8_t *p = out;
+        Fields::encode(record, p);
+
+        return p - out;
+    }
+
+    /**
+     * @brief Decode a record from an array.
+     *
+     * @param record Record to decode into. Fields may have been changed, unless OK is returned.
+     * @param data Array of bytes.
+     * @param length Length of array.
+     * @param used Set to the length of the encoded record when OK is returned, to the amount of bytes examined when MALFORMED
+     * is returned.
+     * @return DecodeResult Outcome.
+     */
+    static DecodeResult decode(S &record, const uint8_t *data, size_t length, size_t &used) {
+        SpanReader reader(data, length);
+
+        return decode(record, reader, used);
+    }
+
+    /**
+     * @brief Decode a record from a reader.
+     *
+     * @param record Record to decode into. Fields may have been changed, unless OK is returned.
+     * @param reader Reader.
+     * @param used Set to the length of the encoded record when OK is returned, to the amount of bytes examined when MALFORMED
+     * is returned.
+     * @return DecodeResult Outcome.
+     */
+    static DecodeResult decode(S &record, SpanReader &reader, size_t &used) {
+        size_t start = reader.consumed();
+
+        DecodeResult result = Fields::decode(record, reader);
+        used = reader.consumed() - start;
+
+        return result;
+    }
+
+    /**
+     * @brief Encode a record straight into the staging buffer of a buffered output stream.
+     *
+     * @param out Buffered output stream, with a staging buffer of at least twice maxEncodedLength.
+     * @param record Record.
+     * @return true Record staged, sent along with the rest of the staging buffer.
+     * @return false The staging buffer is too small, or still full as the connection did not take the staged characters.
+     */
+    static bool send(BufferedOutputBase &out, const S &record) {
+        uint8_t *p = out.reserve(maxEncodedLength);
+        if (p == nullptr) {
+            return false;
+        }
+
+        out.commit(encode(record, p));
+
+        return true;
+    }
+
+    /**
+     * @brief Decode a record straight out of the receive buffer of a connection.
+     *
+     * The record is only removed from the receive buffer when OK is returned. The receive buffer must be able to hold
+     * maxEncodedLength bytes.
+     *
+     * When MALFORMED is returned, the bytes examined are removed, up to and including the invalid one, so the next call
+     * continues after them. The byte stream does not mark where records start, so the bytes following them may not start a
+     * record either, and decode as garbage. To resync reliably, send each record in a frame (e.g. sendCobsFrame() or a frame
+     * boundary set using setFrameBoundary()), and discard the rest of the frame holding a malformed record.
+     *
+     * @param connection Connection to receive from.
+     * @param record Record to decode into. Fields may have been changed, unless OK is returned.
+     * @return DecodeResult Outcome.
+     */
+    static DecodeResult receive(UARTConnection &connection, S &record) {
+        ///< In polling mode, this moves received bytes into the receive buffer.
+        connection.available();
+
+        ByteSpan first;
+        ByteSpan second;
+        connection.readableSpans(first, second);
+
+        SpanReader reader(first, second);
+        size_t used = 0;
+        DecodeResult result = decode(record, reader, used);
+
+        ///< Skip a malformed record, retrying would find the same invalid byte again.
+        if (result != DecodeResult::INCOMPLETE) {
+            connection.consume(used);
+        }
+
+        return result;
+    }
+};
+
+template <class S, class T, T S::*MEMBER>
+constexpr size_t LittleEndian<S, T, MEMBER>::maxLength;
+
+template <class S, class T, T S::*MEMBER>
+constexpr size_t Varint<S, T, MEMBER>::maxLength;
+
+template <class S, size_t N, uint8_t (S::*DATA)[N], size_t S::*LENGTH>
+constexpr size_t Bytes<S, N, DATA, LENGTH>::maxLength;
+
+template <class S, class... FIELDS>
+constexpr size_t Schema<S, FIELDS...>::maxEncodedLength;
+
+} // namespace UARTLib
+
+#endif
@@ -0,0 +1,699 @@
+#include "simulated_sam3x.hpp"
+#include "overflow_policy.hpp"
+
+///< Interrupt vectors, defined by the driver (hardware_uart.cpp).
+extern "C" void USART0_Handler();
+extern "C" void USART1_Handler();
+extern "C" void USART3_Handler();
+
+Pmc simulatedPMC;
+Pio simulatedPIOA;
+Pio simulatedPIOB;
+Pio simulatedPIOD;
+
+///< RTS0 and RTS1 are PB25 and PA14. RTS3 is on PIOF, which the Arduino Due does not have.
+Usart simulatedUSART0(ID_USART0, USART0_Handler, &simulatedPIOB, PIO_PB25);
+Usart simulatedUSART1(ID_USART1, USART1_Handler, &simulatedPIOA, PIO_PA14);
+Usart simulatedUSART3(ID_USART3, USART3_Handler, nullptr, 0);
+
+void NVIC_EnableIRQ(IRQn_Type line) {
+    UARTLib::SimulatedSam3x::enableInterrupt(line);
+}
+
+void NVIC_DisableIRQ(IRQn_Type line) {
+    UARTLib::SimulatedSam3x::disableInterrupt(line);
+}
+
+namespace {
+
+Usart *const usarts[] = {&simulatedUSART0, &simulatedUSART1, &simulatedUSART3};
+
+///< Register offsets, in the order of the register map.
+enum UsartRegister : unsigned int { CR, MR, IER, IDR, IMR, CSR, RHR, THR, BRGR, RTOR, TTGR, RPR, RCR, TPR, TCR, RNPR, RNCR, TNPR,
+                                   TNCR, PTCR, PTSR };
+
+enum PioRegister : unsigned int { PER, PDR, PSR, OER, ODR, OSR, SODR, CODR, ODSR, PDSR, ABSR };
+
+enum PmcRegister : unsigned int { PCER0, PCDR0, PCSR0 };
+
+///< PDC counters are 16 bits wide.
+constexpr uintptr_t counterMask = 0xFFFF;
+
+} // namespace
+
+namespace UARTLib {
+
+uint64_t SimulatedSam3x::time = 0;
+uint32_t SimulatedSam3x::enabledInterrupts = 0;
+uint32_t SimulatedSam3x::accessCycles = 8;
+uint32_t SimulatedSam3x::interruptCycles = 24;
+bool SimulatedSam3x::inHandler = false;
+
+void SimulatedSam3x::reset() {
+    time = 0;
+    enabledInterrupts = 0;
+    accessCycles = 8;
+    interruptCycles = 24;
+    inHandler = false;
+
+    simulatedPMC.reset();
+    simulatedPIOA.reset();
+    simulatedPIOB.reset();
+    simulatedPIOD.reset();
+
+    for (Usart *usart : usarts) {
+        usart->reset();
+    }
+}
+
+uint64_t SimulatedSam3x::now() {
+    return time;
+}
+
+void SimulatedSam3x::run(uint64_t cycles) {
+    uint64_t target = time + cycles;
+
+    while (time < target) {
+        takeInterrupts();
+
+        ///< Skip ahead to the next event, unless an interrupt stays pending: then idle like a program spinning in a loop.
+        bool pending = false;
+        uint64_t next = target;
+        for (Usart *usart : usarts) {
+            pending = pending || (((enabledInterrupts >> usart->identifier()) & 1) != 0 && usart->interruptPending());
+
+            uint64_t event = usart->nextEvent();
+            next = event < next ? event : next;
+        }
+
+        if (pending) {
+            next = time + (accessCycles > 0 ? accessCycles : 1);
+            next = next < target ? next : target;
+        }
+
+        advanceTo(next);
+    }
+
+    takeInterrupts();
+}
+
+void SimulatedSam3x::setAccessCycles(uint32_t cycles) {
+    accessCycles = cycles;
+}
+
+void SimulatedSam3x::setInterruptCycles(uint32_t cycles) {
+    interruptCycles = cycles;
+}
+
+void SimulatedSam3x::enableInterrupt(uint32_t line) {
+    enabledInterrupts |= 1u << line;
+}
+
+void SimulatedSam3x::disableInterrupt(uint32_t line) {
+    enabledInterrupts &= ~(1u << line);
+}
+
+void SimulatedSam3x::access() {
+    advanceTo(time + accessCycles);
+    takeInterrupts();
+}
+
+void SimulatedSam3x::advanceTo(uint64_t target) {
+    for (;;) {
+        uint64_t next = Usart::noEvent;
+        for (Usart *usart : usarts) {
+            uint64_t event = usart->nextEvent();
+            next = event < next ? event : next;
+        }
+
+        if (next > target) {
+            break;
+        }
+
+        time = next;
+        for (Usart *usart : usarts) {
+            usart->handleEvents();
+        }
+    }
+
+    time = target;
+}
+
+void SimulatedSam3x::takeInterrupts() {
+    if (inHandler) {
+        return;
+    }
+
+    for (Usart *usart : usarts) {
+        if (((enabledInterrupts >> usart->identifier()) & 1) != 0 && usart->interruptPending()) {
+            inHandler = true;
+            advanceTo(time + interruptCycles);
+            usart->interrupt();
+            inHandler = false;
+        }
+    }
+}
+
+} // namespace UARTLib
+
+using UARTLib::SimulatedSam3x;
+
+Pio::Pio()
+    : PIO_PER(*this, PER), PIO_PDR(*this, PDR), PIO_PSR(*this, PSR), PIO_OER(*this, OER), PIO_ODR(*this, ODR),
+      PIO_OSR(*this, OSR), PIO_SODR(*this, SODR), PIO_CODR(*this, CODR), PIO_ODSR(*this, ODSR), PIO_PDSR(*this, PDSR),
+      PIO_ABSR(*this, ABSR) {
+    reset();
+}
+
+bool Pio::drivenHigh(uint32_t mask) const {
+    return (status & outputs & outputData & mask) == mask;
+}
+
+bool Pio::routedTo(uint32_t mask, bool peripheralB) const {
+    return (status & mask) == 0 && (peripheralAB & mask) == (peripheralB ? mask : 0);
+}
+
+void Pio::reset() {
+    status = 0xFFFFFFFF;
+    outputs = 0;
+    outputData = 0;
+    peripheralAB = 0;
+}
+
+uintptr_t Pio::readRegister(unsigned int index) {
+    SimulatedSam3x::access();
+
+    switch (index) {
+    case PSR:
+        return status;
+    case OSR:
+        return outputs;
+    case ODSR:
+    case PDSR:
+        ///< Nothing drives the inputs, pins read back what is driven on them.
+        return outputData;
+    case ABSR:
+        return peripheralAB;
+    default:
+        ///< Write only.
+        return 0;
+    }
+}
+
+void Pio::writeRegister(unsigned int index, uintptr_t value) {
+    SimulatedSam3x::access();
+
+    uint32_t mask = static_cast<uint32_t>(value);
+
+    switch (index) {
+    case PER:
+        status |= mask;
+        break;
+    case PDR:
+        status &= ~mask;
+        break;
+    case OER:
+        outputs |= mask;
+        break;
+    case ODR:
+        outputs &= ~mask;
+        break;
+    case SODR:
+        outputData |= mask;
+        break;
+    case CODR:
+        outputData &= ~mask;
+        break;
+    case ODSR:
+        outputData = mask;
+        break;
+    case ABSR:
+        peripheralAB = mask;
+        break;
+    default:
+        ///< Read only.
+        break;
+    }
+}
+
+Pmc::Pmc() : PMC_PCER0(*this, PCER0), PMC_PCDR0(*this, PCDR0), PMC_PCSR0(*this, PCSR0) {
+    reset();
+}
+
+bool Pmc::clockEnabled(uint32_t id) const {
+    return ((enabled >> id) & 1) != 0;
+}
+
+void Pmc::reset() {
+    enabled = 0;
+}
+
+uintptr_t Pmc::readRegister(unsigned int index) {
+    SimulatedSam3x::access();
+
+    return index == PCSR0 ? enabled : 0;
+}
+
+void Pmc::writeRegister(unsigned int index, uintptr_t value) {
+    SimulatedSam3x::access();
+
+    if (index == PCER0) {
+        enabled |= static_cast<uint32_t>(value);
+    } else if (index == PCDR0) {
+        enabled &= ~static_cast<uint32_t>(value);
+    }
+}
+
+constexpr uint64_t Usart::noEvent;
+
+Usart::Usart(uint32_t id, void (*handler)(), Pio *rtsPio, uint32_t rtsMask)
+    : US_CR(*this, CR), US_MR(*this, MR), US_IER(*this, IER), US_IDR(*this, IDR), US_IMR(*this, IMR), US_CSR(*this, CSR),
+      US_RHR(*this, RHR), US_THR(*this, THR), US_BRGR(*this, BRGR), US_RTOR(*this, RTOR), US_TTGR(*this, TTGR),
+      US_RPR(*this, RPR), US_RCR(*this, RCR), US_TPR(*this, TPR), US_TCR(*this, TCR), US_RNPR(*this, RNPR),
+      US_RNCR(*this, RNCR), US_TNPR(*this, TNPR), US_TNCR(*this, TNCR), US_PTCR(*this, PTCR), US_PTSR(*this, PTSR), id(id),
+      handler(handler), rtsPio(rtsPio), rtsMask(rtsMask) {
+    reset();
+}
+
+size_t Usart::receiveFromLine(const uint8_t *data, size_t length) {
+    size_t queued = 0;
+    while (queued < length && lineInput.push(data[queued])) {
+        queued++;
+    }
+
+    return queued;
+}
+
+size_t Usart::takeTransmitted(uint8_t *buf, size_t n) {
+    return lineOutput.pop(buf, n);
+}
+
+size_t Usart::transmittedCount() {
+    return lineOutput.count();
+}
+
+void Usart::connect(Usart *peer) {
+    this->peer = peer;
+}
+
+void Usart::setSoftwareFlowControl(bool enabled) {
+    softwareFlowControl = enabled;
+    xoffReceived = false;
+}
+
+uint64_t Usart::characterCycles() const {
+    uint32_t dataBits = 5 + ((mode & US_MR_CHRL_Msk) >> US_MR_CHRL_Pos);
+    uint32_t parity = (mode & US_MR_PAR_Msk) >> US_MR_PAR_Pos;
+    uint32_t parityBits = (parity == 4 || parity == 5) ? 0 : 1;
+    uint32_t stopHalfBits = 2 + ((mode & US_MR_NBSTOP_Msk) >> US_MR_NBSTOP_Pos);
+
+    ///< Start bit, data bits, parity bit and stop bits, counted in half bits.
+    uint64_t halfBits = 2 * (1 + dataBits + parityBits) + stopHalfBits;
+
+    return halfBits * bitCycles() / 2;
+}
+
+uint32_t Usart::charactersTransmitted() const {
+    return transmittedTotal;
+}
+
+uint32_t Usart::charactersOverrun() const {
+    return overrunTotal;
+}
+
+void Usart::reset() {
+    peer = nullptr;
+    softwareFlowControl = false;
+
+    mode = 0;
+    baudRateGenerator = 0;
+    receiverTimeout = 0;
+    interruptMask = 0;
+
+    transmitterEnabled = false;
+    holdingFull = false;
+    holding = 0;
+    shifting = false;
+    shifted = 0;
+    shiftDone = noEvent;
+
+    receiverEnabled = false;
+    receiveReady = false;
+    received = 0;
+    overrun = false;
+    timeout = false;
+    timeoutArmed = false;
+    timeoutAt = noEvent;
+
+    rpr = rcr = rnpr = rncr = tpr = tcr = tnpr = tncr = 0;
+    receiveTransferEnabled = false;
+    transmitTransferEnabled = false;
+    endOfReceive = false;
+    endOfTransmit = false;
+
+    lineInput.clear();
+    lineOutput.clear();
+    arrival = noEvent;
+    xoffReceived = false;
+
+    transmittedTotal = 0;
+    overrunTotal = 0;
+}
+
+uintptr_t Usart::readRegister(unsigned int index) {
+    SimulatedSam3x::access();
+
+    if (!clocked()) {
+        return 0;
+    }
+
+    switch (index) {
+    case MR:
+        return mode;
+    case IMR:
+        return interruptMask;
+    case CSR:
+        return status();
+    case RHR:
+        receiveReady = false;
+        return received;
+    case BRGR:
+        return baudRateGenerator;
+    case RTOR:
+        return receiverTimeout;
+    case RPR:
+        return rpr;
+    case RCR:
+        return rcr;
+    case TPR:
+        return tpr;
+    case TCR:
+        return tcr;
+    case RNPR:
+        return rnpr;
+    case RNCR:
+        return rncr;
+    case TNPR:
+        return tnpr;
+    case TNCR:
+        return tncr;
+    case PTSR:
+        return (receiveTransferEnabled ? US_PTSR_RXTEN : 0) | (transmitTransferEnabled ? US_PTSR_TXTEN : 0);
+    default:
+        ///< Write only.
+        return 0;
+    }
+}
+
+void Usart::writeRegister(unsigned int index, uintptr_t value) {
+    SimulatedSam3x::access();
+
+    if (!clocked()) {
+        return;
+    }
+
+    uint32_t bits = static_cast<uint32_t>(value);
+
+    switch (index) {
+    case CR:
+        control(bits);
+        break;
+    case MR:
+        mode = bits;
+        break;
+    case IER:
+        interruptMask |= bits;
+        break;
+    case IDR:
+        interruptMask &= ~bits;
+        break;
+    case THR:
+        write(static_cast<uint8_t>(bits));
+        break;
+    case BRGR:
+        baudRateGenerator = bits & (US_BRGR_CD_Msk | US_BRGR_FP_Msk);
+        break;
+    case RTOR:
+        receiverTimeout = bits & US_RTOR_TO_Msk;
+        break;
+    case RPR:
+        rpr = value;
+        break;
+    case RCR:
+        rcr = value & counterMask;
+        endOfReceive = false;
+        break;
+    case TPR:
+        tpr = value;
+        break;
+    case TCR:
+        tcr = value & counterMask;
+        endOfTransmit = false;
+        break;
+    case RNPR:
+        rnpr = value;
+        break;
+    case RNCR:
+        rncr = value & counterMask;
+        endOfReceive = false;
+        break;
+    case TNPR:
+        tnpr = value;
+        break;
+    case TNCR:
+        tncr = value & counterMask;
+        endOfTransmit = false;
+        break;
+    case PTCR:
+        receiveTransferEnabled = (receiveTransferEnabled || (bits & US_PTCR_RXTEN) != 0) && (bits & US_PTCR_RXTDIS) == 0;
+        transmitTransferEnabled = (transmitTransferEnabled || (bits & US_PTCR_TXTEN) != 0) && (bits & US_PTCR_TXTDIS) == 0;
+        break;
+    default:
+        ///< Read only, or not modelled (US_TTGR).
+        break;
+    }
+
+    ///< A counter written, or the channel or transmitter enabled, may start a transfer.
+    transmitFromPdc();
+}
+
+uint64_t Usart::nextEvent() {
+    scheduleArrival();
+
+    uint64_t next = shifting ? shiftDone : noEvent;
+    next = arrival < next ? arrival : next;
+
+    return timeoutAt < next ? timeoutAt : next;
+}
+
+void Usart::handleEvents() {
+    uint64_t now = SimulatedSam3x::now();
+
+    if (shifting && shiftDone <= now) {
+        characterTransmitted();
+    }
+
+    if (arrival <= now) {
+        arrival = noEvent;
+
+        uint8_t b = lineInput.pop();
+        characterReceived(b);
+    }
+
+    if (timeoutAt <= now) {
+        timeoutAt = noEvent;
+        timeout = true;
+    }
+}
+
+bool Usart::interruptPending() {
+    return clocked() && (status() & interruptMask) != 0;
+}
+
+void Usart::interrupt() {
+    handler();
+}
+
+uint32_t Usart::identifier() const {
+    return id;
+}
+
+bool Usart::clocked() const {
+    return simulatedPMC.clockEnabled(id);
+}
+
+uint32_t Usart::status() {
+    uint32_t result = 0;
+
+    result |= receiveReady ? US_CSR_RXRDY : 0;
+    result |= (transmitterEnabled && !holdingFull) ? US_CSR_TXRDY : 0;
+    result |= endOfReceive ? US_CSR_ENDRX : 0;
+    result |= endOfTransmit ? US_CSR_ENDTX : 0;
+    result |= overrun ? US_CSR_OVRE : 0;
+    result |= timeout ? US_CSR_TIMEOUT : 0;
+    result |= (transmitterEnabled && !holdingFull && !shifting) ? US_CSR_TXEMPTY : 0;
+    result |= (tcr == 0 && tncr == 0) ? US_CSR_TXBUFE : 0;
+    result |= (rcr == 0 && rncr == 0) ? US_CSR_RXBUFF : 0;
+
+    return result;
+}
+
+uint64_t Usart::bitCycles() const {
+    uint32_t divider = baudRateGenerator & US_BRGR_CD_Msk;
+    uint32_t fraction = (baudRateGenerator & US_BRGR_FP_Msk) >> US_BRGR_FP_Pos;
+    uint32_t oversampling = (mode & US_MR_OVER) != 0 ? 8 : 16;
+
+    ///< The divider has a fractional part in eighths, see section 35.7.1 of the SAM3X datasheet.
+    return oversampling * (8 * static_cast<uint64_t>(divider) + fraction) / 8;
+}
+
+void Usart::control(uint32_t command) {
+    if ((command & US_CR_RSTRX) != 0) {
+        receiveReady = false;
+    }
+
+    if ((command & US_CR_RSTTX) != 0) {
+        holdingFull = false;
+        shifting = false;
+    }
+
+    ///< Disabling takes precedence over enabling.
+    receiverEnabled = (receiverEnabled || (command & US_CR_RXEN) != 0) && (command & US_CR_RXDIS) == 0;
+    transmitterEnabled = (transmitterEnabled || (command & US_CR_TXEN) != 0) && (command & US_CR_TXDIS) == 0;
+
+    if ((command & US_CR_RSTSTA) != 0) {
+        overrun = false;
+    }
+
+    ///< STTTO waits for the next character before counting, RETTO counts right away.
+    if ((command & US_CR_STTTO) != 0) {
+        timeout = false;
+        timeoutArmed = true;
+        timeoutAt = noEvent;
+    }
+
+    if ((command & US_CR_RETTO) != 0 && receiverTimeout != 0 && bitCycles() > 0) {
+        timeout = false;
+        timeoutAt = SimulatedSam3x::now() + receiverTimeout * bitCycles();
+    }
+
+    startShifting();
+}
+
+void Usart::write(uint8_t b) {
+    if (!transmitterEnabled) {
+        return;
+    }
+
+    ///< Writing while TXRDY is low replaces the character waiting in US_THR.
+    holding = b;
+    holdingFull = true;
+
+    startShifting();
+}
+
+void Usart::startShifting() {
+    uint64_t cycles = characterCycles();
+
+    if (shifting || !holdingFull || !transmitterEnabled || cycles == 0) {
+        return;
+    }
+
+    shifted = holding;
+    holdingFull = false;
+    shifting = true;
+    shiftDone = SimulatedSam3x::now() + cycles;
+}
+
+void Usart::transmitFromPdc() {
+    while (transmitTransferEnabled && transmitterEnabled && !holdingFull) {
+        if (tcr == 0 && tncr != 0) {
+            tpr = tnpr;
+            tcr = tncr;
+            tncr = 0;
+        }
+
+        if (tcr == 0) {
+            return;
+        }
+
+        write(*reinterpret_cast<const uint8_t *>(tpr++));
+
+        if (--tcr == 0) {
+            endOfTransmit = true;
+        }
+    }
+}
+
+void Usart::characterTransmitted() {
+    shifting = false;
+    transmittedTotal++;
+
+    if (peer != nullptr) {
+        peer->characterReceived(shifted);
+    } else {
+        lineOutput.push(shifted);
+    }
+
+    if (softwareFlowControl && (shifted == UARTLib::XOFF || shifted == UARTLib::XON)) {
+        xoffReceived = shifted == UARTLib::XOFF;
+    }
+
+    startShifting();
+    transmitFromPdc();
+}
+
+void Usart::characterReceived(uint8_t b) {
+    if (!receiverEnabled) {
+        return;
+    }
+
+    ///< The new character replaces the one not read yet.
+    if (receiveReady) {
+        overrun = true;
+        overrunTotal++;
+    }
+
+    received = b;
+    receiveReady = true;
+
+    if (receiveTransferEnabled) {
+        if (rcr == 0 && rncr != 0) {
+            rpr = rnpr;
+            rcr = rncr;
+            rncr = 0;
+        }
+
+        ///< The PDC takes the character from US_RHR right away, unless it has nowhere to put it.
+        if (rcr != 0) {
+            *reinterpret_cast<uint8_t *>(rpr++) = b;
+            receiveReady = false;
+
+            if (--rcr == 0) {
+                endOfReceive = true;
+                rpr = rnpr;
+                rcr = rncr;
+                rncr = 0;
+            }
+        }
+    }
+
+    ///< Every character restarts the receiver timeout, once started.
+    if (receiverTimeout != 0 && (timeoutArmed || timeoutAt != noEvent)) {
+        timeoutArmed = false;
+        timeoutAt = SimulatedSam3x::now() + receiverTimeout * bitCycles();
+    }
+}
+
+bool Usart::senderPaused() {
+    return (rtsPio != nullptr && rtsPio->drivenHigh(rtsMask)) || (softwareFlowControl && xoffReceived);
+}
+
+void Usart::scheduleArrival() {
+    uint64_t cycles = characterCycles();
+
+    ///< The remote sender sends the next character when it is not held off, back to back with the previous one.
+    if (arrival == noEvent && lineInput.count() > 0 && cycles > 0 && !senderPaused()) {
+        arrival = SimulatedSam3x::now() + cycles;
+    }
+}
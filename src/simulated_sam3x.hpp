@@ -0,0 +1,557 @@
+/**
+ * @file
+ * @brief     Simulated SAM3X USART, PIO and PMC registers, so the register level drivers run in host builds.
+ * @author    Wiebe van Breukelen
+ * @license   See LICENSE
+ */
+
+#ifndef SIMULATED_SAM3X_HPP
+#define SIMULATED_SAM3X_HPP
+
+#include "queue.hpp"
+#include "wrap-hwlib.hpp"
+
+namespace UARTLib {
+
+/**
+ * @brief Simulated register, forwarding reads and writes to the peripheral owning it, which models the side effects.
+ *
+ * Converts to and from integers, so driver code written for the memory mapped registers of the SAM3X compiles unchanged.
+ * Registers hold a uintptr_t, so the PDC pointer registers can hold host addresses.
+ *
+ * @tparam Peripheral Peripheral owning the register, providing readRegister() and writeRegister().
+ */
+template <class Peripheral>
+class SimulatedRegister {
+  public:
+    SimulatedRegister(Peripheral &peripheral, unsigned int index) : peripheral(peripheral), index(index) {
+    }
+
+    SimulatedRegister(const SimulatedRegister &) = delete;
+
+    operator uintptr_t() const {
+        return peripheral.readRegister(index);
+    }
+
+    SimulatedRegister &operator=(uintptr_t value) {
+        peripheral.writeRegister(index, value);
+        return *this;
+    }
+
+    SimulatedRegister &operator=(const SimulatedRegister &other) {
+        return *this = static_cast<uintptr_t>(other);
+    }
+
+    SimulatedRegister &operator|=(uintptr_t value) {
+        return *this = *this | value;
+    }
+
+    SimulatedRegister &operator&=(uintptr_t value) {
+        return *this = *this & value;
+    }
+
+  private:
+    Peripheral &peripheral;
+    unsigned int index;
+};
+
+/**
+ * @brief Virtual time and interrupt controller of the simulated SAM3X.
+ *
+ * Time is counted in master clock cycles and only passes when the program accesses a register, when an interrupt is taken,
+ * or when run() is called. Every register access is charged a fixed amount of cycles, standing in for the instructions
+ * around it, so busy waiting on a status register makes progress just like on the board. Before each access, pending
+ * interrupts of the simulated USART controllers are taken by calling their handlers (USART0_Handler etc.), unless masked
+ * using NVIC_DisableIRQ(). Interrupts are not nested.
+ *
+ * The simulated peripherals are global, like the ones on the board. Call reset() before using them, e.g. in every test.
+ */
+class SimulatedSam3x {
+  public:
+    /**
+     * @brief Reset virtual time, the interrupt controller and every simulated peripheral.
+     *
+     */
+    static void reset();
+
+    /**
+     * @brief Get the virtual time.
+     *
+     * @return uint64_t Master clock cycles since reset().
+     */
+    static uint64_t now();
+
+    /**
+     * @brief Let virtual time pass, e.g. while the program would be busy elsewhere, taking interrupts as they occur.
+     *
+     * @param cycles Master clock cycles.
+     */
+    static void run(uint64_t cycles);
+
+    /**
+     * @brief Set the CPU time charged per register access.
+     *
+     * @param cycles Master clock cycles, 8 by default.
+     */
+    static void setAccessCycles(uint32_t cycles);
+
+    /**
+     * @brief Set the CPU time charged for entering and leaving an interrupt handler.
+     *
+     * @param cycles Master clock cycles, 24 by default.
+     */
+    static void setInterruptCycles(uint32_t cycles);
+
+    /**
+     * @brief Enable an interrupt line, see NVIC_EnableIRQ().
+     *
+     * @param line Interrupt line, the peripheral identifier.
+     */
+    static void enableInterrupt(uint32_t line);
+
+    /**
+     * @brief Disable an interrupt line, see NVIC_DisableIRQ().
+     *
+     * @param line Interrupt line, the peripheral identifier.
+     */
+    static void disableInterrupt(uint32_t line);
+
+    /**
+     * @brief Charge a register access, taking pending interrupts first. Called by the simulated peripherals.
+     *
+     */
+    static void access();
+
+  private:
+    static uint64_t time;
+    static uint32_t enabledInterrupts;
+    static uint32_t accessCycles;
+    static uint32_t interruptCycles;
+    static bool inHandler;
+
+    /**
+     * @brief Move virtual time forward, handling the events of the peripherals in order.
+     *
+     * @param target Virtual time to move to.
+     */
+    static void advanceTo(uint64_t target);
+
+    /**
+     * @brief Take the pending interrupts, unless already in an interrupt handler.
+     *
+     */
+    static void takeInterrupts();
+};
+
+} // namespace UARTLib
+
+/**
+ * @brief Simulated parallel I/O controller, keeping track of which pins are driven, and how.
+ *
+ */
+class Pio {
+    typedef UARTLib::SimulatedRegister<Pio> Register;
+
+  public:
+    Register PIO_PER, PIO_PDR, PIO_PSR, PIO_OER, PIO_ODR, PIO_OSR, PIO_SODR, PIO_CODR, PIO_ODSR, PIO_PDSR, PIO_ABSR;
+
+    Pio();
+
+    Pio(const Pio &) = delete;
+    Pio &operator=(const Pio &) = delete;
+
+    /**
+     * @brief Check if pins are driven high by the PIO controller, as outputs under PIO control.
+     *
+     * @param mask Pins.
+     * @return true Every pin is driven high.
+     * @return false Not every pin.
+     */
+    bool drivenHigh(uint32_t mask) const;
+
+    /**
+     * @brief Check if pins are handed to a peripheral.
+     *
+     * @param mask Pins.
+     * @param peripheralB Peripheral B, otherwise A.
+     * @return true Every pin is handed to the peripheral.
+     * @return false Not every pin.
+     */
+    bool routedTo(uint32_t mask, bool peripheralB) const;
+
+    void reset();
+
+    uintptr_t readRegister(unsigned int index);
+
+    void writeRegister(unsigned int index, uintptr_t value);
+
+  private:
+    uint32_t status;       ///< PIO_PSR, pins under PIO control.
+    uint32_t outputs;      ///< PIO_OSR, pins driven as output.
+    uint32_t outputData;   ///< PIO_ODSR.
+    uint32_t peripheralAB; ///< PIO_ABSR, pins handed to peripheral B.
+};
+
+/**
+ * @brief Simulated power management controller, gating the peripheral clocks.
+ *
+ */
+class Pmc {
+    typedef UARTLib::SimulatedRegister<Pmc> Register;
+
+  public:
+    Register PMC_PCER0, PMC_PCDR0, PMC_PCSR0;
+
+    Pmc();
+
+    Pmc(const Pmc &) = delete;
+    Pmc &operator=(const Pmc &) = delete;
+
+    /**
+     * @brief Check if the clock of a peripheral is enabled. Peripherals without a clock ignore register accesses.
+     *
+     * @param id Peripheral identifier.
+     * @return true Enabled.
+     * @return false Disabled.
+     */
+    bool clockEnabled(uint32_t id) const;
+
+    void reset();
+
+    uintptr_t readRegister(unsigned int index);
+
+    void writeRegister(unsigned int index, uintptr_t value);
+
+  private:
+    uint32_t enabled; ///< PMC_PCSR0.
+};
+
+/**
+ * @brief Simulated USART controller, including its PDC channel, in asynchronous mode.
+ *
+ * Characters take the time set by US_BRGR and US_MR (oversampling, character length, parity and stop bits) to be shifted
+ * out or in. Transmitted characters go to the line output, or straight into the receiver of a connected controller. Received
+ * characters are taken from the line input, sent back to back by a simulated remote sender. The remote sender pauses while
+ * the RTS pin of the controller is driven high, and optionally after an XOFF until an XON.
+ *
+ * Modelled are RXRDY, TXRDY and TXEMPTY, overrun of US_RHR (the new character replaces the unread one), the receiver timeout
+ * (US_RTOR with STTTO and RETTO) and the PDC transmit and receive channels with their next descriptors, ENDRX, ENDTX, RXBUFF
+ * and TXBUFE. Framing and parity errors, breaks and hardware handshaking on CTS are not.
+ */
+class Usart {
+    typedef UARTLib::SimulatedRegister<Usart> Register;
+
+  public:
+    Register US_CR, US_MR, US_IER, US_IDR, US_IMR, US_CSR, US_RHR, US_THR, US_BRGR, US_RTOR, US_TTGR;
+    Register US_RPR, US_RCR, US_TPR, US_TCR, US_RNPR, US_RNCR, US_TNPR, US_TNCR, US_PTCR, US_PTSR;
+
+    /**
+     * @brief Construct a new Usart object.
+     *
+     * @param id Peripheral identifier, also the interrupt line.
+     * @param handler Interrupt handler.
+     * @param rtsPio PIO controller of the RTS pin, nullptr without one.
+     * @param rtsMask RTS pin.
+     */
+    Usart(uint32_t id, void (*handler)(), Pio *rtsPio, uint32_t rtsMask);
+
+    Usart(const Usart &) = delete;
+    Usart &operator=(const Usart &) = delete;
+
+    /**
+     * @brief Queue characters to be received, sent back to back by the remote sender from now on.
+     *
+     * @param data Characters.
+     * @param length Amount of characters.
+     * @return size_t Amount of characters queued, fewer when the line input is full.
+     */
+    size_t receiveFromLine(const uint8_t *data, size_t length);
+
+    /**
+     * @brief Take characters that have been transmitted on the line.
+     *
+     * @param buf Array to take them into.
+     * @param n Size of array.
+     * @return size_t Amount of characters taken.
+     */
+    size_t takeTransmitted(uint8_t *buf, size_t n);
+
+    /**
+     * @brief Get the amount of transmitted characters, not taken yet.
+     *
+     * @return size_t Amount of characters.
+     */
+    size_t transmittedCount();
+
+    /**
+     * @brief Connect the transmitter to the receiver of another controller, instead of the line output.
+     *
+     * @param peer Controller receiving what is transmitted, nullptr to go back to the line output.
+     */
+    void connect(Usart *peer);
+
+    /**
+     * @brief Select if the remote sender pauses after receiving XOFF, until receiving XON.
+     *
+     * @param enabled Honour XON and XOFF, disabled by default.
+     */
+    void setSoftwareFlowControl(bool enabled);
+
+    /**
+     * @brief Get the time needed to transmit or receive a character.
+     *
+     * @return uint64_t Master clock cycles, 0 while the baudrate generator is disabled.
+     */
+    uint64_t characterCycles() const;
+
+    /**
+     * @brief Get the amount of characters transmitted since reset, including the ones sent to a peer.
+     *
+     * @return uint32_t Amount of characters.
+     */
+    uint32_t charactersTransmitted() const;
+
+    /**
+     * @brief Get the amount of characters lost by overrunning US_RHR since reset.
+     *
+     * @return uint32_t Amount of characters.
+     */
+    uint32_t charactersOverrun() const;
+
+    void reset();
+
+    uintptr_t readRegister(unsigned int index);
+
+    void writeRegister(unsigned int index, uintptr_t value);
+
+    /**
+     * @brief Get the time of the next event (a character shifted out or in, or the receiver timeout).
+     *
+     * @return uint64_t Virtual time, noEvent without one.
+     */
+    uint64_t nextEvent();
+
+    /**
+     * @brief Handle the events due at the current time.
+     *
+     */
+    void handleEvents();
+
+    /**
+     * @brief Check if an enabled interrupt is pending.
+     *
+     * @return true Pending.
+     * @return false Not pending.
+     */
+    bool interruptPending();
+
+    /**
+     * @brief Call the interrupt handler.
+     *
+     */
+    void interrupt();
+
+    /**
+     * @brief Get the peripheral identifier.
+     *
+     * @return uint32_t Identifier.
+     */
+    uint32_t identifier() const;
+
+    static constexpr uint64_t noEvent = ~static_cast<uint64_t>(0);
+
+  private:
+    uint32_t id;
+    void (*handler)();
+    Pio *rtsPio;
+    uint32_t rtsMask;
+    Usart *peer;
+    bool softwareFlowControl;
+
+    ///< Configuration registers.
+    uint32_t mode;
+    uint32_t baudRateGenerator;
+    uint32_t receiverTimeout;
+    uint32_t interruptMask;
+
+    ///< Transmitter: holding register (US_THR) and shift register.
+    bool transmitterEnabled;
+    bool holdingFull;
+    uint8_t holding;
+    bool shifting;
+    uint8_t shifted;
+    uint64_t shiftDone;
+
+    ///< Receiver.
+    bool receiverEnabled;
+    bool receiveReady;
+    uint8_t received;
+    bool overrun;
+    bool timeout;
+    bool timeoutArmed;
+    uint64_t timeoutAt;
+
+    ///< PDC channel, with the ENDRX and ENDTX flags, which stay set until a counter is written.
+    uintptr_t rpr, rcr, rnpr, rncr, tpr, tcr, tnpr, tncr;
+    bool receiveTransferEnabled;
+    bool transmitTransferEnabled;
+    bool endOfReceive;
+    bool endOfTransmit;
+
+    ///< Remote sender.
+    Queue<uint8_t, 4096> lineInput;
+    Queue<uint8_t, 4096> lineOutput;
+    uint64_t arrival;
+    bool xoffReceived;
+
+    uint32_t transmittedTotal;
+    uint32_t overrunTotal;
+
+    bool clocked() const;
+    uint32_t status();
+    uint64_t bitCycles() const;
+    void control(uint32_t command);
+    void write(uint8_t b);
+    void startShifting();
+    void transmitFromPdc();
+    void characterTransmitted();
+    void characterReceived(uint8_t b);
+    bool senderPaused();
+    void scheduleArrival();
+};
+
+extern Usart simulatedUSART0;
+extern Usart simulatedUSART1;
+extern Usart simulatedUSART3;
+extern Pio simulatedPIOA;
+extern Pio simulatedPIOB;
+extern Pio simulatedPIOD;
+extern Pmc simulatedPMC;
+
+#define USART0 (&simulatedUSART0)
+#define USART1 (&simulatedUSART1)
+#define USART3 (&simulatedUSART3)
+#define PIOA (&simulatedPIOA)
+#define PIOB (&simulatedPIOB)
+#define PIOD (&simulatedPIOD)
+#define PMC (&simulatedPMC)
+
+///< Peripheral identifiers, also used as interrupt line.
+#define ID_USART0 (17)
+#define ID_USART1 (18)
+#define ID_USART3 (20)
+
+typedef enum IRQn { USART0_IRQn = ID_USART0, USART1_IRQn = ID_USART1, USART3_IRQn = ID_USART3 } IRQn_Type;
+
+void NVIC_EnableIRQ(IRQn_Type line);
+void NVIC_DisableIRQ(IRQn_Type line);
+
+///< Bits of the SAM3X registers, as named by the device headers. See section 35.7 of the SAM3X datasheet.
+#define PIO_PA10 (0x1u << 10)
+#define PIO_PA11 (0x1u << 11)
+#define PIO_PA12 (0x1u << 12)
+#define PIO_PA13 (0x1u << 13)
+#define PIO_PA14 (0x1u << 14)
+#define PIO_PA15 (0x1u << 15)
+#define PIO_PB25 (0x1u << 25)
+#define PIO_PB26 (0x1u << 26)
+#define PIO_PD4 (0x1u << 4)
+#define PIO_PD5 (0x1u << 5)
+
+#define UART_CR_RSTRX (0x1u << 2)
+#define UART_CR_RSTTX (0x1u << 3)
+#define UART_CR_RXEN (0x1u << 4)
+#define UART_CR_RXDIS (0x1u << 5)
+#define UART_CR_TXEN (0x1u << 6)
+#define UART_CR_TXDIS (0x1u << 7)
+#define UART_CR_RSTSTA (0x1u << 8)
+#define UART_MR_PAR_NO (0x4u << 9)
+#define UART_MR_CHMODE_NORMAL (0x0u << 14)
+
+#define US_CR_RSTRX (0x1u << 2)
+#define US_CR_RSTTX (0x1u << 3)
+#define US_CR_RXEN (0x1u << 4)
+#define US_CR_RXDIS (0x1u << 5)
+#define US_CR_TXEN (0x1u << 6)
+#define US_CR_TXDIS (0x1u << 7)
+#define US_CR_RSTSTA (0x1u << 8)
+#define US_CR_STTTO (0x1u << 11)
+#define US_CR_RETTO (0x1u << 15)
+
+#define US_MR_USART_MODE_Msk (0xfu << 0)
+#define US_MR_USART_MODE_NORMAL (0x0u << 0)
+#define US_MR_USART_MODE_HW_HANDSHAKING (0x2u << 0)
+#define US_MR_CHRL_Pos 6
+#define US_MR_CHRL_Msk (0x3u << US_MR_CHRL_Pos)
+#define US_MR_CHRL_8_BIT (0x3u << 6)
+#define US_MR_PAR_Pos 9
+#define US_MR_PAR_Msk (0x7u << US_MR_PAR_Pos)
+#define US_MR_PAR_NO (0x4u << 9)
+#define US_MR_NBSTOP_Pos 12
+#define US_MR_NBSTOP_Msk (0x3u << US_MR_NBSTOP_Pos)
+#define US_MR_OVER (0x1u << 19)
+
+#define US_BRGR_CD_Msk (0xffffu << 0)
+#define US_BRGR_CD(value) ((US_BRGR_CD_Msk & ((value) << 0)))
+#define US_BRGR_FP_Pos 16
+#define US_BRGR_FP_Msk (0x7u << US_BRGR_FP_Pos)
+#define US_BRGR_FP(value) ((US_BRGR_FP_Msk & ((value) << US_BRGR_FP_Pos)))
+#define US_RTOR_TO_Msk (0xffffu << 0)
+#define US_RTOR_TO(value) ((US_RTOR_TO_Msk & ((value) << 0)))
+
+#define US_CSR_RXRDY (0x1u << 0)
+#define US_CSR_TXRDY (0x1u << 1)
+#define US_CSR_ENDRX (0x1u << 3)
+#define US_CSR_ENDTX (0x1u << 4)
+#define US_CSR_OVRE (0x1u << 5)
+#define US_CSR_FRAME (0x1u << 6)
+#define US_CSR_PARE (0x1u << 7)
+#define US_CSR_TIMEOUT (0x1u << 8)
+#define US_CSR_TXEMPTY (0x1u << 9)
+#define US_CSR_TXBUFE (0x1u << 11)
+#define US_CSR_RXBUFF (0x1u << 12)
+
+#define US_IER_RXRDY US_CSR_RXRDY
+#define US_IER_TXRDY US_CSR_TXRDY
+#define US_IER_ENDRX US_CSR_ENDRX
+#define US_IER_ENDTX US_CSR_ENDTX
+#define US_IER_OVRE US_CSR_OVRE
+#define US_IER_FRAME US_CSR_FRAME
+#define US_IER_PARE US_CSR_PARE
+#define US_IER_TIMEOUT US_CSR_TIMEOUT
+#define US_IER_TXEMPTY US_CSR_TXEMPTY
+#define US_IER_TXBUFE US_CSR_TXBUFE
+#define US_IER_RXBUFF US_CSR_RXBUFF
+
+#define US_IDR_RXRDY US_CSR_RXRDY
+#define US_IDR_TXRDY US_CSR_TXRDY
+#define US_IDR_ENDRX US_CSR_ENDRX
+#define US_IDR_ENDTX US_CSR_ENDTX
+#define US_IDR_OVRE US_CSR_OVRE
+#define US_IDR_FRAME US_CSR_FRAME
+#define US_IDR_PARE US_CSR_PARE
+#define US_IDR_TIMEOUT US_CSR_TIMEOUT
+#define US_IDR_TXEMPTY US_CSR_TXEMPTY
+#define US_IDR_TXBUFE US_CSR_TXBUFE
+#define US_IDR_RXBUFF US_CSR_RXBUFF
+
+#define US_IMR_RXRDY US_CSR_RXRDY
+#define US_IMR_TXRDY US_CSR_TXRDY
+#define US_IMR_ENDRX US_CSR_ENDRX
+#define US_IMR_ENDTX US_CSR_ENDTX
+#define US_IMR_OVRE US_CSR_OVRE
+#define US_IMR_FRAME US_CSR_FRAME
+#define US_IMR_PARE US_CSR_PARE
+#define US_IMR_TIMEOUT US_CSR_TIMEOUT
+#define US_IMR_TXEMPTY US_CSR_TXEMPTY
+#define US_IMR_TXBUFE US_CSR_TXBUFE
+#define US_IMR_RXBUFF US_CSR_RXBUFF
+
+#define US_PTCR_RXTEN (0x1u << 0)
+#define US_PTCR_RXTDIS (0x1u << 1)
+#define US_PTCR_TXTEN (0x1u << 8)
+#define US_PTCR_TXTDIS (0x1u << 9)
+#define US_PTSR_RXTEN (0x1u << 0)
+#define US_PTSR_TXTEN (0x1u << 8)
+
+#endif
@@ -8,6 +8,10 @@
 #ifndef UART_COMM_HPP
 #define UART_COMM_HPP
 
+#include "byte_span.hpp"
+#include "frame_index.hpp"
+#include "link_statistics.hpp"
+#include "overflow_policy.hpp"
 #include "queue.hpp"
 #include "wrap-hwlib.hpp"
 
@@ -23,6 +27,17 @@ namespace UARTLib {
  */
 enum class UARTController { ONE, TWO, THREE };
 
+/**
+ * @brief Used to select how data is moved between the USART controller and the buffers.
+ *
+ * Polling     - Data is moved when the application calls into the connection.
+ * Interrupt   - Data is moved by the USART interrupt handler, the application only accesses the buffers.
+ * DMA         - Data is moved by the Peripheral DMA Controller, straight from or into application buffers.
+ * Cooperative - Data is moved by service(), called from the main loop, in bounded steps. No call waits: bytes sent are
+ *               queued in the transmit buffer, single bytes that do not fit are dropped.
+ */
+enum class TransferMode { POLLING, INTERRUPT, DMA, COOPERATIVE };
+
 /**
  * @brief Superclass for any UART connection, hardware or mock based.
  * Using polymorphism, we can use the same interface for both implementations.
@@ -93,13 +108,51 @@ class UARTConnection : public hwlib::ostream, public hwlib::istream {
     /**
      * @brief Send a array of bytes with a specified length.
      *
+     * Waits until every byte has been queued or sent. In cooperative transmit mode, where waiting would never end, the array
+     * is only queued when it fits in the transmit buffer as a whole. Use trySend() to send a part of it.
+     *
      * @param data Array of bytes.
      * @param length Length of array.
-     * @return true Array of bytes send.
-     * @return false Array of bytes has not been send, USART controller not initialized.
+     * @return true Every byte has been queued or sent.
+     * @return false Not a single byte has been queued, USART controller not initialized or the array does not fit.
      */
     virtual bool send(const uint8_t *data, size_t length) = 0;
 
+    /**
+     * @brief Send as much of an array of bytes as possible without waiting.
+     *
+     * In interrupt transmit mode, bytes are queued in the transmit buffer until it is full. In polling mode, every byte is sent.
+     *
+     * @param data Array of bytes.
+     * @param length Length of array.
+     * @return size_t Amount of bytes accepted, 0 if the USART controller is not initialized.
+     */
+    virtual size_t trySend(const uint8_t *data, size_t length) = 0;
+
+    /**
+     * @brief Check how many bytes are waiting in the transmit buffer.
+     *
+     * @return size_t Amount of bytes not yet handed to the USART controller.
+     */
+    virtual size_t txPending() = 0;
+
+    /**
+     * @brief Check how many bytes can be sent without waiting.
+     *
+     * In interrupt transmit mode, this is the room left in the transmit buffer. In polling mode, it is 1 while the transmitter
+     * is ready for the next byte.
+     *
+     * @return size_t Amount of bytes trySend() accepts right now, 0 when sending would wait.
+     */
+    virtual size_t txFree() = 0;
+
+    /**
+     * @brief Wait until every queued byte has left the transmitter.
+     *
+     * Also used by hwlib::ostream to flush the stream.
+     */
+    virtual void flush() override = 0;
+
     /**
      * @brief Receive a single byte.
      *
@@ -109,6 +162,142 @@ class UARTConnection : public hwlib::ostream, public hwlib::istream {
      */
     virtual uint8_t receive() = 0;
 
+    /**
+     * @brief Receive up to n bytes at once.
+     *
+     * Pops as many bytes from the receive buffer as are available, at most n, in a FIFO manner.
+     *
+     * @param buf Array to receive into.
+     * @param n Size of the array.
+     * @return size_t Amount of bytes received.
+     */
+    virtual size_t receive(uint8_t *buf, size_t n) = 0;
+
+    /**
+     * @brief Get the readable part of the receive buffer, without copying it.
+     *
+     * As the receive buffer is a ring, the received bytes are split in at most two contiguous spans. The second span is empty
+     * unless the received bytes wrap around the end of the buffer. The spans stay valid until consume() is called.
+     *
+     * @param first Set to the oldest received bytes.
+     * @param second Set to the received bytes following the first span.
+     * @return size_t Amount of bytes in both spans.
+     */
+    virtual size_t readableSpans(ByteSpan &first, ByteSpan &second) = 0;
+
+    /**
+     * @brief Remove bytes from the front of the receive buffer, after reading them using readableSpans().
+     *
+     * @param n Amount of bytes to remove, limited to the amount of bytes available.
+     */
+    virtual void consume(size_t n) = 0;
+
+    /**
+     * @brief Find a byte in the receive buffer, e.g. the delimiter ending a line, without removing anything.
+     *
+     * Remembers how far the receive buffer has been searched, so each received byte is only inspected once, also when called
+     * again after more bytes arrived. Bytes are compared a word at a time.
+     *
+     * @param delimiter Byte to find.
+     * @param position Set to the position of the oldest occurrence, counted from the oldest received byte.
+     * @return true Found.
+     * @return false Not received yet.
+     */
+    virtual bool findInBuffer(uint8_t delimiter, size_t &position) = 0;
+
+    /**
+     * @brief Receive everything up to and including a delimiter, once the delimiter has been received.
+     *
+     * Bytes preceding the delimiter that do not fit are received without it, n at a time, so a long line cannot fill up the
+     * receive buffer. Check if the last byte received is the delimiter to tell them apart.
+     *
+     * @param delimiter Byte ending the data, e.g. '\n'.
+     * @param buf Array to receive into.
+     * @param n Size of array.
+     * @return size_t Amount of bytes received, including the delimiter. 0 while the delimiter has not been received.
+     */
+    size_t readUntil(uint8_t delimiter, uint8_t *buf, size_t n) {
+        ///< In polling mode, this moves received bytes into the receive buffer.
+        size_t received = available();
+
+        size_t position;
+        if (findInBuffer(delimiter, position) && position < n) {
+            return receive(buf, position + 1);
+        }
+
+        ///< The delimiter is further away than n bytes, or has not been received while n bytes have.
+        return received >= n ? receive(buf, n) : 0;
+    }
+
+    /**
+     * @brief Select what ends a frame in the received bytes, so whole frames can be taken using nextFrame().
+     *
+     * The receive path indexes frames while storing bytes in the receive buffer. Set it before receiving, the frames
+     * indexed so far are discarded. Frames are not supported with the overwrite oldest overflow policy.
+     *
+     * @param boundary What ends a frame, none by default.
+     * @param parameter Delimiter byte, amount of length header bytes (1 or 2) or amount of idle bit periods.
+     */
+    virtual void setFrameBoundary(FrameBoundary boundary, uint16_t parameter = 0) {
+        frames.setBoundary(boundary, boundary == FrameBoundary::IDLE && parameter == 0 ? 20 : parameter);
+    }
+
+    /**
+     * @brief Check how many frames have been received completely.
+     *
+     * @return unsigned int Amount of frames waiting to be read.
+     */
+    unsigned int framesAvailable() {
+        ///< In polling mode, this moves received bytes into the receive buffer.
+        available();
+
+        return frames.count();
+    }
+
+    /**
+     * @brief Take the descriptor of the oldest received frame.
+     *
+     * The bytes of the frame are the next frame.length bytes in the receive buffer, read them using receive(buf,
+     * frame.length) or readableSpans() and consume(). Read every byte of each frame taken, and nothing else, as the bytes of
+     * frames dropped before this one are skipped by counting from the end of the previous frame.
+     *
+     * @param frame Set to the descriptor of the oldest frame.
+     * @return true A frame was available.
+     * @return false No frames.
+     */
+    bool nextFrame(FrameDescriptor &frame) {
+        uint32_t skipped;
+        if (framesAvailable() == 0 || !frames.pop(frame, skipped)) {
+            return false;
+        }
+
+        if (skipped > 0) {
+            consume(skipped);
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief Get the amount of frames that were not indexed, as the ring of descriptors was full.
+     *
+     * Their bytes are skipped by nextFrame().
+     *
+     * @return uint32_t Amount of frames.
+     */
+    uint32_t framesDropped() const {
+        return frames.framesDropped();
+    }
+
+    /**
+     * @brief Set the clock used for the timestamps of frames, e.g. returning hwlib::now_us().
+     *
+     * @param clock Clock, nullptr for no timestamps.
+     */
+    void setFrameClock(FrameIndex::Clock clock) {
+        frames.setClock(clock);
+    }
+
     /**
      * @brief Checks if the internal USART controller has been initialized.
      *
@@ -117,6 +306,77 @@ class UARTConnection : public hwlib::ostream, public hwlib::istream {
      */
     virtual bool isInitialized() = 0;
 
+    /**
+     * @brief Select how received bytes are moved into the receive buffer.
+     *
+     * In interrupt mode the USART interrupt handler drains the controller into the receive buffer by itself, so no bytes are
+     * lost while the application is busy. available() and receive() then only read the buffer.
+     *
+     * DMA mode is only supported by connections that can receive whole frames, see HardwareUART::setFrameBuffers().
+     *
+     * @param mode Receive transfer mode, polling by default.
+     */
+    virtual void setReceiveMode(TransferMode mode) = 0;
+
+    /**
+     * @brief Select how bytes are moved from the transmit buffer into the USART controller.
+     *
+     * In interrupt mode, send() returns as soon as the data is queued. The USART interrupt handler feeds the transmitter from
+     * the transmit buffer. A single byte send waits only when the transmit buffer is full.
+     *
+     * In DMA mode, send(data, length) hands the array to the DMA controller and returns. The array must stay valid until
+     * txPending() no longer counts it.
+     *
+     * @param mode Transmit transfer mode, polling by default.
+     */
+    virtual void setTransmitMode(TransferMode mode) = 0;
+
+    /**
+     * @brief Get the selected transmit transfer mode.
+     *
+     * @return TransferMode Transmit transfer mode.
+     */
+    virtual TransferMode getTransmitMode() const = 0;
+
+    /**
+     * @brief Select what happens to received bytes when the receive buffer is full.
+     *
+     * With the backpressure policy, the sender is held off by sending XOFF once the receive buffer reaches the high watermark,
+     * and released by sending XON once it has been read down to the low watermark. Leaving the backpressure policy releases a
+     * sender that is held off.
+     *
+     * @param policy Overflow policy, dropping new bytes by default.
+     */
+    virtual void setOverflowPolicy(OverflowPolicy policy) = 0;
+
+    /**
+     * @brief Set the receive buffer levels used by the backpressure policy.
+     *
+     * By default, the sender is held off at three quarters of the receive buffer capacity and released at one quarter.
+     *
+     * @param high Amount of buffered bytes at which the sender is held off.
+     * @param low Amount of buffered bytes at which the sender is released again, below high.
+     */
+    virtual void setWatermarks(size_t high, size_t low) = 0;
+
+    /**
+     * @brief Service a USART interrupt.
+     *
+     * Called by the InterruptRouter for the controller this connection is attached to.
+     */
+    virtual void handleInterrupt() = 0;
+
+    /**
+     * @brief Move a bounded amount of data between the USART controller and the buffers, without waiting.
+     *
+     * Drives the directions using the cooperative (or, for receiving, polling) transfer mode. Call it from the main loop, the
+     * time it takes is bounded by the budget.
+     *
+     * @param budget Most bytes moved in each direction.
+     * @return size_t Amount of bytes moved.
+     */
+    virtual size_t service(size_t budget) = 0;
+
     /**
      * @brief Write a character using UART.
      *
@@ -145,6 +405,37 @@ class UARTConnection : public hwlib::ostream, public hwlib::istream {
      */
     virtual char getc() = 0;
 
+    /**
+     * @brief Get the link health counters of this connection.
+     *
+     * @return const LinkStatistics& Counters since construction or the last resetStatistics().
+     */
+    const LinkStatistics &statistics() const {
+        return stats;
+    }
+
+    /**
+     * @brief Reset every link health counter to zero.
+     *
+     * The high-water marks start again from zero, not from the current buffer levels.
+     */
+    void resetStatistics() {
+        stats = LinkStatistics();
+    }
+
+  protected:
+    /**
+     * @brief Link health counters, updated by the implementation.
+     *
+     */
+    LinkStatistics stats = {};
+
+    /**
+     * @brief Frames in the receive buffer, filled by the implementation.
+     *
+     */
+    FrameIndex frames;
+
   private:
     /**
      * @brief Checks if the USART controller reports that the transmitter is ready to send.
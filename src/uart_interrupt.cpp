@@ -0,0 +1,85 @@
+#include "uart_interrupt.hpp"
+
+namespace UARTLib {
+
+UARTConnection *volatile InterruptRouter::connections[3] = {nullptr, nullptr, nullptr};
+InterruptListener *volatile InterruptRouter::listeners[3] = {nullptr, nullptr, nullptr};
+volatile uint32_t InterruptRouter::pending = 0;
+
+void InterruptRouter::attach(UARTController controller, UARTConnection *connection) {
+    connections[static_cast<unsigned int>(controller)] = connection;
+}
+
+bool InterruptRouter::claim(UARTController controller, UARTConnection *connection) {
+    UARTConnection *expected = nullptr;
+
+    return __atomic_compare_exchange_n(&connections[static_cast<unsigned int>(controller)], &expected, connection, false,
+                                       __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) ||
+           expected == connection;
+}
+
+void InterruptRouter::detach(UARTController controller, UARTConnection *connection) {
+    if (connections[static_cast<unsigned int>(controller)] == connection) {
+        connections[static_cast<unsigned int>(controller)] = nullptr;
+        listeners[static_cast<unsigned int>(controller)] = nullptr;
+    }
+}
+
+void InterruptRouter::dispatch(UARTController controller) {
+    UARTConnection *connection = connections[static_cast<unsigned int>(controller)];
+
+    ///< An interrupt without an owner is ignored, the controller will not be serviced.
+    if (connection != nullptr) {
+        connection->handleInterrupt();
+    }
+
+    InterruptListener *listener = listeners[static_cast<unsigned int>(controller)];
+    if (listener != nullptr) {
+        listener->interruptServiced();
+    }
+
+    __atomic_fetch_or(&pending, 1u << static_cast<unsigned int>(controller), __ATOMIC_RELEASE);
+}
+
+bool InterruptRouter::listen(UARTConnection *connection, InterruptListener *listener) {
+    for (unsigned int i = 0; i < 3; i++) {
+        if (connections[i] == connection) {
+            InterruptListener *expected = nullptr;
+
+            return __atomic_compare_exchange_n(&listeners[i], &expected, listener, false, __ATOMIC_ACQ_REL,
+                                               __ATOMIC_ACQUIRE) ||
+                   expected == listener;
+        }
+    }
+
+    return false;
+}
+
+void InterruptRouter::unlisten(InterruptListener *listener) {
+    for (unsigned int i = 0; i < 3; i++) {
+        if (listeners[i] == listener) {
+            listeners[i] = nullptr;
+        }
+    }
+}
+
+uint32_t InterruptRouter::takePending() {
+    return __atomic_exchange_n(&pending, 0, __ATOMIC_ACQ_REL);
+}
+
+bool InterruptRouter::waitForInterrupt() {
+#ifdef BMPTK_TARGET_arduino_due
+    ///< WFI also wakes on an interrupt that is masked, it is handled right after enabling interrupts again.
+    __disable_irq();
+    if (pending == 0) {
+        __WFI();
+    }
+    __enable_irq();
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+} // namespace UARTLib
@@ -0,0 +1,196 @@
+/**
+ * @file
+ * @brief     Routes USART interrupts to the UART connection that owns the controller.
+ * @author    Wiebe van Breukelen
+ * @license   See LICENSE
+ */
+
+#ifndef UART_INTERRUPT_HPP
+#define UART_INTERRUPT_HPP
+
+#include "uart_connection.hpp"
+
+namespace UARTLib {
+
+/**
+ * @brief Notified after the interrupt of a controller has been serviced, e.g. to complete asynchronous transfers.
+ *
+ */
+class InterruptListener {
+  public:
+    /**
+     * @brief Called from the interrupt handler, after the connection serviced the interrupt.
+     *
+     */
+    virtual void interruptServiced() = 0;
+};
+
+/**
+ * @brief Keeps a routine from running in the main loop and the interrupt handler at the same time, without masking interrupts.
+ *
+ * A call finding the routine running only records that it missed a round. The running one then runs another round, so
+ * nothing that arrived in the meantime is left waiting. For example:
+ *
+ *     if (!guard.enter()) {
+ *         return;
+ *     }
+ *
+ *     do {
+ *         advance();
+ *     } while (guard.leave());
+ */
+class ReentryGuard {
+  public:
+    /**
+     * @brief Construct a new ReentryGuard object, not running.
+     *
+     */
+    ReentryGuard() : running(false), missed(false) {
+    }
+
+    /**
+     * @brief Start running the routine.
+     *
+     * @return true Started, run a round and call leave().
+     * @return false Already running, the running one will run another round.
+     */
+    bool enter() {
+        if (__atomic_exchange_n(&running, true, __ATOMIC_ACQUIRE)) {
+            missed = true;
+            return false;
+        }
+
+        missed = false;
+        return true;
+    }
+
+    /**
+     * @brief Finish a round of the routine.
+     *
+     * @return true A call was missed during the round, run another one and call leave() again.
+     * @return false Done.
+     */
+    bool leave() {
+        __atomic_store_n(&running, false, __ATOMIC_RELEASE);
+
+        if (missed && !__atomic_exchange_n(&running, true, __ATOMIC_ACQUIRE)) {
+            missed = false;
+            return true;
+        }
+
+        return false;
+    }
+
+  private:
+    volatile bool running;
+    volatile bool missed;
+};
+
+/**
+ * @brief Routing table between the USART interrupt handlers and UART connection instances.
+ *
+ * The interrupt vectors of USART0, USART1 and USART3 are plain functions, so they need a way to find the object that
+ * owns the controller. Each connection attaches itself when it is initialized. The hardware interrupt handlers and the
+ * mock implementation both enter through dispatch(), so the interrupt path can be tested on the host.
+ */
+class InterruptRouter {
+  public:
+    /**
+     * @brief Attach a connection to the interrupt of a controller.
+     *
+     * @param controller Controller whose interrupt should be routed.
+     * @param connection Connection that will service the interrupt.
+     */
+    static void attach(UARTController controller, UARTConnection *connection);
+
+    /**
+     * @brief Attach a connection to the interrupt of a controller, unless another connection is attached to it.
+     *
+     * Used by connections that do not own the hardware, so they can never take the interrupt away from one that does.
+     *
+     * @param controller Controller whose interrupt should be routed.
+     * @param connection Connection that will service the interrupt.
+     * @return true Attached.
+     * @return false Another connection is attached to the controller.
+     */
+    static bool claim(UARTController controller, UARTConnection *connection);
+
+    /**
+     * @brief Detach a connection from the interrupt of a controller.
+     *
+     * Nothing happens if another connection has been attached to the controller in the meantime.
+     *
+     * @param controller Controller whose interrupt is routed.
+     * @param connection Connection to detach.
+     */
+    static void detach(UARTController controller, UARTConnection *connection);
+
+    /**
+     * @brief Service the interrupt of a controller.
+     *
+     * Called from the USART interrupt handlers, or directly from tests to simulate an interrupt.
+     *
+     * @param controller Controller that raised the interrupt.
+     */
+    static void dispatch(UARTController controller);
+
+    /**
+     * @brief Notify a listener after every interrupt serviced by a connection.
+     *
+     * A single listener per controller, a listener never replaces another one. It is removed when the connection is
+     * detached. Only connections raising interrupts notify their listener, e.g. not a HardwareUART in polling mode.
+     *
+     * @param connection Connection, attached to a controller.
+     * @param listener Listener.
+     * @return true Listening.
+     * @return false The connection is not attached to any controller, or another listener listens to it.
+     */
+    static bool listen(UARTConnection *connection, InterruptListener *listener);
+
+    /**
+     * @brief Stop notifying a listener.
+     *
+     * @param listener Listener.
+     */
+    static void unlisten(InterruptListener *listener);
+
+    /**
+     * @brief Take the set of controllers that raised an interrupt since the last call.
+     *
+     * @return uint32_t Bit mask, bit n is set if UARTController n raised an interrupt.
+     */
+    static uint32_t takePending();
+
+    /**
+     * @brief Sleep until the next interrupt, unless one has been raised since the last call to takePending().
+     *
+     * Interrupts are masked while checking, so an interrupt arriving just before going to sleep still wakes the processor.
+     *
+     * @return true Returned after an interrupt, or right away as one was pending.
+     * @return false Cannot sleep on this target, returned right away.
+     */
+    static bool waitForInterrupt();
+
+  private:
+    /**
+     * @brief Connection attached to each controller, indexed by UARTController.
+     *
+     */
+    static UARTConnection *volatile connections[3];
+
+    /**
+     * @brief Listener of each controller, indexed by UARTController.
+     *
+     */
+    static InterruptListener *volatile listeners[3];
+
+    /**
+     * @brief Controllers that raised an interrupt, see takePending().
+     *
+     */
+    static volatile uint32_t pending;
+};
+
+} // namespace UARTLib
+
+#endif
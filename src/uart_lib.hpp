@@ -1,14 +1,37 @@
 #ifndef UART_LIB
 #define UART_LIB
 
-#ifdef BMPTK_TARGET_arduino_due
+#if defined(BMPTK_TARGET_arduino_due) || defined(BMPTK_TARGET_test)
 
-///< Include dependencies
+///< Include dependencies, host builds run them against simulated registers
+#include "hardware_backend.hpp"
 #include "hardware_uart.hpp"
 
 #endif
 
+#ifdef BMPTK_TARGET_test
+
+///< Host only
+#include "posix_serial_uart.hpp"
+#include "simulated_sam3x.hpp"
+
+#endif
+
+#include "async_uart.hpp"
+#include "basic_uart.hpp"
+#include "baud_rate.hpp"
+#include "block_pool.hpp"
+#include "buffered_output.hpp"
+#include "crc.hpp"
+#include "frame_index.hpp"
+#include "framing.hpp"
+#include "link_statistics.hpp"
+#include "message_transmitter.hpp"
+#include "mock_backend.hpp"
 #include "mock_uart.hpp"
+#include "serializer.hpp"
 #include "uart_connection.hpp"
+#include "uart_interrupt.hpp"
+#include "uart_poller.hpp"
 
 #endif
\ No newline at end of file
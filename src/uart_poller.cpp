@@ -0,0 +1,87 @@
+#include "uart_poller.hpp"
+#include "uart_interrupt.hpp"
+
+namespace UARTLib {
+
+constexpr size_t UARTPoller::maxConnections;
+
+UARTPoller::UARTPoller() : entries{}, count(0), start(0) {
+}
+
+bool UARTPoller::add(UARTConnection &connection, uint8_t events) {
+    for (size_t i = 0; i < count; i++) {
+        if (entries[i].connection == &connection) {
+            entries[i].events = events;
+            return true;
+        }
+    }
+
+    if (count == maxConnections) {
+        return false;
+    }
+
+    entries[count++] = {&connection, events};
+
+    return true;
+}
+
+void UARTPoller::remove(UARTConnection &connection) {
+    for (size_t i = 0; i < count; i++) {
+        if (entries[i].connection == &connection) {
+            entries[i] = entries[--count];
+            start = 0;
+            return;
+        }
+    }
+}
+
+size_t UARTPoller::size() const {
+    return count;
+}
+
+size_t UARTPoller::poll(PollResult *results, size_t maxResults) {
+    size_t found = 0;
+
+    for (size_t n = 0; n < count && found < maxResults; n++) {
+        const Entry &entry = entries[(start + n) % count];
+        uint8_t ready = readyEvents(entry);
+
+        if (ready != 0) {
+            results[found++] = {entry.connection, ready};
+        }
+    }
+
+    if (count > 0) {
+        start = (start + 1) % count;
+    }
+
+    return found;
+}
+
+size_t UARTPoller::wait(PollResult *results, size_t maxResults) {
+    while (true) {
+        ///< Taken before polling, an interrupt raised while polling makes the next sleep return right away.
+        InterruptRouter::takePending();
+
+        size_t found = poll(results, maxResults);
+        if (found > 0 || count == 0 || !InterruptRouter::waitForInterrupt()) {
+            return found;
+        }
+    }
+}
+
+uint8_t UARTPoller::readyEvents(const Entry &entry) {
+    uint8_t ready = 0;
+
+    if ((entry.events & pollReadable) != 0 && entry.connection->available() > 0) {
+        ready |= pollReadable;
+    }
+
+    if ((entry.events & pollWritable) != 0 && entry.connection->txFree() > 0) {
+        ready |= pollWritable;
+    }
+
+    return ready;
+}
+
+} // namespace UARTLib
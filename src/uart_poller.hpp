@@ -0,0 +1,125 @@
+/**
+ * @file
+ * @brief     Waits on several UART connections at once, like select() or epoll.
+ * @author    Wiebe van Breukelen
+ * @license   See LICENSE
+ */
+
+#ifndef UART_POLLER_HPP
+#define UART_POLLER_HPP
+
+#include "uart_connection.hpp"
+#include "wrap-hwlib.hpp"
+
+namespace UARTLib {
+
+/**
+ * @brief Poll event: received bytes are waiting, receive() will not wait.
+ *
+ */
+constexpr uint8_t pollReadable = 1;
+
+/**
+ * @brief Poll event: bytes can be sent, trySend() accepts at least one byte.
+ *
+ */
+constexpr uint8_t pollWritable = 2;
+
+/**
+ * @brief Connection that is ready, as reported by UARTPoller.
+ *
+ */
+struct PollResult {
+    UARTConnection *connection;
+    uint8_t events; ///< Ready events, pollReadable and/or pollWritable.
+};
+
+/**
+ * @brief Services several connections (e.g. USART ONE, TWO and THREE) from one loop.
+ *
+ * Connections are registered with the events they are interested in. poll() reports the connections that are ready, without
+ * waiting. wait() puts the processor to sleep until an USART interrupt makes one of them ready, so idle connections cost no
+ * processor time. This needs connections using interrupt (or DMA) transfers, a connection in polling mode raises no interrupts
+ * and only becomes ready while another one wakes the processor.
+ *
+ * Ready connections are reported starting at a rotating position, so a busy connection cannot starve the others when the
+ * result array is small.
+ */
+class UARTPoller {
+  public:
+    /**
+     * @brief Most connections that can be registered.
+     *
+     */
+    static constexpr size_t maxConnections = 8;
+
+    UARTPoller();
+
+    /**
+     * @brief Register a connection, or change the events of a registered one.
+     *
+     * @param connection Connection.
+     * @param events Events of interest, pollReadable and/or pollWritable.
+     * @return true Registered.
+     * @return false Too many connections registered.
+     */
+    bool add(UARTConnection &connection, uint8_t events);
+
+    /**
+     * @brief Unregister a connection.
+     *
+     * @param connection Connection.
+     */
+    void remove(UARTConnection &connection);
+
+    /**
+     * @brief Get the amount of registered connections.
+     *
+     * @return size_t Amount of registered connections.
+     */
+    size_t size() const;
+
+    /**
+     * @brief Report the connections that are ready, without waiting.
+     *
+     * @param results Array receiving the ready connections.
+     * @param maxResults Length of array.
+     * @return size_t Amount of ready connections reported.
+     */
+    size_t poll(PollResult *results, size_t maxResults);
+
+    /**
+     * @brief Report the connections that are ready, sleeping until an interrupt when none are.
+     *
+     * On targets that cannot sleep (the host), this returns after a single poll().
+     *
+     * @param results Array receiving the ready connections.
+     * @param maxResults Length of array.
+     * @return size_t Amount of ready connections reported.
+     */
+    size_t wait(PollResult *results, size_t maxResults);
+
+  private:
+    struct Entry {
+        UARTConnection *connection;
+        uint8_t events;
+    };
+
+    Entry entries[maxConnections];
+    size_t count;
+
+    ///< Entry the next poll starts at.
+    size_t start;
+
+    /**
+     * @brief Check which events of interest a connection is ready for.
+     *
+     * @param entry Registered connection.
+     * @return uint8_t Ready events.
+     */
+    static uint8_t readyEvents(const Entry &entry);
+};
+
+} // namespace UARTLib
+
+#endif
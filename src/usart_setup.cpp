@@ -0,0 +1,91 @@
+#include "usart_setup.hpp"
+
+namespace UARTLib {
+
+Usart *setupUSART(UARTController controller, const BaudRateConfig &baudRate) {
+    Usart *usart;
+
+    ///< Setup the correct USART controller.
+    if (controller == UARTController::ONE) {
+        usart = USART0;
+
+        ///< Disable PIO control on PA10, PA11 and set up for peripheral A.
+        PIOA->PIO_PDR = PIO_PA10;
+        PIOA->PIO_ABSR &= ~PIO_PA10;
+        PIOA->PIO_PDR = PIO_PA11;
+        PIOA->PIO_ABSR &= ~PIO_PA11;
+
+        ///< Enable the clock to USART0.
+        PMC->PMC_PCER0 = (0x01 << ID_USART0);
+    } else if (controller == UARTController::TWO) {
+        usart = USART1;
+
+        ///< Disable PIO control on PA12, PA13 and set up for peripheral A.
+        PIOA->PIO_PDR = PIO_PA12;
+        PIOA->PIO_ABSR &= ~PIO_PA12;
+        PIOA->PIO_PDR = PIO_PA13;
+        PIOA->PIO_ABSR &= ~PIO_PA13;
+
+        ///< Enable the clock to USART1.
+        PMC->PMC_PCER0 = (0x01 << ID_USART1);
+    } else {
+        usart = USART3;
+
+        ///< Disable PIO control on PD4, PD5 and set up for peripheral B (setting a high bit).
+        ///< Section 31.7.24 -
+        ///< http://ww1.microchip.com/downloads/en/DeviceDoc/Atmel-11057-32-bit-Cortex-M3-Microcontroller-SAM3X-SAM3A_Datasheet.pdf
+        PIOD->PIO_PDR = PIO_PD4;
+        PIOD->PIO_ABSR |= PIO_PD4;
+        PIOD->PIO_PDR = PIO_PD5;
+        PIOD->PIO_ABSR |= PIO_PD5;
+
+        ///< Enable the clock to USART3.
+        PMC->PMC_PCER0 = (0x01 << ID_USART3);
+    }
+
+    ///< Set the control register to reset and disable the receiver and transmitter, to make changes.
+    usart->US_CR = UART_CR_RSTRX | UART_CR_RSTTX | UART_CR_RXDIS | UART_CR_TXDIS;
+
+    ///< Set the baudrate using the clock divider and its fractional part. see page 825
+    usart->US_BRGR = US_BRGR_CD(baudRate.cd) | US_BRGR_FP(baudRate.fp);
+
+    ///< No parity, normal channel mode. Use a 8 bit data field, and 8x oversampling when the baudrate requires it.
+    usart->US_MR = UART_MR_PAR_NO | UART_MR_CHMODE_NORMAL | US_MR_CHRL_8_BIT | (baudRate.over ? US_MR_OVER : 0);
+
+    ///< Disable the interrupt controller.
+    usart->US_IDR = 0xFFFFFFFF;
+
+    return usart;
+}
+
+Pio *setupHandshaking(Usart *usart, UARTController controller, bool enable, uint32_t &rtsMask) {
+    Pio *pio;
+    uint32_t ctsMask;
+
+    if (controller == UARTController::ONE) {
+        pio = PIOB;
+        rtsMask = PIO_PB25;
+        ctsMask = PIO_PB26;
+    } else if (controller == UARTController::TWO) {
+        pio = PIOA;
+        rtsMask = PIO_PA14;
+        ctsMask = PIO_PA15;
+    } else {
+        ///< RTS3 and CTS3 are on PIOF, which the Arduino Due does not have.
+        return nullptr;
+    }
+
+    if (enable) {
+        ///< Disable PIO control on CTS and set up for peripheral A.
+        pio->PIO_PDR = ctsMask;
+        pio->PIO_ABSR &= ~ctsMask;
+    } else {
+        pio->PIO_PER = ctsMask;
+    }
+
+    usart->US_MR = (usart->US_MR & ~US_MR_USART_MODE_Msk) | (enable ? US_MR_USART_MODE_HW_HANDSHAKING : US_MR_USART_MODE_NORMAL);
+
+    return pio;
+}
+
+} // namespace UARTLib
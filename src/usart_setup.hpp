@@ -0,0 +1,55 @@
+/**
+ * @file
+ * @brief     Low level set up of the USART controllers located on the Arduino Due.
+ * @author    Wiebe van Breukelen
+ * @license   See LICENSE
+ */
+
+#ifndef USART_SETUP_HPP
+#define USART_SETUP_HPP
+
+#include "baud_rate.hpp"
+#include "uart_connection.hpp"
+#include "wrap-hwlib.hpp"
+
+#ifdef BMPTK_TARGET_test
+///< Host builds run against simulated registers.
+#include "simulated_sam3x.hpp"
+#endif
+
+namespace UARTLib {
+
+/**
+ * @brief Set up the pins, clock, baudrate and frame format of a USART controller.
+ *
+ * The controller is left with its receiver and transmitter disabled and all interrupts masked, so the caller can finish the
+ * configuration before enabling it. Shared by HardwareUART and HardwareBackend.
+ *
+ * @param controller Controller to set up.
+ * @param baudRate Baudrate generator settings, see computeBaudRate() and BaudRate.
+ * @return Usart* Register block of the controller.
+ */
+Usart *setupUSART(UARTController controller, const BaudRateConfig &baudRate);
+
+/**
+ * @brief Switch a USART controller between normal mode and hardware handshaking mode.
+ *
+ * In hardware handshaking mode, the CTS pin is handed to the controller, which holds back the transmitter while CTS is high.
+ * The RTS pin is left to the caller, see RtsLine. Pins on the Arduino Due:
+ * One   - RTS0 PB25 (pin 2), CTS0 PB26 (pin 22)
+ * Two   - RTS1 PA14 (pin 23), CTS1 PA15 (pin 24)
+ * Three - No RTS and CTS pins, hardware handshaking is not available.
+ *
+ * Call this while the receiver and transmitter are disabled.
+ *
+ * @param usart Register block of the controller.
+ * @param controller Controller to set up.
+ * @param enable Hardware handshaking instead of normal mode.
+ * @param rtsMask Set to the mask of the RTS pin.
+ * @return Pio* PIO controller of the RTS pin, nullptr when hardware handshaking is not available.
+ */
+Pio *setupHandshaking(Usart *usart, UARTController controller, bool enable, uint32_t &rtsMask);
+
+} // namespace UARTLib
+
+#endif
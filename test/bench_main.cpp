@@ -0,0 +1,358 @@
+/**
+ * @file
+ * @brief     Host benchmarks of the UART data path.
+ *
+ * Measures nanoseconds per operation and bytes per second of the queue, the MockUART send and receive paths, messages sent
+ * from pool blocks, the hwlib stream interface (also through BasicUART, without virtual calls), framing, CRC calculation, a
+ * pseudo-terminal pair through the kernel and HardwareUART running against the simulated SAM3X registers. Results are
+ * written to stdout as CSV, or as JSON when started with --json, so they can be compared between releases.
+ * @author    Wiebe van Breukelen
+ * @license   See LICENSE
+ */
+
+#include "uart_lib.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+/**
+ * @brief Record encoded by the schema benchmark.
+ *
+ */
+struct Reading {
+    uint16_t id;
+    int32_t value;
+    uint32_t timestamp;
+};
+
+typedef UARTLib::Schema<Reading, UARTLib::LittleEndian<Reading, uint16_t, &Reading::id>,
+                        UARTLib::Varint<Reading, int32_t, &Reading::value>,
+                        UARTLib::LittleEndian<Reading, uint32_t, &Reading::timestamp>>
+    ReadingSchema;
+
+/**
+ * @brief Size of a block of data moved per operation in the bulk benchmarks, fits every buffer of the MockUART.
+ *
+ */
+constexpr size_t blockSize = 255;
+
+/**
+ * @brief Amount of bytes moved per benchmark, after warming up.
+ *
+ */
+constexpr size_t benchBytes = 4 * 1024 * 1024;
+
+/**
+ * @brief Result of a single benchmark.
+ *
+ */
+struct BenchResult {
+    const char *name;
+    size_t operations;
+    size_t bytes;
+    double nanoseconds;
+};
+
+/**
+ * @brief Sink for benchmark results, so the compiler cannot remove the measured work.
+ *
+ */
+volatile uint32_t sink;
+
+/**
+ * @brief Run a benchmark.
+ *
+ * The body is run once to warm up, then repeated until benchBytes bytes have been moved.
+ *
+ * @tparam Body Callable moving bytesPerRun bytes in operationsPerRun operations.
+ * @param name Benchmark name.
+ * @param operationsPerRun Operations performed by a single run of body.
+ * @param bytesPerRun Bytes moved by a single run of body.
+ * @param body Benchmark body.
+ * @return BenchResult Result.
+ */
+template <class Body>
+BenchResult run(const char *name, size_t operationsPerRun, size_t bytesPerRun, Body body) {
+    size_t runs = benchBytes / bytesPerRun;
+
+    body();
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < runs; i++) {
+        body();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    return BenchResult{name, runs * operationsPerRun, runs * bytesPerRun,
+                       static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count())};
+}
+
+/**
+ * @brief Drain the bytes a MockUART has captured, so it does not drop the next ones.
+ *
+ * @param uart MockUART.
+ */
+void drain(UARTLib::MockUART &uart) {
+    uint8_t buf[blockSize];
+    while (uart.readTransmitted(buf, sizeof(buf)) > 0) {
+        sink = sink + buf[0];
+    }
+}
+
+/**
+ * @brief Send bytes one by one through the virtual interface. Not inlined, so the calls cannot be devirtualized.
+ *
+ * @param connection Connection.
+ * @param data Bytes to send.
+ * @param length Amount of bytes.
+ */
+__attribute__((noinline)) void putcVirtual(UARTLib::UARTConnection &connection, const uint8_t *data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        connection.putc(static_cast<char>(data[i]));
+    }
+}
+
+void printCsv(const BenchResult *results, size_t count) {
+    std::printf("benchmark,operations,bytes,ns_per_op,bytes_per_second\n");
+
+    for (size_t i = 0; i < count; i++) {
+        const BenchResult &r = results[i];
+        std::printf("%s,%zu,%zu,%.3f,%.0f\n", r.name, r.operations, r.bytes, r.nanoseconds / r.operations,
+                    r.bytes * 1e9 / r.nanoseconds);
+    }
+}
+
+void printJson(const BenchResult *results, size_t count) {
+    std::printf("[\n");
+
+    for (size_t i = 0; i < count; i++) {
+        const BenchResult &r = results[i];
+        std::printf("  {\"benchmark\": \"%s\", \"operations\": %zu, \"bytes\": %zu, "
+                    "\"ns_per_op\": %.3f, \"bytes_per_second\": %.0f}%s\n",
+                    r.name, r.operations, r.bytes, r.nanoseconds / r.operations, r.bytes * 1e9 / r.nanoseconds,
+                    i + 1 < count ? "," : "");
+    }
+
+    std::printf("]\n");
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    bool json = argc > 1 && std::strcmp(argv[1], "--json") == 0;
+
+    uint8_t block[blockSize];
+    for (size_t i = 0; i < blockSize; i++) {
+        block[i] = static_cast<uint8_t>('A' + i % 26);
+    }
+
+    ///< Lines of 51 bytes, arriving in parts of 15 bytes in the read_until benchmark.
+    uint8_t lines[blockSize];
+    for (size_t i = 0; i < blockSize; i++) {
+        lines[i] = i % 51 == 50 ? '\n' : block[i];
+    }
+
+    uint8_t crcBlock[1024];
+    for (size_t i = 0; i < sizeof(crcBlock); i++) {
+        crcBlock[i] = static_cast<uint8_t>(i * 31);
+    }
+
+    uint8_t received[blockSize];
+    Queue<uint8_t, 256> queue;
+    UARTLib::MockUART uart(115200);
+
+    ///< Operations through the UARTConnection and hwlib interfaces, as users of the library would call them.
+    UARTLib::UARTConnection &connection = uart;
+    hwlib::ostream &out = uart;
+    UARTLib::BufferedOutput<64> buffered(uart);
+
+    ///< The same putc() without virtual calls, resolved at compile time.
+    UARTLib::BasicUART<UARTLib::MockBackend> basic(115200);
+
+    ///< Messages filled in place in pool blocks, queued by reference in the pool_message_send benchmark.
+    UARTLib::BlockPool<blockSize, 4> pool;
+    UARTLib::MessageTransmitter transmitter(uart);
+    for (size_t i = 0; i < 4; i++) {
+        uint8_t *message = pool.allocate();
+        std::memcpy(message, block, blockSize);
+        pool.release(message);
+    }
+
+    UARTLib::MockUART cooperative(115200, UARTLib::UARTController::TWO);
+    cooperative.setReceiveMode(UARTLib::TransferMode::COOPERATIVE);
+    cooperative.setTransmitMode(UARTLib::TransferMode::COOPERATIVE);
+
+    Reading reading = {1, 4000, 123456};
+    uint8_t encoded[ReadingSchema::maxEncodedLength];
+
+    ///< Both ends of a pseudo-terminal, to measure what the kernel tty layer moves. Skipped where none can be opened.
+    int ptyFirst = -1;
+    int ptySecond = -1;
+    bool havePty = UARTLib::openPseudoTerminal(ptyFirst, ptySecond);
+    if (!havePty) {
+        std::fprintf(stderr, "Cannot open a pseudo-terminal, skipping pty_send_receive\n");
+    }
+
+    ///< HardwareUART looping back through simulated registers, measuring the cost of the simulation.
+    UARTLib::SimulatedSam3x::reset();
+    UARTLib::HardwareUART simulated(921600);
+    simulated.setReceiveMode(UARTLib::TransferMode::INTERRUPT);
+    simulated.setTransmitMode(UARTLib::TransferMode::INTERRUPT);
+    USART0->connect(USART0);
+
+    UARTLib::PosixSerialUART ptySender(ptyFirst, 115200);
+    UARTLib::PosixSerialUART ptyReceiver(ptySecond, 115200);
+    uint8_t ptyBlock[4096] = {};
+    uint8_t ptyReceived[sizeof(ptyBlock)];
+
+    const BenchResult results[] = {
+        run("queue_push_pop", 2 * blockSize, blockSize,
+            [&] {
+                for (size_t i = 0; i < blockSize; i++) {
+                    queue.push(block[i]);
+                }
+                for (size_t i = 0; i < blockSize; i++) {
+                    sink = sink + queue.pop();
+                }
+            }),
+        run("queue_bulk_pop", 1, blockSize,
+            [&] {
+                for (size_t i = 0; i < blockSize; i++) {
+                    queue.push(block[i]);
+                }
+                sink = sink + queue.pop(received, blockSize);
+            }),
+        run("mock_send_byte", blockSize, blockSize,
+            [&] {
+                for (size_t i = 0; i < blockSize; i++) {
+                    uart.send(block[i]);
+                }
+                drain(uart);
+            }),
+        run("mock_send_bulk", 1, blockSize,
+            [&] {
+                uart.send(block, blockSize);
+                drain(uart);
+            }),
+        run("pool_message_send", 1, blockSize,
+            [&] {
+                transmitter.send(pool.allocate(), blockSize, pool);
+                drain(uart);
+            }),
+        run("mock_receive_byte", blockSize, blockSize,
+            [&] {
+                uart.inject(block, blockSize);
+                while (uart.available() > 0) {
+                    sink = sink + uart.receive();
+                }
+            }),
+        run("mock_receive_bulk", 1, blockSize,
+            [&] {
+                uart.inject(block, blockSize);
+                uart.available();
+                sink = sink + uart.receive(received, blockSize);
+            }),
+        run("read_until", 1, blockSize,
+            [&] {
+                for (size_t i = 0; i < blockSize; i += 15) {
+                    uart.inject(lines + i, 15);
+                    while (connection.readUntil('\n', received, blockSize) > 0) {
+                        sink = sink + received[0];
+                    }
+                }
+            }),
+        run("ostream_operator", 1, 13,
+            [&] {
+                out << "Hello World!\n";
+                drain(uart);
+            }),
+        run("cobs_send_frame", 1, blockSize,
+            [&] {
+                UARTLib::sendCobsFrame(uart, block, blockSize);
+                drain(uart);
+            }),
+        run("crc8", 1, sizeof(crcBlock), [&] { sink = sink + UARTLib::Crc8::compute(crcBlock, sizeof(crcBlock)); }),
+        run("crc16", 1, sizeof(crcBlock), [&] { sink = sink + UARTLib::Crc16::compute(crcBlock, sizeof(crcBlock)); }),
+        run("crc32", 1, sizeof(crcBlock), [&] { sink = sink + UARTLib::Crc32::compute(crcBlock, sizeof(crcBlock)); }),
+        run("crc32_slicing_by_4", 1, sizeof(crcBlock),
+            [&] { sink = sink + UARTLib::Crc32Slicing::compute(crcBlock, sizeof(crcBlock)); }),
+        run("putc", blockSize, blockSize,
+            [&] {
+                putcVirtual(connection, block, blockSize);
+                drain(uart);
+            }),
+        run("basic_uart_putc", blockSize, blockSize,
+            [&] {
+                ///< Every byte is written, like to a register, instead of folding the loop into a single update.
+                for (size_t i = 0; i < blockSize; i++) {
+                    basic.putc(static_cast<char>(block[i]));
+                    asm volatile("" ::: "memory");
+                }
+                sink = sink + basic.getBackend().lastByte;
+            }),
+        run("getc", blockSize, blockSize,
+            [&] {
+                uart.inject(block, blockSize);
+                while (connection.char_available()) {
+                    sink = sink + connection.getc();
+                }
+            }),
+        run("buffered_ostream", 1, 13,
+            [&] {
+                buffered << "Hello World!\n";
+                drain(uart);
+            }),
+        run("schema_encode", 1, 9,
+            [&] {
+                reading.value++;
+                sink = sink + ReadingSchema::encode(reading, encoded);
+            }),
+        run("schema_decode", 1, 9,
+            [&] {
+                size_t used;
+                ReadingSchema::decode(reading, encoded, sizeof(encoded), used);
+                sink = sink + used;
+            }),
+        run("cooperative_service", 1, 32,
+            [&] {
+                cooperative.inject(block, 16);
+                cooperative.trySend(block, 16);
+                cooperative.service(16);
+                cooperative.consume(16);
+                drain(cooperative);
+            }),
+        run("simulated_loopback", 1, blockSize,
+            [&] {
+                simulated.trySend(block, blockSize);
+                simulated.flush();
+                sink = sink + simulated.receive(received, blockSize);
+            }),
+    };
+
+    BenchResult all[sizeof(results) / sizeof(results[0]) + 1];
+    size_t count = 0;
+    for (const BenchResult &result : results) {
+        all[count++] = result;
+    }
+
+    if (havePty) {
+        all[count++] = run("pty_send_receive", 1, sizeof(ptyBlock), [&] {
+            ptySender.send(ptyBlock, sizeof(ptyBlock));
+            for (size_t got = 0; got < sizeof(ptyBlock) && ptyReceiver.waitReadable(1000);) {
+                got += ptyReceiver.receive(ptyReceived + got, sizeof(ptyReceived) - got);
+            }
+            sink = sink + ptyReceived[0];
+        });
+    }
+
+    if (json) {
+        printJson(all, count);
+    } else {
+        printCsv(all, count);
+    }
+
+    return 0;
+}
@@ -1,7 +1,80 @@
 #define CATCH_CONFIG_MAIN  // This tells Catch to provide a main() - only do this in one cpp file
 #include "catch.hpp"
+#include "dma_frame_receiver.hpp"
+#include "pdc_channel.hpp"
+#include "rts_line.hpp"
 #include "uart_lib.hpp"
 
+#include <algorithm>
+
+/**
+ * @brief Register model of the PDC and receiver timeout registers of a USART controller.
+ *
+ */
+struct PdcRegisterModel {
+    uintptr_t US_TPR, US_TCR, US_TNPR, US_TNCR, US_RPR, US_RCR, US_RNPR, US_RNCR;
+    uint32_t US_PTCR, US_CR, US_IER, US_IDR, US_RTOR;
+    bool endOfReceive;
+
+    ///< What the PDC does when the current transmit counter reaches zero.
+    void completeCurrent() {
+        US_TPR = US_TNPR;
+        US_TCR = US_TNCR;
+        US_TNCR = 0;
+    }
+
+    ///< What the PDC does when a byte is received. Returns false when the byte is lost.
+    bool receive(uint8_t b) {
+        if (US_RCR == 0) {
+            return false;
+        }
+
+        *reinterpret_cast<uint8_t *>(US_RPR++) = b;
+
+        if (--US_RCR == 0) {
+            endOfReceive = true;
+            US_RPR = US_RNPR;
+            US_RCR = US_RNCR;
+            US_RNCR = 0;
+        }
+
+        return true;
+    }
+
+    void receive(const char *str, UARTLib::DmaFrameReceiver<PdcRegisterModel> &receiver) {
+        for (; *str != '\0'; str++) {
+            receive(*str);
+
+            if (endOfReceive) {
+                endOfReceive = false;
+                receiver.onEndOfBuffer(*this);
+            }
+        }
+    }
+};
+
+/**
+ * @brief Register model of a PIO controller, tracking the level of its output pins.
+ *
+ */
+struct PioRegisterModel {
+    ///< Writing a mask sets or clears those pins in the output data status.
+    struct OutputWrite {
+        uint32_t &outputs;
+        bool level;
+
+        void operator=(uint32_t mask) {
+            outputs = level ? outputs | mask : outputs & ~mask;
+        }
+    };
+
+    uint32_t PIO_ODSR = 0;
+    uint32_t PIO_PER = 0;
+    uint32_t PIO_OER = 0;
+    OutputWrite PIO_SODR{PIO_ODSR, true};
+    OutputWrite PIO_CODR{PIO_ODSR, false};
+};
+
 TEST_CASE("Construct MockUART instance") {
     UARTLib::MockUART uart(115200, UARTLib::UARTController::THREE, false);
 
@@ -11,12 +84,1696 @@ TEST_CASE("Construct MockUART instance") {
     uart.begin();
 
     REQUIRE(uart.isInitialized());
-    
-    REQUIRE(uart.available() == 1);
+    REQUIRE(uart.available() == 0);
+
+    uart.inject("\xAA\x55");
     REQUIRE(uart.available() == 2);
 
     REQUIRE(uart.receive() == 0xAA);
-    REQUIRE(uart.receive() == 0xAA);
+    REQUIRE(uart.receive() == 0x55);
 
     REQUIRE(uart.receive() == 0);
 }
+
+
+TEST_CASE("Queue wraps around and keeps one slot free") {
+    Queue<uint8_t, 4> queue;
+
+    static_assert(sizeof(Queue<uint8_t, 256>::index_type) == 1, "256 entries are indexed using 8 bits");
+    static_assert(sizeof(Queue<uint8_t, 512>::index_type) == 2, "512 entries are indexed using 16 bits");
+
+    REQUIRE(queue.capacity() == 3);
+
+    for (uint8_t round = 0; round < 5; round++) {
+        REQUIRE(queue.push(round));
+        REQUIRE(queue.push(round + 1));
+        REQUIRE(queue.push(round + 2));
+        REQUIRE(!queue.push(0xFF));
+        REQUIRE(queue.count() == 3);
+
+        REQUIRE(queue.peek() == round);
+        REQUIRE(queue.pop() == round);
+        REQUIRE(queue.pop() == round + 1);
+        REQUIRE(queue.pop() == round + 2);
+        REQUIRE(queue.count() == 0);
+        REQUIRE(queue.pop() == 0);
+
+        ///< Shift the indices, so every round starts at another slot.
+        queue.push(0);
+        queue.pop();
+    }
+}
+
+TEST_CASE("Queue over storage provided by its owner") {
+    uint16_t storage[4];
+    Queue<uint16_t, 0> queue(storage);
+    uint16_t items[4];
+
+    REQUIRE(queue.capacity() == 3);
+
+    ///< Every round starts at another slot, so the items wrap around the end of the storage.
+    for (uint16_t round = 0; round < 5; round++) {
+        REQUIRE(queue.push(round * 1000));
+        REQUIRE(queue.push(round * 1000 + 1));
+        REQUIRE(queue.push(round * 1000 + 2));
+        REQUIRE(!queue.push(0xFFFF));
+
+        REQUIRE(queue.pop() == round * 1000);
+        REQUIRE(queue.pop(items, 4) == 2);
+        REQUIRE(items[0] == round * 1000 + 1);
+        REQUIRE(items[1] == round * 1000 + 2);
+        REQUIRE(queue.count() == 0);
+    }
+}
+
+TEST_CASE("Queue bulk and zero-copy access") {
+    Queue<uint8_t, 8> queue;
+    const uint8_t *first, *second;
+    size_t firstLength, secondLength;
+    uint8_t items[8];
+
+    ///< Move the indices close to the end of the storage.
+    for (uint8_t i = 0; i < 6; i++) {
+        queue.push(0);
+    }
+    queue.drop(6);
+
+    for (uint8_t i = 1; i <= 5; i++) {
+        queue.push(i);
+    }
+
+    ///< Five items, wrapping around after the second one.
+    REQUIRE(queue.peekRegions(first, firstLength, second, secondLength) == 5);
+    REQUIRE(firstLength == 2);
+    REQUIRE(first[0] == 1);
+    REQUIRE(secondLength == 3);
+    REQUIRE(second[0] == 3);
+
+    REQUIRE(queue.pop(items, 4) == 4);
+    REQUIRE(items[0] == 1);
+    REQUIRE(items[3] == 4);
+    REQUIRE(queue.pop(items, 8) == 1);
+    REQUIRE(items[0] == 5);
+    REQUIRE(queue.pop(items, 8) == 0);
+}
+
+TEST_CASE("MockUART bulk receive") {
+    UARTLib::MockUART uart(115200);
+    UARTLib::ByteSpan first, second;
+    uint8_t buf[4];
+
+    REQUIRE(uart.readableSpans(first, second) == 0);
+
+    uart.inject("abcdef");
+    uart.available();
+
+    REQUIRE(uart.readableSpans(first, second) == 6);
+    REQUIRE(first.length == 6);
+    REQUIRE(first.data[5] == 'f');
+    REQUIRE(second.length == 0);
+
+    uart.consume(1);
+    REQUIRE(uart.receive(buf, sizeof(buf)) == 4);
+    REQUIRE(buf[0] == 'b');
+    REQUIRE(buf[3] == 'e');
+    REQUIRE(uart.receive(buf, sizeof(buf)) == 1);
+    REQUIRE(uart.receive(buf, sizeof(buf)) == 0);
+}
+
+TEST_CASE("MockUART interrupt driven receive") {
+    UARTLib::MockUART uart(115200, UARTLib::UARTController::TWO);
+
+    uart.setReceiveMode(UARTLib::TransferMode::INTERRUPT);
+
+    ///< No interrupt, no data.
+    uart.inject("\xAA\x55");
+    REQUIRE(uart.available() == 0);
+
+    ///< Interrupts of other controllers are not routed to this connection.
+    UARTLib::InterruptRouter::dispatch(UARTLib::UARTController::ONE);
+    REQUIRE(uart.available() == 0);
+
+    UARTLib::InterruptRouter::dispatch(UARTLib::UARTController::TWO);
+
+    REQUIRE(uart.available() == 2);
+    REQUIRE(uart.receive() == 0xAA);
+    REQUIRE(uart.available() == 1);
+}
+
+TEST_CASE("MockUART interrupt driven transmit") {
+    UARTLib::MockUART uart(115200, UARTLib::UARTController::ONE);
+    uint8_t data[300] = {};
+
+    uart.setTransmitMode(UARTLib::TransferMode::INTERRUPT);
+
+    ///< The transmit buffer only accepts what fits.
+    REQUIRE(uart.trySend(data, 300) == 255);
+    REQUIRE(uart.txPending() == 255);
+
+    ///< Sending every byte makes room by transmitting the oldest ones, as there is no interrupt handler.
+    REQUIRE(uart.send(data, 10));
+    REQUIRE(uart.txPending() == 255);
+    REQUIRE(uart.txCaptured() == 10);
+
+    ///< Every interrupt moves a single byte into the transmitter.
+    UARTLib::InterruptRouter::dispatch(UARTLib::UARTController::ONE);
+    REQUIRE(uart.txPending() == 254);
+
+    uart.flush();
+    REQUIRE(uart.txPending() == 0);
+
+    ///< Indices wrap around without running past the end of the buffer.
+    REQUIRE(uart.send(data, 10));
+    REQUIRE(uart.txPending() == 10);
+}
+
+TEST_CASE("MockUART captures, loops back and connects back to back") {
+    UARTLib::MockUART uart(115200, UARTLib::UARTController::ONE);
+    UARTLib::MockUART other(115200, UARTLib::UARTController::TWO);
+    uint8_t buf[8];
+
+    ///< Transmitted bytes are captured.
+    uart << "ping";
+    REQUIRE(uart.txCaptured() == 4);
+    REQUIRE(uart.readTransmitted(buf, sizeof(buf)) == 4);
+    REQUIRE(buf[0] == 'p');
+    REQUIRE(buf[3] == 'g');
+
+    ///< In loopback mode, they are received by the same mock.
+    uart.setLoopback(true);
+    uart.send("abc");
+    REQUIRE(uart.txCaptured() == 0);
+    REQUIRE(uart.available() == 3);
+    REQUIRE(uart.receive(buf, sizeof(buf)) == 3);
+    REQUIRE(buf[2] == 'c');
+    uart.setLoopback(false);
+
+    ///< Back to back, they are received by the other mock, in both directions.
+    uart.connect(other);
+    uart.send("hi");
+    other.send("yo");
+    REQUIRE(other.available() == 2);
+    REQUIRE(other.receive() == 'h');
+    REQUIRE(uart.available() == 2);
+    REQUIRE(uart.receive() == 'y');
+
+    other.disconnect();
+    uart.send("x");
+    REQUIRE(other.available() == 1);
+    REQUIRE(uart.txCaptured() == 1);
+}
+
+TEST_CASE("MockUART link statistics") {
+    UARTLib::MockUART uart(115200, UARTLib::UARTController::THREE);
+    uint8_t data[300] = {};
+
+    uart.send("abc");
+    uart.inject("de");
+    uart.available();
+    uart.injectError(UARTLib::LineError::FRAMING);
+
+    const UARTLib::LinkStatistics &stats = uart.statistics();
+    REQUIRE(stats.bytesSent == 3);
+    REQUIRE(stats.bytesReceived == 2);
+    REQUIRE(stats.rxHighWater == 2);
+    REQUIRE(stats.framingErrors == 1);
+    REQUIRE(stats.overrunErrors == 0);
+
+    ///< An interrupt drains the whole line, the receive buffer holds at most 255 bytes.
+    uart.setReceiveMode(UARTLib::TransferMode::INTERRUPT);
+    uart.inject(data, 300);
+    UARTLib::InterruptRouter::dispatch(UARTLib::UARTController::THREE);
+    REQUIRE(stats.bytesReceived == 302);
+    REQUIRE(stats.rxDropped == 47);
+    REQUIRE(stats.rxHighWater == 255);
+
+    uart.setTransmitMode(UARTLib::TransferMode::INTERRUPT);
+    uart.trySend(data, 10);
+    REQUIRE(stats.txHighWater == 10);
+
+    uart.resetStatistics();
+    REQUIRE(stats.bytesSent == 0);
+    REQUIRE(stats.rxDropped == 0);
+    REQUIRE(stats.txHighWater == 0);
+}
+
+TEST_CASE("MockUART cooperative mode moves bounded amounts") {
+    UARTLib::BufferedMockUART<16, 16> uart(115200);
+    uint8_t buf[16];
+
+    uart.setReceiveMode(UARTLib::TransferMode::COOPERATIVE);
+    uart.setTransmitMode(UARTLib::TransferMode::COOPERATIVE);
+
+    ///< Sending only queues, nothing is transmitted until service().
+    REQUIRE(uart.trySend(reinterpret_cast<const uint8_t *>("abcdefghijklmnopq"), 17) == 15);
+    REQUIRE(uart.txFree() == 0);
+    REQUIRE(uart.txCaptured() == 0);
+
+    ///< A full transmit buffer drops single bytes instead of waiting.
+    uart << "x";
+    REQUIRE(uart.statistics().txDropped == 1);
+
+    ///< Sending an array that does not fit queues nothing, so the caller knows what went out.
+    REQUIRE(!uart.send(reinterpret_cast<const uint8_t *>("xy"), 2));
+    REQUIRE(uart.txPending() == 15);
+
+    ///< Received bytes stay on the line until service(), which moves at most the budget in each direction.
+    uart.inject("123456");
+    REQUIRE(uart.available() == 0);
+
+    REQUIRE(uart.service(4) == 8);
+    REQUIRE(uart.available() == 4);
+    REQUIRE(uart.txCaptured() == 4);
+
+    REQUIRE(uart.service(100) == 2 + 11);
+    REQUIRE(uart.available() == 6);
+    REQUIRE(uart.readTransmitted(buf, sizeof(buf)) == 15);
+    REQUIRE(buf[14] == 'o');
+    REQUIRE(uart.service(100) == 0);
+
+    ///< flush() still waits for everything queued.
+    uart.send(reinterpret_cast<const uint8_t *>("zz"), 2);
+    uart.flush();
+    REQUIRE(uart.txPending() == 0);
+    REQUIRE(uart.txCaptured() == 2);
+}
+
+TEST_CASE("ByteBuffer overwrites the oldest byte when asked to") {
+    uint8_t storage[4];
+    UARTLib::ByteBuffer buffer(storage);
+    uint8_t items[4];
+
+    REQUIRE(buffer.capacity() == 3);
+    REQUIRE(buffer.push(1));
+    REQUIRE(buffer.push(2));
+    REQUIRE(buffer.push(3));
+    REQUIRE(!buffer.push(4));
+
+    ///< Until overwriting is allowed, it drops the new byte like push().
+    REQUIRE(!buffer.pushOverwrite(4));
+    REQUIRE(buffer.peek() == 1);
+
+    buffer.setOverwriting(true);
+    REQUIRE(!buffer.pushOverwrite(4));
+    REQUIRE(buffer.count() == 3);
+    REQUIRE(buffer.pop() == 2);
+    REQUIRE(buffer.pushOverwrite(5));
+    REQUIRE(buffer.pop(items, sizeof(items)) == 3);
+    REQUIRE(items[0] == 3);
+    REQUIRE(items[2] == 5);
+    REQUIRE(buffer.pop() == 0);
+}
+
+TEST_CASE("findByte compares a word at a time") {
+    uint8_t storage[64];
+    const uint8_t values[] = {'\n', 0x00, 0x80, 0xFF};
+
+    ///< Every alignment and length, with the byte at every position and neighbouring values around it.
+    for (uint8_t value : values) {
+        for (size_t offset = 0; offset < 8; offset++) {
+            for (size_t length = 0; length + offset <= sizeof(storage); length += 5) {
+                for (size_t at = 0; at <= length; at++) {
+                    for (size_t i = 0; i < sizeof(storage); i++) {
+                        storage[i] = static_cast<uint8_t>(value + 1 + (i & 1) * 0x7E);
+                    }
+
+                    if (at < length) {
+                        storage[offset + at] = value;
+                    }
+
+                    REQUIRE(UARTLib::findByte(storage + offset, length, value) == at);
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("ByteBuffer remembers how far find() searched") {
+    uint8_t storage[16];
+    UARTLib::ByteBuffer buffer(storage);
+    size_t position;
+
+    for (const char *c = "abc"; *c != '\0'; c++) {
+        buffer.push(*c);
+    }
+
+    REQUIRE(!buffer.find('\n', position));
+
+    ///< Bytes searched already are not searched again, a delimiter slipped into them unnoticed is not found.
+    storage[1] = '\n';
+    REQUIRE(!buffer.find('\n', position));
+
+    ///< Only the new bytes are searched.
+    for (const char *c = "d\nef"; *c != '\0'; c++) {
+        buffer.push(*c);
+    }
+
+    REQUIRE(buffer.find('\n', position));
+    REQUIRE(position == 4);
+    REQUIRE(buffer.find('\n', position));
+    REQUIRE(position == 4);
+
+    ///< Searching for another byte starts at the front, where the 'b' has been replaced.
+    REQUIRE(!buffer.find('b', position));
+    REQUIRE(buffer.find('\n', position));
+    REQUIRE(position == 1);
+
+    ///< Removing bytes keeps the position, also when the bytes wrap around the end of the storage.
+    uint8_t line[8];
+    REQUIRE(buffer.pop(line, 2) == 2);
+    REQUIRE(buffer.find('\n', position));
+    REQUIRE(position == 2);
+    buffer.drop(3);
+    REQUIRE(buffer.pop() == 'e');
+
+    for (const char *c = "0123456789ab"; *c != '\0'; c++) {
+        buffer.push(*c);
+    }
+
+    REQUIRE(!buffer.find('\n', position));
+    buffer.push('\n');
+    REQUIRE(buffer.find('\n', position));
+    REQUIRE(position == 13);
+    REQUIRE(buffer.pop(line, 4) == 4);
+    REQUIRE(buffer.find('\n', position));
+    REQUIRE(position == 9);
+}
+
+TEST_CASE("MockUART readUntil receives lines arriving in parts") {
+    UARTLib::MockUART uart(115200);
+    uint8_t line[8];
+
+    uart.inject("hel");
+    REQUIRE(uart.readUntil('\n', line, sizeof(line)) == 0);
+
+    uart.inject("lo\nwor");
+    REQUIRE(uart.readUntil('\n', line, sizeof(line)) == 6);
+    REQUIRE(std::equal(line, line + 6, "hello\n"));
+    REQUIRE(uart.readUntil('\n', line, sizeof(line)) == 0);
+
+    uart.inject("ld\n");
+    REQUIRE(uart.readUntil('\n', line, sizeof(line)) == 6);
+    REQUIRE(std::equal(line, line + 6, "world\n"));
+
+    ///< A line longer than the array is received in parts, only the last one ends in the delimiter.
+    uart.inject("0123456789\n");
+    REQUIRE(uart.readUntil('\n', line, 4) == 4);
+    REQUIRE(std::equal(line, line + 4, "0123"));
+    REQUIRE(uart.readUntil('\n', line, 4) == 4);
+    REQUIRE(uart.readUntil('\n', line, 4) == 3);
+    REQUIRE(std::equal(line, line + 3, "89\n"));
+    REQUIRE(uart.available() == 0);
+}
+
+TEST_CASE("MockUART indexes frames while receiving") {
+    uint8_t frame[32];
+    UARTLib::FrameDescriptor descriptor;
+
+    ///< Delimited frames include the delimiter, the last frame stays open until its delimiter arrives.
+    UARTLib::MockUART delimited(115200);
+    delimited.setFrameBoundary(UARTLib::FrameBoundary::DELIMITER, '\n');
+    delimited.inject("ab\ncde\nf");
+    REQUIRE(delimited.framesAvailable() == 2);
+    REQUIRE(delimited.nextFrame(descriptor));
+    REQUIRE(descriptor.offset == 0);
+    REQUIRE(descriptor.length == 3);
+    REQUIRE(descriptor.status == UARTLib::FrameStatus::COMPLETE);
+    REQUIRE(delimited.receive(frame, descriptor.length) == 3);
+    REQUIRE(std::equal(frame, frame + 3, "ab\n"));
+    REQUIRE(delimited.nextFrame(descriptor));
+    REQUIRE(descriptor.offset == 3);
+    REQUIRE(descriptor.length == 4);
+    REQUIRE(!delimited.nextFrame(descriptor));
+
+    ///< A two byte little endian header counts the bytes following it.
+    const uint8_t packets[] = {3, 0, 'x', 'y', 'z', 0, 0, 1, 0, 'q'};
+    UARTLib::MockUART headed(115200);
+    headed.setFrameBoundary(UARTLib::FrameBoundary::LENGTH_HEADER, 2);
+    headed.inject(packets, sizeof(packets));
+    REQUIRE(headed.framesAvailable() == 3);
+    REQUIRE(headed.nextFrame(descriptor));
+    REQUIRE(descriptor.length == 5);
+    REQUIRE(headed.nextFrame(descriptor));
+    REQUIRE(descriptor.length == 2);
+    REQUIRE(headed.nextFrame(descriptor));
+    REQUIRE(descriptor.offset == 7);
+    REQUIRE(descriptor.length == 3);
+
+    ///< The mock line goes idle once everything injected has been received.
+    static uint32_t ticks = 0;
+    UARTLib::MockUART idle(115200);
+    idle.setFrameBoundary(UARTLib::FrameBoundary::IDLE);
+    idle.setFrameClock([]() { return ++ticks; });
+    idle.inject("de");
+    idle.inject("f");
+    REQUIRE(idle.framesAvailable() == 1);
+    idle.inject("gh");
+    REQUIRE(idle.framesAvailable() == 2);
+    REQUIRE(idle.nextFrame(descriptor));
+    REQUIRE(descriptor.length == 3);
+    REQUIRE(descriptor.timestamp == 1);
+    REQUIRE(idle.nextFrame(descriptor));
+    REQUIRE(descriptor.length == 2);
+    REQUIRE(descriptor.timestamp == 2);
+
+    ///< Bytes dropped by a full receive buffer are reported, the delimiter still ends the frame.
+    UARTLib::BufferedMockUART<16, 16> full(115200, UARTLib::UARTController::THREE);
+    full.setReceiveMode(UARTLib::TransferMode::INTERRUPT);
+    full.setFrameBoundary(UARTLib::FrameBoundary::DELIMITER, '\n');
+    full.inject("0123456789abcdefghij\n");
+    UARTLib::InterruptRouter::dispatch(UARTLib::UARTController::THREE);
+    REQUIRE(full.nextFrame(descriptor));
+    REQUIRE(descriptor.length == 15);
+    REQUIRE(descriptor.status == UARTLib::FrameStatus::DROPPED_BYTES);
+
+    ///< Frames that do not fit in the ring of descriptors are skipped, the next frame still reads its own bytes.
+    UARTLib::MockUART many(115200);
+    many.setFrameBoundary(UARTLib::FrameBoundary::DELIMITER, '\n');
+    for (char i = 0; i < 10; i++) {
+        const char line[] = {'a', static_cast<char>('0' + i), '\n', '\0'};
+        many.inject(line);
+    }
+
+    for (char i = 0; i < 7; i++) {
+        REQUIRE(many.nextFrame(descriptor));
+        REQUIRE(many.receive(frame, descriptor.length) == 3);
+        REQUIRE(frame[1] == '0' + i);
+    }
+
+    REQUIRE(!many.nextFrame(descriptor));
+    REQUIRE(many.framesDropped() == 3);
+
+    many.inject("zz\n");
+    REQUIRE(many.nextFrame(descriptor));
+    REQUIRE(descriptor.offset == 30);
+    REQUIRE(many.receive(frame, descriptor.length) == 3);
+    REQUIRE(std::equal(frame, frame + 3, "zz\n"));
+    REQUIRE(many.available() == 0);
+}
+
+TEST_CASE("MockUART overflow policies and buffer capacity") {
+    UARTLib::BufferedMockUART<16, 16> uart(115200, UARTLib::UARTController::THREE);
+    uint8_t data[20];
+    uint8_t buf[20];
+
+    for (uint8_t i = 0; i < sizeof(data); i++) {
+        data[i] = i;
+    }
+
+    uart.setReceiveMode(UARTLib::TransferMode::INTERRUPT);
+
+    ///< Dropping the newest bytes keeps the first 15.
+    uart.inject(data, sizeof(data));
+    UARTLib::InterruptRouter::dispatch(UARTLib::UARTController::THREE);
+    REQUIRE(uart.receive(buf, sizeof(buf)) == 15);
+    REQUIRE(buf[14] == 14);
+    REQUIRE(uart.statistics().rxDropped == 5);
+
+    ///< Overwriting the oldest bytes keeps the last 15.
+    uart.setOverflowPolicy(UARTLib::OverflowPolicy::OVERWRITE_OLDEST);
+    uart.inject(data, sizeof(data));
+    UARTLib::InterruptRouter::dispatch(UARTLib::UARTController::THREE);
+    REQUIRE(uart.receive(buf, sizeof(buf)) == 15);
+    REQUIRE(buf[0] == 5);
+    REQUIRE(buf[14] == 19);
+
+    ///< Backpressure sends XOFF at the high watermark, and XON once read down to the low watermark.
+    uart.setOverflowPolicy(UARTLib::OverflowPolicy::BACKPRESSURE);
+    uart.setWatermarks(8, 2);
+    uart.inject(data, 10);
+    UARTLib::InterruptRouter::dispatch(UARTLib::UARTController::THREE);
+    REQUIRE(uart.txCaptured() == 1);
+    REQUIRE(uart.readTransmitted(buf, sizeof(buf)) == 1);
+    REQUIRE(buf[0] == UARTLib::XOFF);
+
+    REQUIRE(uart.receive(buf, 7) == 7);
+    REQUIRE(uart.txCaptured() == 0);
+    uart.receive();
+    REQUIRE(uart.readTransmitted(buf, sizeof(buf)) == 1);
+    REQUIRE(buf[0] == UARTLib::XON);
+}
+
+TEST_CASE("RTS follows the receive buffer watermarks") {
+    const uint32_t rts = 1u << 25;
+    PioRegisterModel pio;
+    UARTLib::RtsLine<PioRegisterModel> line;
+    UARTLib::LinkStatistics stats = {};
+    uint8_t storage[32];
+    UARTLib::ByteBuffer buffer(storage);
+    UARTLib::OverflowControl control(buffer.capacity());
+
+    control.setPolicy(UARTLib::OverflowPolicy::BACKPRESSURE, buffer);
+    control.setWatermarks(24, 8);
+
+    pio.PIO_ODSR = rts;
+    line.attach(pio, rts);
+    REQUIRE(pio.PIO_PER == rts);
+    REQUIRE(pio.PIO_OER == rts);
+    REQUIRE((pio.PIO_ODSR & rts) == 0);
+
+    ///< RTS goes high when the 24th byte is stored, not before.
+    for (uint8_t i = 0; i < 23; i++) {
+        line.store(control, buffer, i, stats);
+    }
+    REQUIRE((pio.PIO_ODSR & rts) == 0);
+    line.store(control, buffer, 23, stats);
+    REQUIRE((pio.PIO_ODSR & rts) == rts);
+
+    ///< It stays high until the buffer has been read down to 8 bytes.
+    line.store(control, buffer, 24, stats);
+    buffer.drop(16);
+    line.resume(control, buffer);
+    REQUIRE((pio.PIO_ODSR & rts) == rts);
+    buffer.drop(1);
+    line.resume(control, buffer);
+    REQUIRE((pio.PIO_ODSR & rts) == 0);
+    REQUIRE(!control.isPaused());
+
+    ///< And goes high again once refilled.
+    for (uint8_t i = 0; i < 16; i++) {
+        line.store(control, buffer, i, stats);
+    }
+    REQUIRE((pio.PIO_ODSR & rts) == rts);
+    REQUIRE(stats.rxDropped == 0);
+}
+
+TEST_CASE("COBS framing") {
+    UARTLib::MockUART uart(115200, UARTLib::UARTController::ONE);
+    uint8_t frameBuffer[300];
+    UARTLib::FrameReader reader(uart, frameBuffer);
+    UARTLib::ByteSpan frame;
+    uint8_t line[400];
+    uint8_t message[300];
+
+    ///< The example from the COBS paper, and the zero bytes at its edges.
+    const uint8_t example[] = {0x00, 0x11, 0x22, 0x00, 0x33, 0x00};
+    REQUIRE(UARTLib::sendCobsFrame(uart, example, sizeof(example)));
+    REQUIRE(uart.readTransmitted(line, sizeof(line)) == 8);
+    const uint8_t encoded[] = {0x01, 0x03, 0x11, 0x22, 0x02, 0x33, 0x01, 0x00};
+    REQUIRE(std::equal(encoded, encoded + sizeof(encoded), line));
+
+    size_t decodedLength;
+    REQUIRE(UARTLib::cobsDecodeInPlace(line, 7, decodedLength));
+    REQUIRE(decodedLength == sizeof(example));
+    REQUIRE(std::equal(example, example + sizeof(example), line));
+
+    ///< Frames wrapping around the receive buffer and blocks longer than 254 bytes, back to back.
+    uart.setLoopback(true);
+    for (size_t i = 0; i < sizeof(message); i++) {
+        message[i] = static_cast<uint8_t>(i % 255 + 1);
+    }
+    message[100] = 0;
+
+    for (int round = 0; round < 3; round++) {
+        REQUIRE(UARTLib::sendCobsFrame(uart, message, sizeof(message)));
+        REQUIRE(UARTLib::sendCobsFrame(uart, example, 3));
+
+        ///< The receive buffer holds 255 bytes, so the frame arrives in parts.
+        int polls = 0;
+        while (!reader.receive(frame)) {
+            polls++;
+        }
+        REQUIRE(polls > 0);
+        REQUIRE(frame.length == sizeof(message));
+        REQUIRE(std::equal(message, message + sizeof(message), frame.data));
+
+        REQUIRE(reader.receive(frame));
+        REQUIRE(frame.length == 3);
+        REQUIRE(frame.data[2] == 0x22);
+    }
+
+    ///< Frames larger than the frame buffer are dropped.
+    uint8_t small[4];
+    UARTLib::FrameReader smallReader(uart, small);
+    UARTLib::sendCobsFrame(uart, message, 10);
+    UARTLib::sendCobsFrame(uart, example, 3);
+    REQUIRE(smallReader.receive(frame));
+    REQUIRE(frame.length == 3);
+    REQUIRE(smallReader.framesDropped() == 1);
+}
+
+TEST_CASE("Framing on a cooperative connection never waits for service()") {
+    UARTLib::MockUART uart(115200, UARTLib::UARTController::THREE);
+    uart.setTransmitMode(UARTLib::TransferMode::COOPERATIVE);
+    uint8_t message[300];
+    uint8_t line[300];
+
+    for (size_t i = 0; i < sizeof(message); i++) {
+        message[i] = static_cast<uint8_t>(i);
+    }
+
+    ///< Frames that do not fit in the 255 byte transmit buffer are refused as a whole.
+    REQUIRE(!UARTLib::sendCobsFrame(uart, message, sizeof(message)));
+    REQUIRE(uart.txPending() == 0);
+    const uint8_t ends[] = {0xC0, 0xC0, 0xC0};
+    REQUIRE(UARTLib::sendSlipFrame(uart, ends, sizeof(ends)));
+    REQUIRE(uart.txPending() == 8);
+    REQUIRE(!UARTLib::sendSlipFrame(uart, message + 1, 248));
+
+    REQUIRE(UARTLib::sendCobsFrame(uart, message + 1, 100));
+    while (uart.txPending() > 0) {
+        uart.service(16);
+    }
+
+    size_t decodedLength;
+    REQUIRE(uart.readTransmitted(line, sizeof(line)) == 8 + 102);
+    REQUIRE(UARTLib::cobsDecodeInPlace(line + 8, 101, decodedLength));
+    REQUIRE(decodedLength == 100);
+    REQUIRE(std::equal(message + 1, message + 101, line + 8));
+}
+
+TEST_CASE("SLIP framing") {
+    UARTLib::MockUART uart(115200, UARTLib::UARTController::ONE);
+    uint8_t frameBuffer[16];
+    UARTLib::FrameReader reader(uart, frameBuffer, UARTLib::FrameEncoding::SLIP);
+    UARTLib::ByteSpan frame;
+    uint8_t line[32];
+
+    const uint8_t message[] = {0x01, 0xC0, 0x02, 0xDB, 0x03};
+    REQUIRE(UARTLib::sendSlipFrame(uart, message, sizeof(message)));
+    REQUIRE(uart.readTransmitted(line, sizeof(line)) == 9);
+    const uint8_t encoded[] = {0xC0, 0x01, 0xDB, 0xDC, 0x02, 0xDB, 0xDD, 0x03, 0xC0};
+    REQUIRE(std::equal(encoded, encoded + sizeof(encoded), line));
+
+    size_t decodedLength;
+    REQUIRE(UARTLib::slipDecodeInPlace(line + 1, 7, decodedLength));
+    REQUIRE(decodedLength == sizeof(message));
+    REQUIRE(std::equal(message, message + sizeof(message), line + 1));
+
+    uart.inject(encoded, sizeof(encoded));
+    REQUIRE(reader.receive(frame));
+    REQUIRE(frame.length == sizeof(message));
+    REQUIRE(std::equal(message, message + sizeof(message), frame.data));
+    REQUIRE(!reader.receive(frame));
+
+    ///< An invalid escape drops the frame.
+    uart.inject("\xC0\x01\xDB\x05\xC0");
+    REQUIRE(!reader.receive(frame));
+    REQUIRE(reader.framesDropped() == 1);
+}
+
+TEST_CASE("CRC check values") {
+    static_assert(UARTLib::Crc8::compute("123456789") == 0xF4, "CRC-8 check value");
+    static_assert(UARTLib::Crc16::compute("123456789") == 0x29B1, "CRC-16/CCITT-FALSE check value");
+    static_assert(UARTLib::Crc32::compute("123456789") == 0xCBF43926, "CRC-32 check value");
+
+    const uint8_t *check = reinterpret_cast<const uint8_t *>("123456789");
+    REQUIRE(UARTLib::Crc32Slicing::compute(check, 9) == 0xCBF43926);
+
+    ///< Incremental updates give the same result, whatever the split.
+    UARTLib::Crc32Slicing sliced;
+    UARTLib::Crc16 crc16;
+    sliced.update(check, 2);
+    sliced.update(check + 2, 7);
+    for (size_t i = 0; i < 9; i++) {
+        crc16.update(check[i]);
+    }
+    REQUIRE(sliced.value() == 0xCBF43926);
+    REQUIRE(crc16.value() == 0x29B1);
+
+    crc16.reset();
+    crc16.update(UARTLib::ByteSpan{check, 9});
+    REQUIRE(crc16.value() == 0x29B1);
+}
+
+TEST_CASE("UARTPoller reports ready connections") {
+    UARTLib::MockUART one(115200, UARTLib::UARTController::ONE);
+    UARTLib::MockUART two(115200, UARTLib::UARTController::TWO);
+    UARTLib::MockUART three(115200, UARTLib::UARTController::THREE);
+    UARTLib::UARTPoller poller;
+    UARTLib::PollResult results[3];
+
+    one.setReceiveMode(UARTLib::TransferMode::INTERRUPT);
+    two.setReceiveMode(UARTLib::TransferMode::INTERRUPT);
+    three.setTransmitMode(UARTLib::TransferMode::INTERRUPT);
+
+    REQUIRE(poller.add(one, UARTLib::pollReadable));
+    REQUIRE(poller.add(two, UARTLib::pollReadable));
+    REQUIRE(poller.add(three, UARTLib::pollWritable));
+    REQUIRE(poller.size() == 3);
+
+    ///< Only the empty transmit buffer of three is ready.
+    REQUIRE(poller.poll(results, 3) == 1);
+    REQUIRE(results[0].connection == &three);
+    REQUIRE(results[0].events == UARTLib::pollWritable);
+
+    ///< Data becomes readable once the interrupt has moved it into the receive buffer.
+    two.inject("hi");
+    UARTLib::InterruptRouter::takePending();
+    UARTLib::InterruptRouter::dispatch(UARTLib::UARTController::TWO);
+    REQUIRE(UARTLib::InterruptRouter::takePending() == 1u << 1);
+    REQUIRE(UARTLib::InterruptRouter::takePending() == 0);
+
+    REQUIRE(poller.wait(results, 3) == 2);
+    REQUIRE(((results[0].connection == &two && results[1].connection == &three) ||
+             (results[0].connection == &three && results[1].connection == &two)));
+
+    ///< A full transmit buffer is not writable.
+    uint8_t data[300] = {};
+    three.trySend(data, sizeof(data));
+    REQUIRE(three.txFree() == 0);
+
+    ///< Interest in both events is reported in a single result.
+    REQUIRE(poller.add(two, UARTLib::pollReadable | UARTLib::pollWritable));
+    REQUIRE(poller.size() == 3);
+    REQUIRE(poller.poll(results, 3) == 1);
+    REQUIRE(results[0].connection == &two);
+    REQUIRE(results[0].events == (UARTLib::pollReadable | UARTLib::pollWritable));
+
+    poller.remove(two);
+    REQUIRE(poller.size() == 2);
+    REQUIRE(poller.poll(results, 3) == 0);
+}
+
+TEST_CASE("PosixSerialUART over a pseudo-terminal pair") {
+    int first = -1;
+    int second = -1;
+    REQUIRE(UARTLib::openPseudoTerminal(first, second));
+
+    UARTLib::PosixSerialUART gateway(first, 115200);
+    UARTLib::BufferedPosixSerialUART<16> device(second, 115200);
+    REQUIRE(gateway.isInitialized());
+    REQUIRE(device.isInitialized());
+
+    ///< Raw mode: bytes arrive as sent, without line editing or echo.
+    uint8_t data[100];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = static_cast<uint8_t>(i * 7);
+    }
+    data[10] = '\n';
+    data[11] = 0x03;
+
+    REQUIRE(gateway.send(data, sizeof(data)));
+    REQUIRE(device.waitReadable(1000));
+
+    ///< The receive buffer holds 15 bytes, the rest stays with the kernel.
+    REQUIRE(device.available() == 15);
+    UARTLib::ByteSpan spans[2];
+    REQUIRE(device.readableSpans(spans[0], spans[1]) == 15);
+    REQUIRE(spans[0].data[0] == data[0]);
+    device.consume(1);
+
+    ///< Bulk receive empties the receive buffer, then reads straight from the kernel.
+    uint8_t received[sizeof(data)] = {};
+    received[0] = data[0];
+    size_t got = 1;
+    while (got < sizeof(data) && device.waitReadable(1000)) {
+        got += device.receive(received + got, sizeof(received) - got);
+    }
+    REQUIRE(got == sizeof(data));
+    REQUIRE(std::equal(data, data + sizeof(data), received));
+    REQUIRE(device.statistics().bytesReceived == sizeof(data));
+    REQUIRE(gateway.statistics().bytesSent == sizeof(data));
+
+    ///< The other direction, through the hwlib stream interface.
+    device << "ok";
+    device.flush();
+    REQUIRE(gateway.waitReadable(1000));
+    REQUIRE(gateway.getc() == 'o');
+    REQUIRE(gateway.waitReadable(1000));
+    REQUIRE(gateway.getc() == 'k');
+    REQUIRE(!gateway.waitReadable(0));
+    REQUIRE(gateway.txFree() > 0);
+
+    ///< In cooperative transmit mode, an array that may not fit in the kernel transmit buffer is not written at all.
+    gateway.setTransmitMode(UARTLib::TransferMode::COOPERATIVE);
+    REQUIRE(!gateway.send(data, sizeof(data)));
+    REQUIRE(!device.waitReadable(100));
+    REQUIRE(gateway.send(data, 1));
+    REQUIRE(device.waitReadable(1000));
+    REQUIRE(device.receive() == data[0]);
+
+    ///< A device that cannot be opened leaves the connection uninitialized.
+    UARTLib::PosixSerialUART missing("/nonexistent/tty", 115200);
+    REQUIRE(!missing.isInitialized());
+    REQUIRE(!missing.send(data, 1));
+    REQUIRE(missing.available() == 0);
+}
+
+TEST_CASE("Buffered output stream") {
+    UARTLib::MockUART uart(115200);
+    uint8_t buf[32];
+
+    {
+        UARTLib::BufferedOutput<16> out(uart);
+
+        ///< Nothing is sent until a newline.
+        out << "ab" << 12;
+        REQUIRE(out.pending() == 4);
+        REQUIRE(uart.txCaptured() == 0);
+
+        out << "\n";
+        REQUIRE(out.pending() == 0);
+        REQUIRE(uart.readTransmitted(buf, sizeof(buf)) == 5);
+        REQUIRE(std::equal(buf, buf + 5, reinterpret_cast<const uint8_t *>("ab12\n")));
+
+        ///< Without flushing on a newline, a full half is sent at once.
+        out.setFlushOnNewline(false);
+        out << "0123\n5678";
+        REQUIRE(uart.readTransmitted(buf, sizeof(buf)) == 8);
+        REQUIRE(out.pending() == 1);
+
+        out.flush();
+        REQUIRE(uart.readTransmitted(buf, sizeof(buf)) == 1);
+        REQUIRE(buf[0] == '8');
+
+        ///< Whatever is left is sent on destruction.
+        out << "xyz";
+    }
+
+    REQUIRE(uart.readTransmitted(buf, sizeof(buf)) == 3);
+
+    ///< In interrupt transmit mode, halves are copied into the transmit buffer, so they are reused without waiting.
+    uart.setTransmitMode(UARTLib::TransferMode::INTERRUPT);
+    UARTLib::BufferedOutput<8> out(uart);
+    out << "abcd";
+    REQUIRE(uart.txPending() == 4);
+    out << "efgh";
+    REQUIRE(uart.txPending() == 8);
+    uart.flush();
+    REQUIRE(uart.readTransmitted(buf, sizeof(buf)) == 8);
+    REQUIRE(std::equal(buf, buf + 8, reinterpret_cast<const uint8_t *>("abcdefgh")));
+}
+
+TEST_CASE("Buffered output stream keeps what does not fit in the transmit buffer staged") {
+    UARTLib::BufferedMockUART<16, 8> uart(115200);
+    uint8_t buf[40];
+
+    ///< A half does not fit in the transmit buffer, the rest stays staged instead of waiting for service().
+    uart.setTransmitMode(UARTLib::TransferMode::COOPERATIVE);
+    UARTLib::BufferedOutput<64> out(uart);
+    out << "0123456789abcdefghijklmnopqrstu\n";
+    REQUIRE(uart.txPending() == 7);
+    REQUIRE(out.pending() == 25);
+
+    ///< Characters arriving while the staging buffer is still full are dropped and counted.
+    out << "vwxyzAB";
+    REQUIRE(out.pending() == 32);
+    out << "C";
+    REQUIRE(out.dropped() == 1);
+
+    ///< Every later flush() sends what the connection made room for.
+    while (out.pending() > 0) {
+        REQUIRE(uart.service(100) > 0);
+        out.flush();
+    }
+
+    uart.flush();
+    REQUIRE(uart.readTransmitted(buf, sizeof(buf)) == 39);
+    REQUIRE(std::equal(buf, buf + 39, reinterpret_cast<const uint8_t *>("0123456789abcdefghijklmnopqrstu\nvwxyzAB")));
+    REQUIRE(uart.statistics().txDropped == 0);
+}
+
+namespace {
+
+struct Sample {
+    uint16_t id;
+    int32_t temperature;
+    uint64_t uptime;
+    float humidity;
+    uint8_t payload[8];
+    size_t payloadLength;
+};
+
+typedef UARTLib::Schema<Sample, UARTLib::LittleEndian<Sample, uint16_t, &Sample::id>,
+                        UARTLib::Varint<Sample, int32_t, &Sample::temperature>,
+                        UARTLib::Varint<Sample, uint64_t, &Sample::uptime>,
+                        UARTLib::LittleEndian<Sample, float, &Sample::humidity>,
+                        UARTLib::Bytes<Sample, 8, &Sample::payload, &Sample::payloadLength>>
+    SampleSchema;
+
+} // namespace
+
+TEST_CASE("Schema serialization") {
+    static_assert(SampleSchema::maxEncodedLength == 2 + 5 + 10 + 4 + 10 + 8, "Largest encoding");
+
+    Sample sample = {0x1234, -3, 300, 0.5f, {'a', 'b', 'c'}, 3};
+    uint8_t encoded[SampleSchema::maxEncodedLength];
+
+    ///< Little-endian id, zigzag varint -3 (5), varint 300 (0xAC 0x02), float 0.5 and a length prefixed payload.
+    const uint8_t expected[] = {0x34, 0x12, 0x05, 0xAC, 0x02, 0x00, 0x00, 0x00, 0x3F, 0x03, 'a', 'b', 'c'};
+    REQUIRE(SampleSchema::encode(sample, encoded) == sizeof(expected));
+    REQUIRE(std::equal(expected, expected + sizeof(expected), encoded));
+
+    Sample decoded = {};
+    size_t used = 0;
+    REQUIRE(SampleSchema::decode(decoded, encoded, sizeof(expected), used) == UARTLib::DecodeResult::OK);
+    REQUIRE(used == sizeof(expected));
+    REQUIRE(decoded.id == 0x1234);
+    REQUIRE(decoded.temperature == -3);
+    REQUIRE(decoded.uptime == 300);
+    REQUIRE(decoded.humidity == 0.5f);
+    REQUIRE(decoded.payloadLength == 3);
+    REQUIRE(decoded.payload[2] == 'c');
+
+    REQUIRE(SampleSchema::decode(decoded, encoded, sizeof(expected) - 1, used) == UARTLib::DecodeResult::INCOMPLETE);
+
+    ///< A payload longer than the field is malformed.
+    encoded[9] = 9;
+    REQUIRE(SampleSchema::decode(decoded, encoded, sizeof(encoded), used) == UARTLib::DecodeResult::MALFORMED);
+    REQUIRE(used == 10);
+
+    ///< Extreme values survive the varint encoding.
+    sample.temperature = INT32_MIN;
+    sample.uptime = UINT64_MAX;
+    REQUIRE(SampleSchema::encode(sample, encoded) == 2 + 5 + 10 + 4 + 4);
+    REQUIRE(SampleSchema::decode(decoded, encoded, sizeof(encoded), used) == UARTLib::DecodeResult::OK);
+    REQUIRE(decoded.temperature == INT32_MIN);
+    REQUIRE(decoded.uptime == UINT64_MAX);
+}
+
+TEST_CASE("Schema records through a connection") {
+    UARTLib::MockUART sender(115200, UARTLib::UARTController::ONE);
+    UARTLib::MockUART receiver(115200, UARTLib::UARTController::TWO);
+    sender.connect(receiver);
+
+    Sample sample = {7, 21, 1000, 40.25f, {1, 2}, 2};
+    Sample decoded = {};
+
+    {
+        UARTLib::BufferedOutput<128> out(sender);
+        REQUIRE(SampleSchema::send(out, sample));
+        sample.id = 8;
+        REQUIRE(SampleSchema::send(out, sample));
+
+        ///< Nothing has been sent yet, so nothing can be decoded.
+        REQUIRE(SampleSchema::receive(receiver, decoded) == UARTLib::DecodeResult::INCOMPLETE);
+    }
+
+    REQUIRE(SampleSchema::receive(receiver, decoded) == UARTLib::DecodeResult::OK);
+    REQUIRE(decoded.id == 7);
+    REQUIRE(decoded.humidity == 40.25f);
+    REQUIRE(SampleSchema::receive(receiver, decoded) == UARTLib::DecodeResult::OK);
+    REQUIRE(decoded.id == 8);
+    REQUIRE(receiver.available() == 0);
+
+    ///< A malformed record is skipped up to its invalid byte, a payload length of 9, so the next record can be decoded.
+    const uint8_t malformed[] = {0x34, 0x12, 0x05, 0xAC, 0x02, 0x00, 0x00, 0x00, 0x3F, 0x09};
+    sender.send(malformed, sizeof(malformed));
+    {
+        UARTLib::BufferedOutput<128> out(sender);
+        REQUIRE(SampleSchema::send(out, sample));
+    }
+
+    REQUIRE(SampleSchema::receive(receiver, decoded) == UARTLib::DecodeResult::MALFORMED);
+    REQUIRE(SampleSchema::receive(receiver, decoded) == UARTLib::DecodeResult::OK);
+    REQUIRE(decoded.id == 8);
+    REQUIRE(receiver.available() == 0);
+
+    ///< A record wrapping around the end of the receive buffer is decoded across both spans.
+    uint8_t filler[202] = {};
+    sender.send(filler, sizeof(filler));
+    receiver.available();
+    receiver.consume(sizeof(filler));
+
+    UARTLib::BufferedOutput<128> small(sender);
+    REQUIRE(SampleSchema::send(small, sample));
+    small.flush();
+
+    UARTLib::ByteSpan first;
+    UARTLib::ByteSpan second;
+    receiver.available();
+    receiver.readableSpans(first, second);
+    REQUIRE(second.length > 0);
+    REQUIRE(SampleSchema::receive(receiver, decoded) == UARTLib::DecodeResult::OK);
+    REQUIRE(decoded.payloadLength == 2);
+    REQUIRE(decoded.uptime == 1000);
+}
+
+namespace {
+
+struct Completion {
+    int calls;
+    size_t transferred;
+};
+
+void complete(void *context, size_t transferred) {
+    Completion *completion = static_cast<Completion *>(context);
+    completion->calls++;
+    completion->transferred = transferred;
+}
+
+} // namespace
+
+TEST_CASE("AsyncUART completes on interrupts") {
+    UARTLib::MockUART uart(115200, UARTLib::UARTController::ONE);
+    uart.setReceiveMode(UARTLib::TransferMode::INTERRUPT);
+    uart.setTransmitMode(UARTLib::TransferMode::INTERRUPT);
+
+    UARTLib::AsyncUART async(uart);
+    Completion sent = {};
+    Completion received = {};
+    const uint8_t data[] = {1, 2, 3};
+    uint8_t buf[4] = {};
+
+    ///< The send is queued, and completes once the interrupts have transmitted every byte.
+    REQUIRE(async.sendAsync(data, sizeof(data), complete, &sent));
+    REQUIRE(async.sendBusy());
+    REQUIRE(!async.sendAsync(data, sizeof(data), complete, &sent));
+
+    REQUIRE(async.receiveAsync(buf, sizeof(buf), complete, &received));
+
+    for (int i = 0; i < 3; i++) {
+        REQUIRE(sent.calls == 0);
+        UARTLib::InterruptRouter::dispatch(UARTLib::UARTController::ONE);
+    }
+
+    REQUIRE(sent.calls == 1);
+    REQUIRE(sent.transferred == 3);
+    REQUIRE(!async.sendBusy());
+    REQUIRE(uart.txCaptured() == 3);
+
+    ///< Bytes trickling in complete the receive once all four have arrived.
+    uart.inject("ab");
+    UARTLib::InterruptRouter::dispatch(UARTLib::UARTController::ONE);
+    REQUIRE(received.calls == 0);
+    uart.inject("cde");
+    UARTLib::InterruptRouter::dispatch(UARTLib::UARTController::ONE);
+    REQUIRE(received.calls == 1);
+    REQUIRE(received.transferred == 4);
+    REQUIRE(buf[3] == 'd');
+    REQUIRE(uart.available() == 1);
+}
+
+TEST_CASE("AsyncUART driven by poll") {
+    UARTLib::MockUART uart(115200, UARTLib::UARTController::TWO);
+    uart.setLoopback(true);
+
+    UARTLib::AsyncUART async(uart);
+    Completion sent = {};
+    Completion received = {};
+    const uint8_t data[] = {'h', 'i'};
+    uint8_t buf[2] = {};
+
+    ///< In polling mode, the send completes right away.
+    REQUIRE(async.receiveAsync(buf, sizeof(buf), complete, &received));
+    REQUIRE(async.sendAsync(data, sizeof(data), complete, &sent));
+    REQUIRE(sent.calls == 1);
+
+    async.poll();
+    REQUIRE(received.calls == 1);
+    REQUIRE(buf[0] == 'h');
+    REQUIRE(buf[1] == 'i');
+}
+
+TEST_CASE("BlockPool allocates and releases fixed-size blocks") {
+    UARTLib::BlockPool<24, 4> pool;
+    uint8_t *blocks[4];
+
+    REQUIRE(pool.blockSize() == 24);
+
+    for (uint8_t *&block : blocks) {
+        block = pool.allocate();
+        REQUIRE(block != nullptr);
+        REQUIRE(pool.owns(block));
+        REQUIRE(reinterpret_cast<uintptr_t>(block) % sizeof(uintptr_t) == 0);
+    }
+
+    REQUIRE(pool.available() == 0);
+    REQUIRE(pool.allocate() == nullptr);
+    REQUIRE(blocks[3] - blocks[0] == 3 * 24);
+    REQUIRE(!pool.owns(blocks[0] + 1));
+
+    ///< Released blocks are handed out again, oldest release first.
+    pool.release(blocks[2]);
+    pool.release(blocks[0]);
+    REQUIRE(pool.available() == 2);
+    REQUIRE(pool.allocate() == blocks[2]);
+    REQUIRE(pool.allocate() == blocks[0]);
+}
+
+TEST_CASE("ReentryGuard runs another round for a missed call") {
+    UARTLib::ReentryGuard guard;
+
+    REQUIRE(guard.enter());
+    REQUIRE(!guard.enter());
+    REQUIRE(guard.leave());
+    REQUIRE(!guard.leave());
+
+    REQUIRE(guard.enter());
+    REQUIRE(!guard.leave());
+}
+
+TEST_CASE("MessageTransmitter returns blocks once their bytes have been transmitted") {
+    UARTLib::MockUART uart(115200, UARTLib::UARTController::THREE);
+    uart.setTransmitMode(UARTLib::TransferMode::INTERRUPT);
+    UARTLib::BlockPool<100, 4> pool;
+    UARTLib::MessageTransmitter transmitter(uart);
+    REQUIRE(transmitter.isListening());
+
+    ///< Another listener never takes the interrupts away from the transmitter, it has to be polled instead.
+    {
+        UARTLib::AsyncUART async(uart);
+        REQUIRE(!async.isListening());
+    }
+
+    ///< Three messages of 100 bytes, the last one only partly fits in the 255 byte transmit buffer.
+    for (uint8_t m = 0; m < 3; m++) {
+        uint8_t *block = pool.allocate();
+        for (uint8_t i = 0; i < 100; i++) {
+            block[i] = static_cast<uint8_t>(m * 100 + i);
+        }
+
+        REQUIRE(transmitter.send(block, 100, pool));
+    }
+
+    REQUIRE(transmitter.pending() == 3);
+    REQUIRE(pool.available() == 1);
+    REQUIRE(uart.txPending() == 255);
+
+    ///< Every interrupt transmits one byte, the first block is returned with its last byte.
+    for (int i = 0; i < 99; i++) {
+        UARTLib::InterruptRouter::dispatch(UARTLib::UARTController::THREE);
+    }
+
+    REQUIRE(pool.available() == 1);
+    UARTLib::InterruptRouter::dispatch(UARTLib::UARTController::THREE);
+    REQUIRE(pool.available() == 2);
+    REQUIRE(transmitter.pending() == 2);
+
+    while (transmitter.pending() > 0) {
+        UARTLib::InterruptRouter::dispatch(UARTLib::UARTController::THREE);
+    }
+
+    REQUIRE(pool.available() == 4);
+
+    uint8_t transmitted[300];
+    REQUIRE(uart.readTransmitted(transmitted, sizeof(transmitted)) == 300);
+    for (size_t i = 0; i < sizeof(transmitted); i++) {
+        REQUIRE(transmitted[i] == static_cast<uint8_t>(i));
+    }
+}
+
+#ifdef UARTLIB_COROUTINES
+namespace {
+
+struct Task {
+    struct promise_type {
+        Task get_return_object() {
+            return {};
+        }
+        std::suspend_never initial_suspend() {
+            return {};
+        }
+        std::suspend_never final_suspend() noexcept {
+            return {};
+        }
+        void return_void() {
+        }
+        void unhandled_exception() {
+        }
+    };
+};
+
+Task echo(UARTLib::AsyncUART &async, int &state) {
+    uint8_t buf[3];
+
+    state = 1;
+    size_t n = co_await async.receive(buf, sizeof(buf));
+    state = 2;
+    co_await async.send(buf, n);
+    state = 3;
+}
+
+} // namespace
+
+TEST_CASE("AsyncUART awaitables") {
+    UARTLib::MockUART uart(115200, UARTLib::UARTController::THREE);
+    uart.setReceiveMode(UARTLib::TransferMode::INTERRUPT);
+    uart.setTransmitMode(UARTLib::TransferMode::INTERRUPT);
+
+    UARTLib::AsyncUART async(uart);
+    int state = 0;
+
+    echo(async, state);
+    REQUIRE(state == 1);
+
+    uart.inject("xyz");
+    UARTLib::InterruptRouter::dispatch(UARTLib::UARTController::THREE);
+    REQUIRE(state == 2);
+
+    for (int i = 0; i < 3; i++) {
+        UARTLib::InterruptRouter::dispatch(UARTLib::UARTController::THREE);
+    }
+    REQUIRE(state == 3);
+
+    uint8_t sent[3];
+    REQUIRE(uart.readTransmitted(sent, sizeof(sent)) == 3);
+    REQUIRE(sent[2] == 'z');
+}
+#endif
+
+TEST_CASE("PDC transmit descriptor chaining") {
+    using Pdc = UARTLib::PdcChannel<PdcRegisterModel>;
+    PdcRegisterModel registers = {};
+    uint8_t first[100], second[20], third[10];
+
+    Pdc::enableTransmit(registers);
+    REQUIRE(registers.US_PTCR == (1u << 8));
+    REQUIRE(Pdc::transmitIdle(registers));
+
+    ///< An idle channel starts with the current descriptor.
+    REQUIRE(Pdc::queueTransmit(registers, first, sizeof(first)));
+    REQUIRE(registers.US_TPR == reinterpret_cast<uintptr_t>(first));
+    REQUIRE(registers.US_TCR == 100);
+
+    ///< The next transfer is chained in the next descriptor.
+    REQUIRE(Pdc::queueTransmit(registers, second, sizeof(second)));
+    REQUIRE(registers.US_TNPR == reinterpret_cast<uintptr_t>(second));
+    REQUIRE(registers.US_TNCR == 20);
+    REQUIRE(Pdc::transmitPending(registers) == 120);
+
+    ///< Both descriptors in use.
+    REQUIRE(!Pdc::queueTransmit(registers, third, sizeof(third)));
+    REQUIRE(!Pdc::queueTransmit(registers, first, Pdc::maxTransferLength + 1));
+
+    registers.completeCurrent();
+    REQUIRE(registers.US_TCR == 20);
+    REQUIRE(Pdc::queueTransmit(registers, third, sizeof(third)));
+    REQUIRE(registers.US_TNCR == 10);
+
+    registers.completeCurrent();
+    registers.completeCurrent();
+    REQUIRE(Pdc::transmitIdle(registers));
+}
+
+TEST_CASE("DMA ping-pong receive with idle line framing") {
+    PdcRegisterModel registers = {};
+    UARTLib::DmaFrameReceiver<PdcRegisterModel> receiver;
+    UARTLib::DmaFrame frame;
+    uint8_t first[8], second[8];
+
+    REQUIRE(!receiver.hasBuffers());
+    receiver.setBuffers(first, second, sizeof(first));
+    receiver.start(registers, 20);
+
+    REQUIRE(registers.US_RTOR == 20);
+    REQUIRE(registers.US_RCR == 8);
+    REQUIRE(registers.US_RNCR == 8);
+
+    ///< An idle line ends a frame.
+    registers.receive("abc", receiver);
+    receiver.onTimeout(registers);
+    REQUIRE(receiver.framesAvailable() == 1);
+    REQUIRE(receiver.peekFrame(frame));
+    REQUIRE(frame.data == first);
+    REQUIRE(frame.length == 3);
+    REQUIRE(frame.complete);
+
+    ///< A frame crossing the end of the buffer is cut off, and continues in the second buffer.
+    registers.receive("defghij", receiver);
+    receiver.onTimeout(registers);
+    REQUIRE(receiver.framesAvailable() == 3);
+
+    receiver.releaseFrame(registers);
+    REQUIRE(receiver.peekFrame(frame));
+    REQUIRE(frame.data == first + 3);
+    REQUIRE(frame.length == 5);
+    REQUIRE(!frame.complete);
+
+    ///< The first buffer is only armed again once all of its frames are released.
+    REQUIRE(registers.US_RNCR == 0);
+    receiver.releaseFrame(registers);
+    REQUIRE(registers.US_RNPR == reinterpret_cast<uintptr_t>(first));
+    REQUIRE(registers.US_RNCR == 8);
+
+    REQUIRE(receiver.peekFrame(frame));
+    REQUIRE(frame.data == second);
+    REQUIRE(frame.length == 2);
+    REQUIRE(std::string(reinterpret_cast<const char *>(frame.data), frame.length) == "ij");
+    receiver.releaseFrame(registers);
+    REQUIRE(receiver.framesAvailable() == 0);
+    REQUIRE(receiver.framesDropped() == 0);
+}
+
+TEST_CASE("BasicUART with MockBackend") {
+    UARTLib::BasicUART<UARTLib::MockBackend> uart(115200, false);
+
+    REQUIRE(!uart.isInitialized());
+    uart.begin();
+    REQUIRE(uart.isInitialized());
+
+    uart.send("Hello");
+    uart.send(static_cast<uint8_t>('!'));
+    REQUIRE(uart.getBackend().bytesWritten == 6);
+    REQUIRE(uart.getBackend().lastByte == '!');
+
+    REQUIRE(uart.available() == 1);
+    REQUIRE(uart.available() == 2);
+    REQUIRE(uart.receive() == 0xAA);
+    REQUIRE(uart.getc() == static_cast<char>(0xAA));
+}
+
+TEST_CASE("BasicUART and UARTConnection send the same bytes") {
+    const size_t bytes = 1000;
+    UARTLib::MockUART connection(115200);
+    UARTLib::UARTConnection &virtualConnection = connection;
+    UARTLib::BasicUART<UARTLib::MockBackend> basic(115200);
+
+    ///< The cost per byte of both is compared by the putc benchmarks of uart_bench.
+    for (size_t i = 0; i < bytes; i++) {
+        virtualConnection.putc(static_cast<char>(i));
+        basic.putc(static_cast<char>(i));
+    }
+
+    REQUIRE(connection.txCaptured() == bytes);
+    REQUIRE(basic.getBackend().bytesWritten == bytes);
+    REQUIRE(basic.getBackend().lastByte == static_cast<uint8_t>(bytes - 1));
+}
+
+TEST_CASE("Baudrate generator settings") {
+    using UARTLib::computeBaudRate;
+
+    ///< 16x oversampling reaches 115200 baud accurately, using the fractional divider.
+    UARTLib::BaudRateConfig config = computeBaudRate(84000000, 115200);
+    REQUIRE(config.valid);
+    REQUIRE(!config.over);
+    REQUIRE(config.cd == 45);
+    REQUIRE(config.fp == 5);
+    REQUIRE(config.errorPpm < 2000);
+
+    ///< 921600 baud needs 8x oversampling to stay accurate.
+    static_assert(UARTLib::BaudRate<921600, 2000>::config.over, "921600 baud uses 8x oversampling");
+    config = UARTLib::BaudRate<921600, 2000>::config;
+    REQUIRE(config.cd == 11);
+    REQUIRE(config.fp == 3);
+    REQUIRE(config.actual == 923076);
+
+    ///< Out of range of the divider.
+    REQUIRE(!computeBaudRate(84000000, 10).valid);
+    REQUIRE(!computeBaudRate(84000000, 20000000).valid);
+    REQUIRE(computeBaudRate(84000000, 10500000).valid);
+}
+
+TEST_CASE("HardwareUART against simulated registers, polling") {
+    using UARTLib::SimulatedSam3x;
+
+    SimulatedSam3x::reset();
+    UARTLib::HardwareUART uart(115200);
+    const UARTLib::BaudRateConfig &config = uart.baudRateConfig();
+
+    ///< begin() set up the clock, the pins and the baudrate generator.
+    REQUIRE((PMC->PMC_PCSR0 & (1u << ID_USART0)) != 0);
+    REQUIRE(simulatedPIOA.routedTo(PIO_PA10 | PIO_PA11, false));
+    REQUIRE(USART0->US_BRGR == (US_BRGR_CD(config.cd) | US_BRGR_FP(config.fp)));
+
+    ///< 8N1: ten bits per character.
+    uint64_t cycles = USART0->characterCycles();
+    REQUIRE(cycles == 10 * 16 * (8 * uint64_t(config.cd) + config.fp) / 8);
+
+    ///< Busy waiting on TXRDY keeps the line busy, back to back.
+    uint8_t data[100];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = static_cast<uint8_t>(i);
+    }
+
+    uint64_t start = SimulatedSam3x::now();
+    REQUIRE(uart.send(data, sizeof(data)));
+    uart.flush();
+    uint64_t elapsed = SimulatedSam3x::now() - start;
+    REQUIRE(elapsed >= sizeof(data) * cycles);
+    REQUIRE(elapsed < (sizeof(data) + 1) * cycles);
+
+    uint8_t transmitted[sizeof(data)];
+    REQUIRE(USART0->takeTransmitted(transmitted, sizeof(transmitted)) == sizeof(data));
+    REQUIRE(std::equal(data, data + sizeof(data), transmitted));
+
+    ///< Not polling while three characters arrive overruns US_RHR twice, only the last one is left.
+    USART0->receiveFromLine(reinterpret_cast<const uint8_t *>("abc"), 3);
+    SimulatedSam3x::run(4 * cycles);
+    REQUIRE(USART0->charactersOverrun() == 2);
+    REQUIRE(uart.available() == 1);
+    REQUIRE(uart.receive() == 'c');
+    REQUIRE(uart.statistics().overrunErrors == 1);
+
+    ///< Polling faster than characters arrive receives all of them.
+    USART0->receiveFromLine(data, sizeof(data));
+    uint8_t received[sizeof(data)];
+    size_t count = 0;
+    while (count < sizeof(data) && SimulatedSam3x::now() - start < 1000 * cycles) {
+        if (uart.available() > 0) {
+            received[count++] = uart.receive();
+        }
+    }
+
+    REQUIRE(count == sizeof(data));
+    REQUIRE(std::equal(data, data + sizeof(data), received));
+    REQUIRE(USART0->charactersOverrun() == 2);
+}
+
+TEST_CASE("HardwareUART against simulated registers, interrupts") {
+    using UARTLib::SimulatedSam3x;
+
+    SimulatedSam3x::reset();
+    UARTLib::HardwareUART uart(115200);
+    uart.setReceiveMode(UARTLib::TransferMode::INTERRUPT);
+    uart.setTransmitMode(UARTLib::TransferMode::INTERRUPT);
+    uint64_t cycles = USART0->characterCycles();
+
+    uint8_t data[200];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = static_cast<uint8_t>(i * 7);
+    }
+
+    ///< The interrupt handler receives while the program is busy elsewhere.
+    USART0->receiveFromLine(data, sizeof(data));
+    SimulatedSam3x::run((sizeof(data) + 1) * cycles);
+    REQUIRE(uart.available() == sizeof(data));
+    REQUIRE(USART0->charactersOverrun() == 0);
+
+    uint8_t received[sizeof(data)];
+    REQUIRE(uart.receive(received, sizeof(received)) == sizeof(data));
+    REQUIRE(std::equal(data, data + sizeof(data), received));
+
+    ///< Queued bytes are sent by the interrupt handler.
+    REQUIRE(uart.trySend(data, 100) == 100);
+    SimulatedSam3x::run(101 * cycles);
+    REQUIRE(USART0->transmittedCount() == 100);
+    uart.flush();
+
+    ///< With the interrupt masked, nothing is received and US_RHR is overrun.
+    NVIC_DisableIRQ(USART0_IRQn);
+    USART0->receiveFromLine(data, 3);
+    SimulatedSam3x::run(4 * cycles);
+    REQUIRE(uart.available() == 0);
+    REQUIRE(USART0->charactersOverrun() == 2);
+
+    NVIC_EnableIRQ(USART0_IRQn);
+    SimulatedSam3x::run(cycles);
+    REQUIRE(uart.available() == 1);
+    REQUIRE(uart.statistics().overrunErrors == 1);
+}
+
+TEST_CASE("HardwareUART against simulated registers, DMA between two controllers") {
+    using UARTLib::SimulatedSam3x;
+
+    SimulatedSam3x::reset();
+    UARTLib::HardwareUART sender(115200, UARTLib::UARTController::ONE);
+    UARTLib::HardwareUART receiver(115200, UARTLib::UARTController::TWO);
+    USART0->connect(USART1);
+    uint64_t cycles = USART0->characterCycles();
+
+    uint8_t first[16], second[16];
+    receiver.setFrameBuffers(first, second, sizeof(first), 20);
+    receiver.setReceiveMode(UARTLib::TransferMode::DMA);
+    sender.setTransmitMode(UARTLib::TransferMode::DMA);
+
+    ///< A frame is handed over once the line has been idle for 20 bit periods.
+    const uint8_t frame[] = "0123456789";
+    REQUIRE(sender.send(frame, 10));
+    REQUIRE(sender.txPending() > 0);
+    REQUIRE(sender.statistics().bytesSent == 0);
+    sender.flush();
+    REQUIRE(sender.txPending() == 0);
+    REQUIRE(sender.statistics().bytesSent == 10);
+    REQUIRE(receiver.dmaFramesAvailable() == 0);
+
+    SimulatedSam3x::run(3 * cycles);
+    REQUIRE(receiver.dmaFramesAvailable() == 1);
+
+    UARTLib::DmaFrame received;
+    REQUIRE(receiver.receiveFrame(received));
+    REQUIRE(received.length == 10);
+    REQUIRE(received.complete);
+    REQUIRE(std::equal(frame, frame + 10, received.data));
+    receiver.releaseFrame();
+}
+
+TEST_CASE("HardwareUART against simulated registers, RTS holds off the sender") {
+    using UARTLib::SimulatedSam3x;
+
+    SimulatedSam3x::reset();
+    UARTLib::HardwareUART uart(115200, UARTLib::UARTController::TWO);
+    REQUIRE(uart.setFlowControl(UARTLib::FlowControl::RTS_CTS));
+    uart.setReceiveMode(UARTLib::TransferMode::INTERRUPT);
+    uart.setWatermarks(128, 32);
+    uint64_t cycles = USART1->characterCycles();
+
+    uint8_t data[400];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = static_cast<uint8_t>(i);
+    }
+
+    ///< The sender stops after the character in flight once RTS is raised at the high watermark.
+    USART1->receiveFromLine(data, sizeof(data));
+    SimulatedSam3x::run((sizeof(data) + 1) * cycles);
+    REQUIRE(simulatedPIOA.drivenHigh(PIO_PA14));
+    REQUIRE(uart.available() >= 128);
+    REQUIRE(uart.available() <= 130);
+
+    ///< Reading down to the low watermark releases the sender, until everything has arrived without dropping a byte.
+    uint8_t received[sizeof(data)];
+    size_t count = 0;
+    while (count < sizeof(data) && SimulatedSam3x::now() < 4 * sizeof(data) * cycles) {
+        count += uart.receive(received + count, sizeof(data) - count);
+        SimulatedSam3x::run(cycles);
+    }
+
+    REQUIRE(count == sizeof(data));
+    REQUIRE(std::equal(data, data + sizeof(data), received));
+    REQUIRE(uart.statistics().rxDropped == 0);
+    REQUIRE(USART1->charactersOverrun() == 0);
+}
+
+TEST_CASE("HardwareUART against simulated registers, idle frames in the receive buffer") {
+    using UARTLib::SimulatedSam3x;
+
+    SimulatedSam3x::reset();
+    UARTLib::HardwareUART uart(115200);
+    uart.setReceiveMode(UARTLib::TransferMode::INTERRUPT);
+    uart.setFrameBoundary(UARTLib::FrameBoundary::IDLE, 20);
+    uint64_t cycles = USART0->characterCycles();
+
+    ///< The receiver timeout ends each burst, two character periods after its last byte.
+    USART0->receiveFromLine(reinterpret_cast<const uint8_t *>("first"), 5);
+    SimulatedSam3x::run(6 * cycles);
+    REQUIRE(uart.framesAvailable() == 0);
+    SimulatedSam3x::run(2 * cycles);
+    REQUIRE(uart.framesAvailable() == 1);
+
+    USART0->receiveFromLine(reinterpret_cast<const uint8_t *>("second"), 6);
+    SimulatedSam3x::run(9 * cycles);
+    REQUIRE(uart.framesAvailable() == 2);
+
+    uint8_t frame[8];
+    UARTLib::FrameDescriptor descriptor;
+    REQUIRE(uart.nextFrame(descriptor));
+    REQUIRE(descriptor.length == 5);
+    REQUIRE(uart.receive(frame, descriptor.length) == 5);
+    REQUIRE(std::equal(frame, frame + 5, "first"));
+    REQUIRE(uart.nextFrame(descriptor));
+    REQUIRE(descriptor.offset == 5);
+    REQUIRE(uart.receive(frame, descriptor.length) == 6);
+    REQUIRE(std::equal(frame, frame + 6, "second"));
+}
+
+TEST_CASE("HardwareUART against simulated registers, DMA transmits pool blocks in place") {
+    using UARTLib::SimulatedSam3x;
+
+    SimulatedSam3x::reset();
+    UARTLib::HardwareUART uart(115200);
+    uart.setTransmitMode(UARTLib::TransferMode::DMA);
+    UARTLib::BlockPool<32, 4> pool;
+    UARTLib::MessageTransmitter transmitter(uart);
+    uint64_t cycles = USART0->characterCycles();
+
+    ///< The DMA controller reads from the blocks, so both are held until the TXBUFE interrupt.
+    uint8_t *first = pool.allocate();
+    uint8_t *second = pool.allocate();
+    for (uint8_t i = 0; i < 32; i++) {
+        first[i] = i;
+        second[i] = 32 + i;
+    }
+
+    REQUIRE(transmitter.send(first, 32, pool));
+    REQUIRE(transmitter.send(second, 20, pool));
+    SimulatedSam3x::run(40 * cycles);
+    REQUIRE(pool.available() == 2);
+
+    SimulatedSam3x::run(15 * cycles);
+    REQUIRE(transmitter.pending() == 0);
+    REQUIRE(pool.available() == 4);
+
+    uint8_t transmitted[52];
+    REQUIRE(USART0->takeTransmitted(transmitted, sizeof(transmitted)) == 52);
+    for (uint8_t i = 0; i < 52; i++) {
+        REQUIRE(transmitted[i] == i);
+    }
+}
+
+TEST_CASE("HardwareUART against simulated registers, a mock on the same controller keeps off its interrupt") {
+    using UARTLib::SimulatedSam3x;
+
+    SimulatedSam3x::reset();
+    UARTLib::HardwareUART uart(115200, UARTLib::UARTController::ONE);
+    uart.setReceiveMode(UARTLib::TransferMode::INTERRUPT);
+    uint64_t cycles = USART0->characterCycles();
+
+    ///< A polling mock does not attach, an interrupt driven one does not replace the hardware connection.
+    UARTLib::MockUART mock(115200, UARTLib::UARTController::ONE);
+    mock.setLoopback(true);
+    UARTLib::MockUART interrupted(115200, UARTLib::UARTController::ONE);
+    interrupted.setReceiveMode(UARTLib::TransferMode::INTERRUPT);
+
+    USART0->receiveFromLine(reinterpret_cast<const uint8_t *>("abc"), 3);
+    SimulatedSam3x::run(4 * cycles);
+    REQUIRE(uart.available() == 3);
+    REQUIRE(USART0->charactersOverrun() == 0);
+}
+
+TEST_CASE("HardwareUART against simulated registers, transmit interrupts leave a polled receiver alone") {
+    using UARTLib::SimulatedSam3x;
+
+    SimulatedSam3x::reset();
+    UARTLib::HardwareUART uart(115200);
+    uart.setTransmitMode(UARTLib::TransferMode::INTERRUPT);
+    uint64_t cycles = USART0->characterCycles();
+
+    uint8_t data[50];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = static_cast<uint8_t>(i);
+    }
+
+    ///< The TXRDY interrupt runs throughout, but only polling receives, so without polling US_RHR is overrun.
+    REQUIRE(uart.trySend(data, sizeof(data)) == sizeof(data));
+    USART0->receiveFromLine(data, sizeof(data));
+    SimulatedSam3x::run((sizeof(data) + 1) * cycles);
+    REQUIRE(USART0->transmittedCount() == sizeof(data));
+    REQUIRE(USART0->charactersOverrun() == sizeof(data) - 1);
+    REQUIRE(uart.available() == 1);
+    REQUIRE(uart.receive() == sizeof(data) - 1);
+}
+
+TEST_CASE("HardwareUART against simulated registers, XON waits for a busy transmitter without blocking") {
+    using UARTLib::SimulatedSam3x;
+
+    SimulatedSam3x::reset();
+    UARTLib::HardwareUART uart(115200);
+    uart.setReceiveMode(UARTLib::TransferMode::INTERRUPT);
+    uart.setTransmitMode(UARTLib::TransferMode::COOPERATIVE);
+    uart.setOverflowPolicy(UARTLib::OverflowPolicy::BACKPRESSURE);
+    uart.setWatermarks(2, 1);
+    uint64_t cycles = USART0->characterCycles();
+
+    ///< With the transmitter idle, XOFF goes out at once.
+    USART0->receiveFromLine(reinterpret_cast<const uint8_t *>("xy"), 2);
+    SimulatedSam3x::run(4 * cycles);
+    REQUIRE(USART0->transmittedCount() == 1);
+
+    ///< With the transmitter busy, XON is left for service().
+    REQUIRE(uart.trySend(reinterpret_cast<const uint8_t *>("abcd"), 4) == 4);
+    REQUIRE(uart.service(2) == 2);
+    REQUIRE(uart.receive() == 'x');
+    SimulatedSam3x::run(3 * cycles);
+    REQUIRE(USART0->transmittedCount() == 3);
+
+    REQUIRE(uart.service(0) == 1);
+    uart.flush();
+    uart.service(2);
+    uart.flush();
+
+    uint8_t transmitted[6];
+    const uint8_t expected[] = {UARTLib::XOFF, 'a', 'b', UARTLib::XON, 'c', 'd'};
+    REQUIRE(USART0->takeTransmitted(transmitted, sizeof(transmitted)) == 6);
+    REQUIRE(std::equal(expected, expected + sizeof(expected), transmitted));
+}